@@ -0,0 +1,39 @@
+#!/usr/bin/env bash
+# Quest system network soak on loopback: one dedicated server and N headless clients.
+# Every process writes Saved/Profiling/PCQSSoak_<Role>_<ProcessId>.json when it finishes.
+#
+# Usage: RunSoak.sh <UnrealEditor-Cmd> <Project.uproject> <Map> [Clients=4] [Seconds=120] [EventsPerSecondPerPlayer=10]
+# PCQS_SOAK_PORT (7777) and PCQS_SOAK_QUESTS (8 active quests) can be set in the environment.
+set -euo pipefail
+
+if [ $# -lt 3 ]; then
+    sed -n '2,6p' "$0"
+    exit 1
+fi
+
+EDITOR=$1
+PROJECT=$2
+MAP=$3
+CLIENTS=${4:-4}
+SECONDS_TO_RUN=${5:-120}
+RATE=${6:-10}
+PORT=${PCQS_SOAK_PORT:-7777}
+QUESTS=${PCQS_SOAK_QUESTS:-8}
+
+COMMON_ARGS=(-unattended -nullrhi -nosound -NoVerifyGC -PCQSSoak -PCQSSoakExit)
+
+# The server waits for every client before it starts recording and sending events
+"$EDITOR" "$PROJECT" "$MAP" -server -port="$PORT" -log=PCQSSoak_Server.log \
+    "${COMMON_ARGS[@]}" -PCQSSoakSeconds="$SECONDS_TO_RUN" -PCQSSoakRate="$RATE" -PCQSSoakClients="$CLIENTS" -PCQSSoakQuests="$QUESTS" &
+SERVER_PID=$!
+trap 'kill $(jobs -p) 2>/dev/null || true' EXIT
+
+# Clients record until the server shuts down, the extra time only covers their own startup
+sleep "${PCQS_SOAK_SERVER_WARMUP:-15}"
+for CLIENT in $(seq 1 "$CLIENTS"); do
+    "$EDITOR" "$PROJECT" "127.0.0.1:$PORT" -game -log="PCQSSoak_Client$CLIENT.log" \
+        "${COMMON_ARGS[@]}" -PCQSSoakSeconds=$((SECONDS_TO_RUN * 2 + 120)) &
+done
+
+wait "$SERVER_PID"
+wait
@@ -40,6 +40,7 @@ public class PCQuestSystem : ModuleRules
 				"SlateCore",
 				"UMG",
 				"GameplayTags",
+				"Json",
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
@@ -8,6 +8,8 @@
 #include "Components/ShapeComponent.h"
 #include "Components/QuestComponent.h"
 #include <Components/IconMarkerComponent.h>
+#include "Components/BoxComponent.h"
+#include "Regions/QuestRegionSubsystem.h"
 
 
 ALocationTrigger::ALocationTrigger()
@@ -17,11 +19,45 @@ ALocationTrigger::ALocationTrigger()
     IconMarkerComponent = CreateDefaultSubobject<UIconMarkerComponent>(TEXT("IconMarkerComponent"));
 }
 
+void ALocationTrigger::BeginPlay()
+{
+    Super::BeginPlay();
+
+    if (!bUseGridDetection)
+    {
+        return;
+    }
+
+    UBoxComponent* BoxComponent = Cast<UBoxComponent>(GetCollisionComponent());
+    UQuestRegionSubsystem* RegionSubsystem = UQuestRegionSubsystem::Get(this);
+    if (BoxComponent && RegionSubsystem)
+    {
+        BoxComponent->SetGenerateOverlapEvents(false);
+        BoxComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+        RegionId = RegionSubsystem->RegisterBoxRegion(Location, BoxComponent->GetComponentTransform(), BoxComponent->GetScaledBoxExtent());
+    }
+}
+
+void ALocationTrigger::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    if (RegionId != INDEX_NONE)
+    {
+        if (UQuestRegionSubsystem* RegionSubsystem = UQuestRegionSubsystem::Get(this))
+        {
+            RegionSubsystem->UnregisterRegion(RegionId);
+        }
+        RegionId = INDEX_NONE;
+    }
+
+    Super::EndPlay(EndPlayReason);
+}
+
 void ALocationTrigger::NotifyActorBeginOverlap(AActor* OtherActor)
 {
     Super::NotifyActorBeginOverlap(OtherActor);
 
-    if (UQuestComponent* QuestComponent = Cast<UQuestComponent>(OtherActor->GetComponentByClass(UQuestComponent::StaticClass())))
+    // Any actor with a quest component arrives, AI escorts and vehicles included. Grid detection only tracks player pawns
+    if (UQuestComponent* QuestComponent = UQuestComponent::GetQuestComponent(OtherActor))
     {
         QuestComponent->OnArrivedToPlace(Location);
     }
@@ -31,7 +67,7 @@ void ALocationTrigger::NotifyActorEndOverlap(AActor* OtherActor)
 {
     Super::NotifyActorEndOverlap(OtherActor);
 
-    if (UQuestComponent* QuestComponent = Cast<UQuestComponent>(OtherActor->GetComponentByClass(UQuestComponent::StaticClass())))
+    if (UQuestComponent* QuestComponent = UQuestComponent::GetQuestComponent(OtherActor))
     {
         QuestComponent->OnLeftPlace(Location);
     }
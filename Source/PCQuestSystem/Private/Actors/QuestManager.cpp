@@ -4,15 +4,64 @@
 #include "Actors/LocationTrigger.h"
 #include <Components/IconMarkerComponent.h>
 #include "Kismet/GameplayStatics.h"
+#include "Misc/CommandLine.h"
+#include "Net/DataBunch.h"
 #include "Net/UnrealNetwork.h"
 #include "GameFramework/Actor.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
 #include "Interface/QuestObject.h"
+#include "Markers/MarkerSubsystem.h"
+#include "Actors/QuestObjectiveTraits.h"
+#include "Algo/BinarySearch.h"
+#include "HAL/IConsoleManager.h"
 #include "Iris/ReplicationState/ReplicationStateUtil.h"
-
+#include "PCQuestSystem.h"
+#include "PCQuestSystemStats.h"
+#include "Profiling/PCQSSoak.h"
+#include "Profiling/QuestEventCapture.h"
+
+DECLARE_CYCLE_STAT(TEXT("Event Dispatch"), STAT_PCQS_EventDispatch, STATGROUP_PCQuestSystem);
+DECLARE_CYCLE_STAT(TEXT("Quest Activation"), STAT_PCQS_QuestActivation, STATGROUP_PCQuestSystem);
+DECLARE_CYCLE_STAT(TEXT("Step Activation"), STAT_PCQS_StepActivation, STATGROUP_PCQuestSystem);
+DECLARE_CYCLE_STAT(TEXT("Step Progress"), STAT_PCQS_StepProgress, STATGROUP_PCQuestSystem);
+DECLARE_CYCLE_STAT(TEXT("Actor Spawning"), STAT_PCQS_ActorSpawning, STATGROUP_PCQuestSystem);
+DECLARE_CYCLE_STAT(TEXT("Replication Callbacks"), STAT_PCQS_ReplicationCallbacks, STATGROUP_PCQuestSystem);
+DECLARE_CYCLE_STAT(TEXT("Availability Update"), STAT_PCQS_AvailabilityUpdate, STATGROUP_PCQuestSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Events Dispatched"), STAT_PCQS_EventsDispatched, STATGROUP_PCQuestSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Steps Activated"), STAT_PCQS_StepsActivated, STATGROUP_PCQuestSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Step Progress Events"), STAT_PCQS_StepProgressEvents, STATGROUP_PCQuestSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Actors Spawned"), STAT_PCQS_ActorsSpawned, STATGROUP_PCQuestSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Replication Callbacks Received"), STAT_PCQS_ReplicationCallbacksReceived, STATGROUP_PCQuestSystem);
+DECLARE_CYCLE_STAT(TEXT("Bulk Apply"), STAT_PCQS_BulkApply, STATGROUP_PCQuestSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Event Queue Depth"), STAT_PCQS_EventQueueDepth, STATGROUP_PCQuestSystem);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Event Queue Drops"), STAT_PCQS_EventQueueDrops, STATGROUP_PCQuestSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Coalesced Events"), STAT_PCQS_CoalescedEvents, STATGROUP_PCQuestSystem);
+DECLARE_CYCLE_STAT(TEXT("Quest Completion"), STAT_PCQS_QuestCompletion, STATGROUP_PCQuestSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Quests Completed"), STAT_PCQS_QuestsCompleted, STATGROUP_PCQuestSystem);
+
+static TAutoConsoleVariable<int32> CVarEventQueueCapacity(
+    TEXT("pcqs.EventQueue.Capacity"),
+    8192,
+    TEXT("Events AQuestManager::EnqueueEvent holds between drains, events past it are dropped and counted."));
+
+static TAutoConsoleVariable<int32> CVarEventCoalescing(
+    TEXT("pcqs.EventCoalescing"),
+    1,
+    TEXT("1: kill, gather and catch events with the same tag and player are merged into one weighted event before they are applied, until one of them would complete a step."));
+
+static TAutoConsoleVariable<float> CVarEventCoalescingWindow(
+    TEXT("pcqs.EventCoalescing.Window"),
+    0.f,
+    TEXT("Seconds merged events are held for. 0 applies them at the end of the frame they arrived in. Go to and talk with events, activations and events that complete a step apply them right away to keep the order."));
 
 AQuestManager::AQuestManager()
 {
-    PrimaryActorTick.bCanEverTick = false;
+    // Only ticks on the server, to drain the event queue before the rest of the frame
+    PrimaryActorTick.bCanEverTick = true;
+    PrimaryActorTick.bStartWithTickEnabled = false;
+    PrimaryActorTick.TickGroup = TG_PrePhysics;
     SetReplicates(true);
     bAlwaysRelevant = true;
 }
@@ -29,8 +78,22 @@ AQuestManager::~AQuestManager()
 
 void AQuestManager::ActivateQuest_Implementation(int QuestIDToActivate, int StepIDToActivate)
 {
+    LLM_SCOPE_BYTAG(PCQuestSystem_RuntimeState);
+
+    if (EventCapture)
+    {
+        EventCapture->Record(EQuestEventType::ActivateQuest, nullptr, FGameplayTag(), 0.f, QuestIDToActivate, StepIDToActivate);
+    }
+    FlushCoalescedEvents();
+
     TSharedPtr<FQuest> QuestToActivate = GetQuestByID(QuestIDToActivate);
 
+    if (QuestToActivate.IsValid() && !QuestToActivate->HasValidStepGraph())
+    {
+        UE_LOG(LogPCQuestSystem, Warning, TEXT("Quest %d was rejected for a step cycle and can't be activated"), QuestIDToActivate);
+        return;
+    }
+
     if (QuestToActivate.IsValid())
     {
         if (QuestToActivate->HasQuestStarted())
@@ -43,21 +106,31 @@ void AQuestManager::ActivateQuest_Implementation(int QuestIDToActivate, int Step
 
 void AQuestManager::OnAfterQuestActivated(int QuestIDToActivate, bool bNewQuest)
 {
-    UKismetSystemLibrary::PrintString(this, FString::Printf(TEXT("OnAfterQuestActivated")));
+    PCQS_LOG(Verbose, TEXT("OnAfterQuestActivated %d"), QuestIDToActivate);
     TSharedPtr<FQuest> QuestToActivate = GetQuestByID(QuestIDToActivate);
     OnQuestActivated.Broadcast(*QuestToActivate.Get(), bNewQuest);
 }
 
 void AQuestManager::ResetQuest_Implementation(int QuestIDToActivate)
 {
-    UKismetSystemLibrary::PrintString(this, FString::Printf(TEXT("ResetQuest")));
+    PCQS_LOG(Verbose, TEXT("ResetQuest %d"), QuestIDToActivate);
     TSharedPtr<FQuest> QuestToActivate = GetQuestByID(QuestIDToActivate);
+    RemoveQuestFromEventIndex(QuestToActivate);
     QuestToActivate->ResetQuest();
+    for (FQuestStateInfo& ActiveQuest : ActiveQuests)
+    {
+        if (ActiveQuest.QuestID == QuestIDToActivate)
+        {
+            ActiveQuest.CompletedSteps.Reset();
+        }
+    }
 }
 
 void AQuestManager::AddActiveQuest_Implementation(int QuestIDToActivate, bool NewCurrentActiveQuest, int StepIDToActivate, bool bNewQuest)
 {
-    UKismetSystemLibrary::PrintString(this, FString::Printf(TEXT("AddActiveQuest")));
+    PCQS_SCOPE_CYCLE_COUNTER(STAT_PCQS_QuestActivation);
+    LLM_SCOPE_BYTAG(PCQuestSystem_RuntimeState);
+    PCQS_LOG(Verbose, TEXT("AddActiveQuest %d step %d"), QuestIDToActivate, StepIDToActivate);
     if (!ActiveQuests.FindByPredicate([QuestIDToActivate](const FQuestStateInfo& QuestInfo){ return QuestInfo.QuestID == QuestIDToActivate;  }))
     {
         ActiveQuests.Add({ QuestIDToActivate, StepIDToActivate});
@@ -74,7 +147,7 @@ void AQuestManager::AddActiveQuest_Implementation(int QuestIDToActivate, bool Ne
 
 void AQuestManager::SetCurrentActiveQuest(int QuestIDToActivate, int StepIDToActivate)
 {
-    UKismetSystemLibrary::PrintString(this, FString::Printf(TEXT("SetCurrentActiveQuest")));
+    PCQS_LOG(Verbose, TEXT("SetCurrentActiveQuest %d step %d"), QuestIDToActivate, StepIDToActivate);
     for (FQuestStateInfo& ActiveQuest : ActiveQuests)
     {
         ActiveQuest.CurrentActive = false;
@@ -88,6 +161,7 @@ void AQuestManager::SetCurrentActiveQuest(int QuestIDToActivate, int StepIDToAct
 
 void AQuestManager::RemoveActiveQuest_Implementation(int QuestIDToRemove)
 {
+    RemoveQuestFromEventIndex(GetQuestByID(QuestIDToRemove));
     for (int i = ActiveQuests.Num() - 1; i >= 0; i--)
     {
         if (ActiveQuests[i].QuestID == QuestIDToRemove)
@@ -98,149 +172,57 @@ void AQuestManager::RemoveActiveQuest_Implementation(int QuestIDToRemove)
     }
 }
 
-void AQuestManager::OnArrivedToPlace_Implementation(FGameplayTag ArrivedPlace, APlayerController* ArrivedBy)
+template <EQuestStepType StepType>
+void AQuestManager::DispatchStepEvent(const FGameplayTag& Tag, float Amount, APlayerController* Player)
 {
-    for (FQuestStateInfo QuestInfo : ActiveQuests)
-    {
-        auto Quest = GetQuestByID(QuestInfo.QuestID);
-        for (TSharedPtr<FQuestStepObjective> QuestObjective : Quest.Get()->ObjectivesArray)
-        {
-            if (!QuestObjective->IsCompleted() && QuestObjective->QuestStepType == EQuestStepType::GoTo)
-            {
-                TSharedPtr<FQuestStepGoToObjective> GoToObjective = StaticCastSharedPtr<FQuestStepGoToObjective>(QuestObjective);
-                if (GoToObjective && GoToObjective->PlaceToGo == ArrivedPlace)
-                {
-                    OnQuestStepArrivedToPlace(GoToObjective.Get()->StepObjectiveInsideQuestOrder, Quest.Get()->QuestID, ArrivedPlace, ArrivedBy);
-
-                    if (GoToObjective->IsCompleted())
-                    {
-                        OnStepQuestCompleted(GoToObjective.Get()->StepObjectiveInsideQuestOrder, Quest.Get()->QuestID);
-                    }
+    PCQS_SCOPE_CYCLE_COUNTER(STAT_PCQS_EventDispatch);
+    LLM_SCOPE_BYTAG(PCQuestSystem_RuntimeState);
+    INC_DWORD_STAT(STAT_PCQS_EventsDispatched);
 
-                    if (Quest->IsQuestCompleted())
-                    {
-                        OnQuestCompleted(Quest);
-                    }
-                }
-            }
-        }
+    using FTraits = TQuestObjectiveTraits<StepType>;
+    if (EventCapture)
+    {
+        EventCapture->Record(FTraits::CaptureType, Player, Tag, Amount);
     }
-}
 
-void AQuestManager::OnEntityTalkedTo_Implementation(FGameplayTag TalkedEntity, APlayerController* TalkedBy)
-{
-    for (FQuestStateInfo QuestInfo : ActiveQuests)
+    if constexpr (FTraits::bCounted)
     {
-        auto Quest = GetQuestByID(QuestInfo.QuestID);
-        for (TSharedPtr<FQuestStepObjective> QuestObjective : Quest.Get()->ObjectivesArray)
+        const FQuestProgressEvent Event{ StepType, Tag, Amount, Player };
+        if (!CoalesceEvent(Event))
         {
-            if (!QuestObjective->IsCompleted() && QuestObjective->QuestStepType == EQuestStepType::TalkWith)
-            {
-                TSharedPtr<FQuestStepTalkWithObjective> TalkToObjective = StaticCastSharedPtr<FQuestStepTalkWithObjective>(QuestObjective);
-                if (TalkToObjective && TalkToObjective->EntityToTalkWith == TalkedEntity)
-                {
-                    OnQuestStepEntityTalkedTo(TalkToObjective.Get()->StepObjectiveInsideQuestOrder, Quest.Get()->QuestID, TalkedEntity, TalkedBy);
-
-                    if (TalkToObjective->IsCompleted())
-                    {
-                        OnStepQuestCompleted(TalkToObjective.Get()->StepObjectiveInsideQuestOrder, Quest.Get()->QuestID);
-                    }
-
-                    if (Quest->IsQuestCompleted())
-                    {
-                        OnQuestCompleted(Quest);
-                    }
-                }
-            }
+            ApplyCounterEvent(Event);
         }
     }
+    else
+    {
+        FlushCoalescedEvents();
+        ApplyFrontierEvent({ StepType, Tag, Amount, Player });
+    }
 }
 
-void AQuestManager::OnEntityKilled_Implementation(FGameplayTag EntityKilled, APlayerController* KilledBy)
+void AQuestManager::OnArrivedToPlace_Implementation(FGameplayTag ArrivedPlace, APlayerController* ArrivedBy)
 {
-    for (FQuestStateInfo QuestInfo : ActiveQuests)
-    {
-        auto Quest = GetQuestByID(QuestInfo.QuestID);
-        for (TSharedPtr<FQuestStepObjective> QuestObjective : Quest.Get()->ObjectivesArray)
-        {
-            if (!QuestObjective->IsCompleted() && QuestObjective->QuestStepType == EQuestStepType::Kill)
-            {
-                TSharedPtr<FQuestStepKillObjective> KillObjective = StaticCastSharedPtr<FQuestStepKillObjective>(QuestObjective);
-                if (KillObjective && KillObjective->EntityToKill == EntityKilled)
-                {
-                    OnQuestStepEntityKilled(KillObjective.Get()->StepObjectiveInsideQuestOrder, Quest.Get()->QuestID, EntityKilled, KilledBy);
+    DispatchStepEvent<EQuestStepType::GoTo>(ArrivedPlace, 1.f, ArrivedBy);
+}
 
-                    if (KillObjective->IsCompleted())
-                    {
-                        OnStepQuestCompleted(KillObjective.Get()->StepObjectiveInsideQuestOrder, Quest.Get()->QuestID);
-                    }
+void AQuestManager::OnEntityTalkedTo_Implementation(FGameplayTag TalkedEntity, APlayerController* TalkedBy)
+{
+    DispatchStepEvent<EQuestStepType::TalkWith>(TalkedEntity, 1.f, TalkedBy);
+}
 
-                    if (Quest->IsQuestCompleted())
-                    {
-                        OnQuestCompleted(Quest);
-                    }
-                }
-            }
-        }
-    }
+void AQuestManager::OnEntityKilled_Implementation(FGameplayTag EntityKilled, APlayerController* KilledBy)
+{
+    DispatchStepEvent<EQuestStepType::Kill>(EntityKilled, 1.f, KilledBy);
 }
 
 void AQuestManager::OnItemGathered_Implementation(FGameplayTag ItemGathered, float amountGathered, APlayerController* GatheredBy)
 {
-    for (FQuestStateInfo QuestInfo : ActiveQuests)
-    {
-        auto Quest = GetQuestByID(QuestInfo.QuestID);
-        for (TSharedPtr<FQuestStepObjective> QuestObjective : Quest.Get()->ObjectivesArray)
-        {
-            if (!QuestObjective->IsCompleted() && QuestObjective->QuestStepType == EQuestStepType::Gather)
-            {
-                TSharedPtr<FQuestStepGatherObjective> ItemGatheredObjective = StaticCastSharedPtr<FQuestStepGatherObjective>(QuestObjective);
-                if (ItemGatheredObjective && ItemGatheredObjective->ItemToGather == ItemGathered)
-                {
-                    OnQuestStepItemGathered(ItemGatheredObjective.Get()->StepObjectiveInsideQuestOrder, Quest.Get()->QuestID, ItemGathered, amountGathered, GatheredBy);
-
-                    if (ItemGatheredObjective->IsCompleted())
-                    {
-                        OnStepQuestCompleted(ItemGatheredObjective.Get()->StepObjectiveInsideQuestOrder, Quest.Get()->QuestID);
-                    }
-
-                    if (Quest->IsQuestCompleted())
-                    {
-                        OnQuestCompleted(Quest);
-                    }
-                }
-            }
-        }
-    }
+    DispatchStepEvent<EQuestStepType::Gather>(ItemGathered, amountGathered, GatheredBy);
 }
 
 void AQuestManager::OnCatch_Implementation(FGameplayTag CatchTag, APlayerController* CatchedBy)
 {
-    for (FQuestStateInfo QuestInfo : ActiveQuests)
-    {
-        auto Quest = GetQuestByID(QuestInfo.QuestID);
-        for (TSharedPtr<FQuestStepObjective> QuestObjective : Quest.Get()->ObjectivesArray)
-        {
-            if (!QuestObjective->IsCompleted() && QuestObjective->QuestStepType == EQuestStepType::Catch)
-            {
-                TSharedPtr<FQuestStepCatchObjective> CatchObjective = StaticCastSharedPtr<FQuestStepCatchObjective>(QuestObjective);
-                if (CatchObjective && CatchObjective->AllowedTagToCatch.Contains(CatchTag))
-                {
-                    OnQuestStepCatch(CatchObjective.Get()->StepObjectiveInsideQuestOrder, Quest.Get()->QuestID, CatchTag, CatchedBy);
-
-                    if (CatchObjective->IsCompleted())
-                    {
-                        OnStepQuestCompleted(CatchObjective.Get()->StepObjectiveInsideQuestOrder, Quest.Get()->QuestID);
-                    }
-
-                    if (Quest->IsQuestCompleted())
-                    {
-                        OnQuestCompleted(Quest);
-                    }
-                }
-            }
-        }
-    }
+    DispatchStepEvent<EQuestStepType::Catch>(CatchTag, 1.f, CatchedBy);
 }
 
 const TArray<FQuest> AQuestManager::GetActiveQuests()
@@ -273,6 +255,26 @@ TArray<FQuest> AQuestManager::GetAllCompletedQuests()
     return AllCompletedQuests;
 }
 
+const TArray<FQuest> AQuestManager::GetAvailableQuests()
+{
+    TArray<FQuest> AvailableQuests;
+    for (int QuestID : PrerequisiteGraph.GetAvailableQuests())
+    {
+        AvailableQuests.Add(*GetQuestByID(QuestID).Get());
+    }
+    return AvailableQuests;
+}
+
+TArray<int> AQuestManager::GetAvailableQuestIDs() const
+{
+    return PrerequisiteGraph.GetAvailableQuests();
+}
+
+bool AQuestManager::IsQuestAvailable(int QuestID) const
+{
+    return PrerequisiteGraph.IsAvailable(QuestID);
+}
+
 const FQuestStepObjective AQuestManager::GetCurrentQuestCurrentObjective()
 {
     if (FQuestStateInfo QuestState = GetCurrentActiveQuestInfo(); QuestState.IsValid())
@@ -300,11 +302,47 @@ void AQuestManager::AddAssociatedActorToQuestStep(int StepQuestID, int QuestIDTo
     StepQuest->AddIconMarkerToAssociatedActor();
 }
 
+void AQuestManager::AddSpawnedActorToQuestStep(int StepQuestID, int QuestIDToGet, AActor* SpawnedActor)
+{
+    check(HasAuthority());
+
+    FQuestStepSpawnedActors* StepActors = SpawnedStepActors.FindByPredicate([&](const FQuestStepSpawnedActors& Entry)
+    {
+        return Entry.QuestID == QuestIDToGet && Entry.StepID == StepQuestID;
+    });
+    if (!StepActors)
+    {
+        StepActors = &SpawnedStepActors.AddDefaulted_GetRef();
+        StepActors->QuestID = QuestIDToGet;
+        StepActors->StepID = StepQuestID;
+    }
+    StepActors->Actors.Add(SpawnedActor);
+
+    AddAssociatedActorToQuestStep(StepQuestID, QuestIDToGet, SpawnedActor);
+}
+
+void AQuestManager::RemoveSpawnedStepActors(int QuestID)
+{
+    if (HasAuthority())
+    {
+        SpawnedStepActors.RemoveAll([QuestID](const FQuestStepSpawnedActors& Entry) { return Entry.QuestID == QuestID; });
+    }
+}
+
 void AQuestManager::RemoveAllActiveQuests_Implementation()
 {
+    if (EventCapture)
+    {
+        EventCapture->Record(EQuestEventType::RemoveAllActiveQuests, nullptr);
+    }
+    FlushCoalescedEvents();
+
     for (int i = ActiveQuests.Num() - 1; i >= 0; i--)
     {
-        GetQuestByID(ActiveQuests[i].QuestID)->ClearQuest();
+        RemoveSpawnedStepActors(ActiveQuests[i].QuestID);
+        TSharedPtr<FQuest> Quest = GetQuestByID(ActiveQuests[i].QuestID);
+        RemoveQuestFromEventIndex(Quest);
+        Quest->ClearQuest();
         ActiveQuests.RemoveAt(i);
     }
 }
@@ -334,59 +372,165 @@ const FQuest AQuestManager::GetCurrentActiveQuest()
 
 void AQuestManager::SpawnActor_Implementation(TSubclassOf<AActor> ActorToSpawn, FVector WorldPositionToSpawn, FRotator WorldRotationToSpawn)
 {
+    PCQS_SCOPE_CYCLE_COUNTER(STAT_PCQS_ActorSpawning);
+    LLM_SCOPE_BYTAG(PCQuestSystem_SpawnedActors);
+    INC_DWORD_STAT(STAT_PCQS_ActorsSpawned);
+
     FActorSpawnParameters SpawnParameters;
     SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
     LastSpawnedActor = GetWorld()->SpawnActor<AActor>(ActorToSpawn, WorldPositionToSpawn, WorldRotationToSpawn, SpawnParameters);
 }
 
-void AQuestManager::OnQuestStepArrivedToPlace_Implementation(int StepID, int QuestID, FGameplayTag ArrivedPlace, APlayerController* ArrivedBy)
+void AQuestManager::OnQuestStepProgressed_Implementation(int StepID, int QuestID, float Amount, APlayerController* ProgressedBy)
 {
-    TSharedPtr<FQuest> QuestWhereStepBelongs = GetQuestByID(QuestID);
-    TSharedPtr<FQuestStepObjective> StepQuest = GetStepQuestByID(StepID, QuestWhereStepBelongs);
-    TSharedPtr<FQuestStepGoToObjective> GoToObjective = StaticCastSharedPtr<FQuestStepGoToObjective>(StepQuest);
-    GoToObjective.Get()->OnArrivedToPlace(ArrivedBy);
-}
+    PCQS_SCOPE_CYCLE_COUNTER(STAT_PCQS_StepProgress);
+    INC_DWORD_STAT(STAT_PCQS_StepProgressEvents);
 
-void AQuestManager::OnQuestStepEntityTalkedTo_Implementation(int StepID, int QuestID, FGameplayTag TalkedEntity, APlayerController* TalkedBy)
-{
     TSharedPtr<FQuest> QuestWhereStepBelongs = GetQuestByID(QuestID);
-    TSharedPtr<FQuestStepObjective> StepQuest = GetStepQuestByID(StepID, QuestWhereStepBelongs);
-    TSharedPtr<FQuestStepTalkWithObjective> TalkToObjective = StaticCastSharedPtr<FQuestStepTalkWithObjective>(StepQuest);
-    TalkToObjective.Get()->OnTalkedWithEntity(TalkedBy);
+    VisitObjective(*GetStepQuestByID(StepID, QuestWhereStepBelongs), [Amount, ProgressedBy](auto Traits, auto& Objective)
+    {
+        decltype(Traits)::ApplyProgress(Objective, Amount, ProgressedBy);
+    });
 }
 
-void AQuestManager::OnQuestStepEntityKilled_Implementation(int StepID, int QuestID, FGameplayTag EntityKilled, APlayerController* KilledBy)
+void AQuestManager::ApplyEvents(TArrayView<const FQuestProgressEvent> Events)
 {
-    TSharedPtr<FQuest> QuestWhereStepBelongs = GetQuestByID(QuestID);
-    TSharedPtr<FQuestStepObjective> StepQuest = GetStepQuestByID(StepID, QuestWhereStepBelongs);
-    TSharedPtr<FQuestStepKillObjective> KillObjective = StaticCastSharedPtr<FQuestStepKillObjective>(StepQuest);
-    KillObjective.Get()->OnEntityKilled(KilledBy);
+    if (!HasAuthority() || Events.Num() == 0)
+    {
+        return;
+    }
+
+    PCQS_SCOPE_CYCLE_COUNTER(STAT_PCQS_BulkApply);
+    LLM_SCOPE_BYTAG(PCQuestSystem_RuntimeState);
+    INC_DWORD_STAT_BY(STAT_PCQS_EventsDispatched, Events.Num());
+    if (EventCapture)
+    {
+        for (const FQuestProgressEvent& Event : Events)
+        {
+            EventCapture->Record(GetObjectiveCaptureType(Event.StepType), Event.Player, Event.Tag, Event.Amount);
+        }
+    }
+    FlushCoalescedEvents();
+    // One at a time in event order, an event can complete or branch away from what the next one would progress
+    for (const FQuestProgressEvent& Event : Events)
+    {
+        if (IsCountedStepType(Event.StepType))
+        {
+            ApplyCounterEvent(Event);
+        }
+        else
+        {
+            ApplyFrontierEvent(Event);
+        }
+    }
 }
 
-void AQuestManager::OnQuestStepItemGathered_Implementation(int StepID, int QuestID, FGameplayTag ItemGathered, float amountGathered, APlayerController* GatheredBy)
+void AQuestManager::ApplyFrontierEvent(const FQuestProgressEvent& Event)
 {
-    TSharedPtr<FQuest> QuestWhereStepBelongs = GetQuestByID(QuestID);
-    TSharedPtr<FQuestStepObjective> StepQuest = GetStepQuestByID(StepID, QuestWhereStepBelongs);
-    TSharedPtr<FQuestStepGatherObjective> GatherObjective = StaticCastSharedPtr<FQuestStepGatherObjective>(StepQuest);
-    GatherObjective.Get()->OnItemGathered(GatheredBy, amountGathered);
+    for (const FQuestStepRef& Step : GetStepsForEvent(Event.StepType, Event.Tag))
+    {
+        // An earlier step of this event can complete the quest or take a branch that drops this step
+        if (Step.Quest->IsStepActive(Step.StepIndex))
+        {
+            OnQuestStepProgressed(Step.Quest->ObjectivesArray[Step.StepIndex]->StepObjectiveInsideQuestOrder, Step.Quest->QuestID, Event.Amount, Event.Player);
+            OnStepProgressed(Step);
+        }
+    }
 }
 
-void AQuestManager::OnQuestStepCatch_Implementation(int StepID, int QuestID, FGameplayTag CatchTag, APlayerController* CatchedBy)
+void AQuestManager::ApplyCounterEvent(const FQuestProgressEvent& Event)
 {
-    TSharedPtr<FQuest> QuestWhereStepBelongs = GetQuestByID(QuestID);
-    TSharedPtr<FQuestStepObjective> StepQuest = GetStepQuestByID(StepID, QuestWhereStepBelongs);
-    TSharedPtr<FQuestStepCatchObjective> GatherObjective = StaticCastSharedPtr<FQuestStepCatchObjective>(StepQuest);
-    GatherObjective.Get()->OnCatched(CatchedBy);
+    TArray<FQuestStepEventKey, TInlineAllocator<4>> EventKeys;
+    GetEventKeys(Event.StepType, Event.Tag, EventKeys);
+    TArray<FQuestStepRef> ReachedSteps;
+    for (const FQuestStepEventKey& EventKey : EventKeys)
+    {
+        Counters.Add(EventKey, Event.Amount, ReachedSteps);
+    }
+    for (int32 ReachedIndex = 0; ReachedIndex < ReachedSteps.Num(); ++ReachedIndex)
+    {
+        // Copied, rebasing below can grow the array
+        const FQuestStepRef Step = ReachedSteps[ReachedIndex];
+        // An earlier completion of this event can complete the quest or take a branch that drops this step
+        if (!Step.Quest->IsStepActive(Step.StepIndex))
+        {
+            continue;
+        }
+
+        const TSharedPtr<FQuestStepObjective>& Objective = Step.Quest->ObjectivesArray[Step.StepIndex];
+        const float Overshoot = FMath::Min(Counters.GetProgress(*Objective) - Objective->GetCounterTarget(), Event.Amount);
+        const TArray<int32> ActiveSteps = Step.Quest->GetActiveSteps();
+        OnQuestStepProgressed(Objective->StepObjectiveInsideQuestOrder, Step.Quest->QuestID, Event.Amount, Event.Player);
+        OnStepProgressed(Step);
+        if (!Objective->IsCompleted())
+        {
+            // Every player has to get here, it is tried again on each increment until they have
+            Counters.WatchStep(Step);
+            continue;
+        }
+
+        // What a weighted event had left after the target goes to the steps this one activated, as the single events would have
+        if (Overshoot > 0.f)
+        {
+            for (int32 StepIndex : Step.Quest->GetActiveSteps())
+            {
+                const TSharedPtr<FQuestStepObjective>& ActivatedObjective = Step.Quest->ObjectivesArray[StepIndex];
+                if (!ActiveSteps.Contains(StepIndex) && ActivatedObjective->QuestStepType == Event.StepType && ActivatedObjective->MatchesEventTag(Event.Tag))
+                {
+                    Counters.RebaseStep({ Step.Quest, StepIndex }, Overshoot, ReachedSteps);
+                }
+            }
+        }
+    }
 }
 
 void AQuestManager::OnRep_OnActiveQuests()
 {
+    PCQS_SCOPE_CYCLE_COUNTER(STAT_PCQS_ReplicationCallbacks);
+    LLM_SCOPE_BYTAG(PCQuestSystem_RuntimeState);
+    INC_DWORD_STAT(STAT_PCQS_ReplicationCallbacksReceived);
+
     for (auto ActiveQuest : ActiveQuests)
     {
         AddActiveQuest(ActiveQuest.QuestID, ActiveQuest.CurrentActive, ActiveQuest.CurrentStepQuestObjectID, false);
     }
 }
 
+void AQuestManager::OnRep_SpawnedStepActors()
+{
+    PCQS_SCOPE_CYCLE_COUNTER(STAT_PCQS_ReplicationCallbacks);
+    INC_DWORD_STAT(STAT_PCQS_ReplicationCallbacksReceived);
+
+    // Actors can arrive after the entry that references them, so this runs again once they resolve
+    for (const FQuestStepSpawnedActors& StepActors : SpawnedStepActors)
+    {
+        TSharedPtr<FQuest> Quest = GetQuestByID(StepActors.QuestID);
+        TSharedPtr<FQuestStepObjective> StepQuest = Quest.IsValid() ? GetStepQuestByID(StepActors.StepID, Quest) : nullptr;
+        if (!StepQuest.IsValid())
+        {
+            continue;
+        }
+
+        const bool bStepIsCurrent = !StepQuest->IsCompleted() && Quest->IsStepActive(Quest->GetStepIndex(StepActors.StepID))
+            && ActiveQuests.ContainsByPredicate([&](const FQuestStateInfo& QuestInfo) { return QuestInfo.QuestID == StepActors.QuestID; });
+
+        bool bAddedActor = false;
+        for (AActor* SpawnedActor : StepActors.Actors)
+        {
+            if (SpawnedActor && !StepQuest->HasAssociatedActor(SpawnedActor))
+            {
+                AddAssociatedActorToQuestStep(StepActors.StepID, StepActors.QuestID, SpawnedActor);
+                bAddedActor = true;
+            }
+        }
+
+        if (bAddedActor && bStepIsCurrent)
+        {
+            StepQuest->ActivateActorMarker();
+        }
+    }
+}
+
 AActor* AQuestManager::GetStepQuestReference(int QuestID, FGameplayTag ReferenceTag)
 {
     if (QuestReferences.Contains(QuestID))
@@ -433,6 +577,17 @@ AActor* AQuestManager::GetLastSpawnedActor()
     return LastSpawnedActor;
 }
 
+void AQuestManager::PostInitializeComponents()
+{
+    Super::PostInitializeComponents();
+
+    // Not in BeginPlay, the profiling commandlets tick their world without ever beginning play
+    if (!PostActorTickHandle.IsValid())
+    {
+        PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &AQuestManager::OnWorldPostActorTick);
+    }
+}
+
 void AQuestManager::BeginPlay()
 {
     Super::BeginPlay();
@@ -442,143 +597,1084 @@ void AQuestManager::BeginPlay()
         const FString Context;
         TArray<FQuest*> Quests;
         DataTable->GetAllRows(*Context, Quests);
-        int QuestId = 1;
-        for (FQuest* quest : Quests)
-        {
-            AllQuests.Add(MakeShareable(new
-                FQuest(QuestId++, quest->QuestType, quest->Name, quest->QuestRewards, quest->GoToObjectives, quest->TalkWithObjectives, quest->KillObjectives, quest->GatherObjectives, quest->CatchObjectives)
-            ));
-        }
+        LoadQuests(Quests);
     }
 
     for (auto QuestReference : QuestReferences)
     {
         DeactivateQuestReferences(QuestReference.Key);
     }
-}
-
-void AQuestManager::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
-{
-    Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
-    DOREPLIFETIME_CONDITION_NOTIFY(AQuestManager, ActiveQuests, COND_InitialOnly, REPNOTIFY_Always);
-    DOREPLIFETIME_CONDITION_NOTIFY(AQuestManager, CompletedQuests, COND_InitialOnly, REPNOTIFY_Always);
-}
+    SetActorTickEnabled(HasAuthority());
 
+    if (HasAuthority())
+    {
+        PostLoginHandle = FGameModeEvents::GameModePostLoginEvent.AddUObject(this, &AQuestManager::OnPlayerPostLogin);
+        LogoutHandle = FGameModeEvents::GameModeLogoutEvent.AddUObject(this, &AQuestManager::OnPlayerLogout);
+        for (FConstPlayerControllerIterator Iterator = GetWorld()->GetPlayerControllerIterator(); Iterator; ++Iterator)
+        {
+            if (const APlayerController* PlayerController = Iterator->Get())
+            {
+                AddPlayerSlot(PlayerController->PlayerState);
+            }
+        }
+    }
 
-TSharedPtr<FQuest> AQuestManager::GetQuestByID(const int IDToGet)
-{
-    TSharedPtr<FQuest> QuestToReturn = *AllQuests.FindByPredicate([&](const TSharedPtr<FQuest> quest)
+    FString CapturePath;
+    if (HasAuthority() && FParse::Value(FCommandLine::Get(), TEXT("PCQSCapture="), CapturePath))
     {
-        return quest->QuestID == IDToGet;
-    });
+        StartEventCapture(CapturePath);
+    }
 
-    return QuestToReturn;
+#if !UE_BUILD_SHIPPING
+    PCQSSoak::OnQuestManagerBeginPlay(this);
+#endif
 }
 
-TSharedPtr<FQuest> AQuestManager::GetQuestByID(const int IDToGet) const
+void AQuestManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-    TSharedPtr<FQuest> QuestToReturn = *AllQuests.FindByPredicate([&](const TSharedPtr<FQuest> quest)
-    {
-        return quest->QuestID == IDToGet;
-    });
+#if !UE_BUILD_SHIPPING
+    PCQSSoak::OnQuestManagerEndPlay(this);
+#endif
+    StopEventCapture();
+    FGameModeEvents::GameModePostLoginEvent.Remove(PostLoginHandle);
+    FGameModeEvents::GameModeLogoutEvent.Remove(LogoutHandle);
+    FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+    PostActorTickHandle.Reset();
+    PendingCompletedQuests.Reset();
+
+    EventQueue.Empty();
+    NumQueuedEvents = 0;
+    CoalescedEvents.Reset();
+    CoalescedCounterAmounts.Reset();
+    Counters.Empty();
+
+    Super::EndPlay(EndPlayReason);
+}
 
-    return QuestToReturn;
-}   
+void AQuestManager::BeginDestroy()
+{
+    // Worlds that never began play do not end it either
+    FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+    PostActorTickHandle.Reset();
 
-TSharedPtr<FQuestStepObjective> AQuestManager::GetStepQuestByID(int IDToGet, TSharedPtr<FQuest> QuestToSearch)
+    Super::BeginDestroy();
+}
+
+void AQuestManager::Tick(float DeltaSeconds)
 {
-    return QuestToSearch.Get()->GetStepObjectiveById(IDToGet);
+    Super::Tick(DeltaSeconds);
+
+    DrainEventQueue();
 }
 
-void AQuestManager::ActivateQuestObjectives(int QuestID, int StepIDToActivate)
+bool AQuestManager::CoalesceEvent(const FQuestProgressEvent& Event)
 {
-    if (QuestID != -1)
+    if (!CVarEventCoalescing.GetValueOnGameThread() || !HasAuthority())
     {
-        TSharedPtr<FQuest> Quest = GetQuestByID(QuestID);
-        for (int i = 0; i < StepIDToActivate; ++i)
+        return false;
+    }
+
+    // Runs are applied one after the other, which only matches the events in arrival order while none of them completes a step.
+    // The event that would is applied on its own after everything before it
+    TArray<FQuestStepEventKey, TInlineAllocator<4>> EventKeys;
+    GetEventKeys(Event.StepType, Event.Tag, EventKeys);
+    for (const FQuestStepEventKey& EventKey : EventKeys)
+    {
+        const float* PendingAmount = CoalescedCounterAmounts.Find(EventKey);
+        if (Counters.WouldReach(EventKey, (PendingAmount ? *PendingAmount : 0.f) + Event.Amount))
         {
-            const auto Objective = Quest.Get()->ObjectivesArray[i];
-            Objective->Activate(GetWorld(), this);
-            Objective->SetCompleted();
+            FlushCoalescedEvents();
+            return false;
         }
-        const auto Objective = Quest.Get()->ObjectivesArray[StepIDToActivate];
-        Objective->Activate(GetWorld(), this);
     }
+
+    if (CoalescedEvents.Num() == 0)
+    {
+        CoalescingWindowStart = GetWorld()->GetTimeSeconds();
+    }
+    for (const FQuestStepEventKey& EventKey : EventKeys)
+    {
+        CoalescedCounterAmounts.FindOrAdd(EventKey) += Event.Amount;
+    }
+    if (FQuestProgressEvent* Run = CoalescedEvents.FindByPredicate([&Event](const FQuestProgressEvent& Pending)
+        {
+            return Pending.StepType == Event.StepType && Pending.Tag == Event.Tag && Pending.Player == Event.Player;
+        }))
+    {
+        Run->Amount += Event.Amount;
+        INC_DWORD_STAT(STAT_PCQS_CoalescedEvents);
+    }
+    else
+    {
+        CoalescedEvents.Add(Event);
+    }
+    return true;
 }
 
-void AQuestManager::ActivateQuestReferences(int QuestID)
+void AQuestManager::FlushCoalescedEvents()
 {
-    if (QuestID != -1)
+    if (CoalescedEvents.Num() == 0)
     {
-        if (QuestReferences.Contains(QuestID))
-        {
-            for (auto QuestActor : QuestReferences[QuestID].QuestActors)
-            {
-                if (IQuestObject* ActorAsQuestObject = Cast<IQuestObject>(QuestActor.ReferenceActor))
-                {
-                    ActorAsQuestObject->ActivateObject();
-                    IQuestObject::Execute_BP_ActivateObject(QuestActor.ReferenceActor);
-                }
-            }
-        }
+        return;
+    }
+
+    // Moved out first, listeners of the progress can send more events
+    const TArray<FQuestProgressEvent> Events = MoveTemp(CoalescedEvents);
+    CoalescedEvents.Reset();
+    CoalescedCounterAmounts.Reset();
+    for (const FQuestProgressEvent& Event : Events)
+    {
+        ApplyCounterEvent(Event);
     }
 }
 
-void AQuestManager::DeactivateQuestReferences(int QuestID)
+bool AQuestManager::EnqueueEvent(const FQueuedQuestEvent& Event)
 {
-    if (QuestID != -1)
+    // Clients never tick the manager, their queue would only fill up
+    if (!HasAuthority())
     {
-        if (QuestReferences.Contains(QuestID))
+        return false;
+    }
+
+    // Reserve a slot first so concurrent producers cannot go past the capacity together
+    if (NumQueuedEvents.fetch_add(1, std::memory_order_relaxed) >= CVarEventQueueCapacity.GetValueOnAnyThread())
+    {
+        NumQueuedEvents.fetch_sub(1, std::memory_order_relaxed);
+        const int64 NumDropped = NumDroppedEvents.fetch_add(1, std::memory_order_relaxed) + 1;
+        // Once per burst is enough, a full queue drops every event until the next drain
+        if (FMath::IsPowerOfTwo(NumDropped))
         {
-            for (auto QuestActor : QuestReferences[QuestID].QuestActors)
-            {
-                if (IQuestObject* ActorAsQuestObject = Cast<IQuestObject>(QuestActor.ReferenceActor))
-                {
-                    ActorAsQuestObject->DeactivateObject(false);
-                    IQuestObject::Execute_BP_DeactivateObject(QuestActor.ReferenceActor, false);
-                }
-            }
+            UE_LOG(LogPCQuestSystem, Warning, TEXT("Quest event queue is full (pcqs.EventQueue.Capacity), %lld events dropped so far"), NumDropped);
         }
+        return false;
     }
+    EventQueue.Enqueue(Event);
+    return true;
 }
 
-void AQuestManager::OnQuestCompleted(TSharedPtr<FQuest> CompletedQuest)
+void AQuestManager::DrainEventQueue()
 {
-    FTimerDelegate TimerDelegate = FTimerDelegate::CreateUObject(this, &AQuestManager::OnQuestCompletedNextTick, CompletedQuest.Get()->QuestID);
-    GetWorld()->GetTimerManager().SetTimerForNextTick(TimerDelegate);
-}
+    SET_DWORD_STAT(STAT_PCQS_EventQueueDepth, NumQueuedEvents.load(std::memory_order_relaxed));
+    SET_DWORD_STAT(STAT_PCQS_EventQueueDrops, NumDroppedEvents.load(std::memory_order_relaxed));
+    if (EventQueue.IsEmpty())
+    {
+        return;
+    }
+
+    TArray<FQuestProgressEvent> Events;
+    Events.Reserve(NumQueuedEvents.load(std::memory_order_relaxed));
+    FQueuedQuestEvent QueuedEvent;
+    while (EventQueue.Dequeue(QueuedEvent))
+    {
+        Events.Add({ QueuedEvent.StepType, QueuedEvent.Tag, QueuedEvent.Amount, QueuedEvent.Player.Get() });
+    }
+    NumQueuedEvents.fetch_sub(Events.Num(), std::memory_order_relaxed);
+    ApplyEvents(Events);
+}
+
+bool AQuestManager::StartEventCapture(const FString& Path)
+{
+    if (!HasAuthority())
+    {
+        return false;
+    }
+
+    StopEventCapture();
+    // Events still being merged belong before the capture
+    FlushCoalescedEvents();
+    FQuestCaptureSnapshot Snapshot;
+    GetCaptureSnapshot(Snapshot);
+    EventCapture = FQuestEventCaptureWriter::Create(Path, DataTable ? DataTable->GetPathName() : FString(), Snapshot);
+    return EventCapture.IsValid();
+}
+
+void AQuestManager::GetCaptureSnapshot(FQuestCaptureSnapshot& OutSnapshot) const
+{
+    OutSnapshot.CompletedQuests = CompletedQuests;
+    for (const FQuestStateInfo& QuestInfo : ActiveQuests)
+    {
+        FQuestCaptureSnapshot::FQuestState& QuestState = OutSnapshot.ActiveQuests.AddDefaulted_GetRef();
+        QuestState.QuestID = QuestInfo.QuestID;
+        QuestState.CurrentStepID = QuestInfo.CurrentStepQuestObjectID;
+        QuestState.bCurrentActive = QuestInfo.CurrentActive;
+        QuestState.CompletedSteps = QuestInfo.CompletedSteps;
+
+        const TSharedPtr<FQuest> Quest = GetQuestByID(QuestInfo.QuestID);
+        for (int32 StepIndex : Quest->GetActiveSteps())
+        {
+            const FQuestStepObjective& Objective = *Quest->ObjectivesArray[StepIndex];
+            if (IsCountedStepType(Objective.QuestStepType))
+            {
+                OutSnapshot.StepProgress.Add({ QuestInfo.QuestID, Objective.StepObjectiveInsideQuestOrder, Counters.GetProgress(Objective) });
+            }
+        }
+    }
+}
+
+void AQuestManager::RestoreCaptureSnapshot(const FQuestCaptureSnapshot& Snapshot)
+{
+    CompletedQuests = Snapshot.CompletedQuests;
+    RebuildQuestAvailability();
+
+    // Every entry goes in first, activation resumes each quest from its completed steps
+    for (const FQuestCaptureSnapshot::FQuestState& QuestState : Snapshot.ActiveQuests)
+    {
+        FQuestStateInfo& QuestInfo = ActiveQuests.AddDefaulted_GetRef();
+        QuestInfo.QuestID = QuestState.QuestID;
+        QuestInfo.CurrentStepQuestObjectID = QuestState.CurrentStepID;
+        QuestInfo.CompletedSteps = QuestState.CompletedSteps;
+    }
+    for (const FQuestCaptureSnapshot::FQuestState& QuestState : Snapshot.ActiveQuests)
+    {
+        AddActiveQuest(QuestState.QuestID, QuestState.bCurrentActive, QuestState.CurrentStepID, false);
+    }
+
+    // Steps were added to the counters at zero progress
+    for (const FQuestCaptureSnapshot::FStepProgress& StepProgress : Snapshot.StepProgress)
+    {
+        const TSharedPtr<FQuest> Quest = GetQuestByID(StepProgress.QuestID);
+        const int32 StepIndex = Quest.IsValid() ? Quest->GetStepIndex(StepProgress.StepID) : INDEX_NONE;
+        if (StepIndex == INDEX_NONE || !Quest->IsStepActive(StepIndex))
+        {
+            continue;
+        }
+
+        TArray<FQuestStepRef> ReachedSteps;
+        Counters.RebaseStep({ Quest, StepIndex }, StepProgress.Progress, ReachedSteps);
+        // Only steps every player has to do wait at their target
+        for (const FQuestStepRef& ReachedStep : ReachedSteps)
+        {
+            Counters.WatchStep(ReachedStep);
+        }
+    }
+}
+
+void AQuestManager::StopEventCapture()
+{
+    EventCapture.Reset();
+}
+
+#if !UE_BUILD_SHIPPING
+bool AQuestManager::CallRemoteFunction(UFunction* Function, void* Parameters, FOutParmRec* OutParms, FFrame* Stack)
+{
+    if (PCQSSoak::IsAccountingTraffic())
+    {
+        // Reliable RPCs are written to the connections right away, so the growth is what this call sent
+        const int64 SentBitsBefore = PCQSSoak::GetSentBits(this);
+        const bool bProcessed = Super::CallRemoteFunction(Function, Parameters, OutParms, Stack);
+        PCQSSoak::RecordRemoteFunction(Function, PCQSSoak::GetSentBits(this) - SentBitsBefore);
+        return bProcessed;
+    }
+    return Super::CallRemoteFunction(Function, Parameters, OutParms, Stack);
+}
+
+bool AQuestManager::ReplicateSubobjects(UActorChannel* Channel, FOutBunch* Bunch, FReplicationFlags* RepFlags)
+{
+    // An estimate: the generic replication path has written the actor header and properties to the bunch by now. Iris never gets here
+    if (PCQSSoak::IsAccountingTraffic() && Bunch->GetNumBits() > 0)
+    {
+        PCQSSoak::RecordReplication(RepFlags->bNetInitial, Bunch->GetNumBits());
+    }
+    return Super::ReplicateSubobjects(Channel, Bunch, RepFlags);
+}
+#endif
+
+void AQuestManager::SoakLatencyProbe_Implementation(double SentTime)
+{
+#if !UE_BUILD_SHIPPING
+    PCQSSoak::RecordLatencyProbe(SentTime);
+#endif
+}
+
+void AQuestManager::LoadQuests(const TArray<FQuest*>& QuestRows)
+{
+    LLM_SCOPE_BYTAG(PCQuestSystem_Definitions);
+    StepEventIndex.Reset();
+    Counters.Empty();
+    AllQuests.Empty(QuestRows.Num());
+    int QuestId = 1;
+    for (const FQuest* quest : QuestRows)
+    {
+        TSharedPtr<FQuest> NewQuest = AllQuests.Add_GetRef(MakeShareable(new
+            FQuest(QuestId++, quest->QuestType, quest->Name, quest->QuestRewards, quest->GoToObjectives, quest->TalkWithObjectives, quest->KillObjectives, quest->GatherObjectives, quest->CatchObjectives)
+        ));
+        NewQuest->PrerequisiteQuests = quest->PrerequisiteQuests;
+        for (const TSharedPtr<FQuestStepObjective>& Objective : NewQuest->ObjectivesArray)
+        {
+            Objective->OwningQuestManager = this;
+        }
+    }
+    TagFilters.Build(AllQuests);
+    RebuildQuestAvailability();
+}
+
+void AQuestManager::RebuildQuestAvailability()
+{
+    PCQS_SCOPE_CYCLE_COUNTER(STAT_PCQS_AvailabilityUpdate);
+    PrerequisiteGraph.Build(AllQuests);
+    for (int QuestID : CompletedQuests)
+    {
+        PrerequisiteGraph.CompleteQuest(QuestID);
+    }
+}
+
+void AQuestManager::OnRep_CompletedQuests()
+{
+    // Replicated properties can arrive before BeginPlay loads the quests, LoadQuests replays them in that case
+    if (AllQuests.Num() > 0)
+    {
+        RebuildQuestAvailability();
+    }
+}
+
+void AQuestManager::OnRep_PlayerSlots()
+{
+    PlayerSlotIndices.Reset();
+    ConnectedPlayerSlots.Init(false, PlayerSlots.Num());
+    for (int32 PlayerSlot = 0; PlayerSlot < PlayerSlots.Num(); ++PlayerSlot)
+    {
+        if (PlayerSlots[PlayerSlot])
+        {
+            PlayerSlotIndices.Add(PlayerSlots[PlayerSlot], PlayerSlot);
+            ConnectedPlayerSlots[PlayerSlot] = true;
+        }
+    }
+}
+
+int32 AQuestManager::GetPlayerSlot(const AController* Player) const
+{
+    const int32* PlayerSlot = Player && Player->PlayerState ? PlayerSlotIndices.Find(Player->PlayerState) : nullptr;
+    return PlayerSlot ? *PlayerSlot : INDEX_NONE;
+}
+
+TArray<APlayerState*> AQuestManager::GetStepCompletedPlayers(int QuestID, int StepID) const
+{
+    TArray<APlayerState*> Players;
+    const FQuestStepPlayerMask* Mask = StepPlayerMasks.FindByPredicate([QuestID, StepID](const FQuestStepPlayerMask& StepMask) { return StepMask.QuestID == QuestID && StepMask.StepID == StepID; });
+    if (!Mask)
+    {
+        return Players;
+    }
+
+    for (int32 Word = 0; Word < Mask->SlotWords.Num(); ++Word)
+    {
+        for (uint32 Bits = Mask->SlotWords[Word]; Bits != 0; Bits &= Bits - 1)
+        {
+            const int32 PlayerSlot = Word * NumBitsPerDWORD + FMath::CountTrailingZeros(Bits);
+            if (PlayerSlots.IsValidIndex(PlayerSlot) && PlayerSlots[PlayerSlot])
+            {
+                Players.Add(PlayerSlots[PlayerSlot]);
+            }
+        }
+    }
+    return Players;
+}
+
+void AQuestManager::MarkPlayerCompleted(FQuestStepObjective& Objective, const AController* Player)
+{
+    const int32 PlayerSlot = GetPlayerSlot(Player);
+    if (PlayerSlot == INDEX_NONE)
+    {
+        return;
+    }
+
+    if (Objective.CompletedPlayerSlots.Num() <= PlayerSlot)
+    {
+        Objective.CompletedPlayerSlots.Add(false, PlayerSlot + 1 - Objective.CompletedPlayerSlots.Num());
+    }
+    if (!Objective.CompletedPlayerSlots[PlayerSlot])
+    {
+        Objective.CompletedPlayerSlots[PlayerSlot] = true;
+        UpdateStepPlayerMask(Objective);
+    }
+    Objective.UpdatePlayerCompletion(ConnectedPlayerSlots);
+}
+
+void AQuestManager::OnPlayerPostLogin(AGameModeBase* GameMode, APlayerController* NewPlayer)
+{
+    // Joining can never complete a step, the new slot simply is not marked on any
+    if (GameMode->GetWorld() == GetWorld() && NewPlayer)
+    {
+        AddPlayerSlot(NewPlayer->PlayerState);
+    }
+}
+
+void AQuestManager::OnPlayerLogout(AGameModeBase* GameMode, AController* Exiting)
+{
+    const int32 PlayerSlot = GameMode->GetWorld() == GetWorld() ? GetPlayerSlot(Exiting) : INDEX_NONE;
+    if (PlayerSlot == INDEX_NONE)
+    {
+        return;
+    }
+
+    PlayerSlotIndices.Remove(PlayerSlots[PlayerSlot]);
+    PlayerSlots[PlayerSlot] = nullptr;
+    ConnectedPlayerSlots[PlayerSlot] = false;
+
+    // The player that left no longer holds back the steps every player has to do, and its slot is free for the next one
+    TArray<FQuestStepRef> AllPlayersSteps;
+    for (const FQuestStateInfo& QuestInfo : ActiveQuests)
+    {
+        const TSharedPtr<FQuest> Quest = GetQuestByID(QuestInfo.QuestID);
+        for (int32 StepIndex : Quest->GetActiveSteps())
+        {
+            if (Quest->ObjectivesArray[StepIndex]->bRequiresAllPlayers)
+            {
+                AllPlayersSteps.Add({ Quest, StepIndex });
+            }
+        }
+    }
+    for (const FQuestStepRef& Step : AllPlayersSteps)
+    {
+        FQuestStepObjective& Objective = *Step.Quest->ObjectivesArray[Step.StepIndex];
+        if (Objective.CompletedPlayerSlots.IsValidIndex(PlayerSlot) && Objective.CompletedPlayerSlots[PlayerSlot])
+        {
+            Objective.CompletedPlayerSlots[PlayerSlot] = false;
+            UpdateStepPlayerMask(Objective);
+        }
+        if (Step.Quest->IsStepActive(Step.StepIndex) && !Objective.IsCompleted() && Objective.UpdatePlayerCompletion(ConnectedPlayerSlots))
+        {
+            OnStepProgressed(Step);
+        }
+    }
+}
+
+void AQuestManager::AddPlayerSlot(APlayerState* PlayerState)
+{
+    if (!PlayerState || PlayerSlotIndices.Contains(PlayerState))
+    {
+        return;
+    }
+
+    int32 PlayerSlot = ConnectedPlayerSlots.Find(false);
+    if (PlayerSlot == INDEX_NONE)
+    {
+        PlayerSlot = ConnectedPlayerSlots.Add(false);
+        PlayerSlots.Add(nullptr);
+    }
+    ConnectedPlayerSlots[PlayerSlot] = true;
+    PlayerSlots[PlayerSlot] = PlayerState;
+    PlayerSlotIndices.Add(PlayerState, PlayerSlot);
+}
+
+void AQuestManager::UpdateStepPlayerMask(const FQuestStepObjective& Objective)
+{
+    const int32 MaskIndex = StepPlayerMasks.IndexOfByPredicate([&Objective](const FQuestStepPlayerMask& Mask)
+    {
+        return Mask.QuestID == Objective.ParentQuestID && Mask.StepID == Objective.StepObjectiveInsideQuestOrder;
+    });
+    if (!Objective.CompletedPlayerSlots.Contains(true))
+    {
+        if (MaskIndex != INDEX_NONE)
+        {
+            StepPlayerMasks.RemoveAtSwap(MaskIndex);
+        }
+        return;
+    }
+
+    FQuestStepPlayerMask& Mask = MaskIndex != INDEX_NONE ? StepPlayerMasks[MaskIndex] : StepPlayerMasks.AddDefaulted_GetRef();
+    Mask.QuestID = Objective.ParentQuestID;
+    Mask.StepID = Objective.StepObjectiveInsideQuestOrder;
+    Mask.SlotWords = TArray<uint32>(Objective.CompletedPlayerSlots.GetData(), FMath::DivideAndRoundUp(Objective.CompletedPlayerSlots.Num(), NumBitsPerDWORD));
+}
+
+void AQuestManager::GetMemoryUsage(FQuestMemoryUsage& OutUsage) const
+{
+    OutUsage.DefinitionBytes = AllQuests.GetAllocatedSize() + QuestReferences.GetAllocatedSize() + PrerequisiteGraph.GetAllocatedSize() + TagFilters.GetAllocatedSize();
+    OutUsage.RuntimeBytes = ActiveQuests.GetAllocatedSize() + CompletedQuests.GetAllocatedSize() + SpawnedStepActors.GetAllocatedSize() + StepEventIndex.GetAllocatedSize() + Counters.GetAllocatedSize()
+        + PlayerSlots.GetAllocatedSize() + StepPlayerMasks.GetAllocatedSize() + PlayerSlotIndices.GetAllocatedSize() + ConnectedPlayerSlots.GetAllocatedSize();
+    for (const FQuestStepPlayerMask& Mask : StepPlayerMasks)
+    {
+        OutUsage.RuntimeBytes += Mask.SlotWords.GetAllocatedSize();
+    }
+    for (const FQuestStateInfo& QuestInfo : ActiveQuests)
+    {
+        OutUsage.RuntimeBytes += QuestInfo.CompletedSteps.GetAllocatedSize();
+    }
+    for (const TPair<FQuestStepEventKey, TArray<FQuestStepRef>>& Steps : StepEventIndex)
+    {
+        OutUsage.RuntimeBytes += Steps.Value.GetAllocatedSize();
+    }
+    for (const FQuestStepSpawnedActors& StepActors : SpawnedStepActors)
+    {
+        OutUsage.RuntimeBytes += StepActors.Actors.GetAllocatedSize();
+        OutUsage.SpawnedActors.Append(StepActors.Actors);
+    }
+
+    OutUsage.Quests.Reserve(AllQuests.Num());
+    for (const TSharedPtr<FQuest>& Quest : AllQuests)
+    {
+        FQuestMemoryUsage::FQuestEntry& Entry = OutUsage.Quests.AddDefaulted_GetRef();
+        Entry.QuestID = Quest->QuestID;
+        Entry.Name = Quest->Name.ToString();
+        Entry.NumSteps = Quest->ObjectivesArray.Num();
+        Entry.bActive = ActiveQuests.ContainsByPredicate([&Quest](const FQuestStateInfo& QuestInfo) { return QuestInfo.QuestID == Quest->QuestID; });
+        Entry.DefinitionBytes = sizeof(FQuest) + Quest->GetDefinitionAllocatedSize();
+        Entry.RuntimeBytes = Quest->GetRuntimeAllocatedSize();
+        for (const TSharedPtr<FQuestStepObjective>& Objective : Quest->ObjectivesArray)
+        {
+            Entry.NumSpawnedActors += Objective->SpawnedActors.Num();
+            OutUsage.SpawnedActors.Append(Objective->SpawnedActors);
+        }
+
+        OutUsage.DefinitionBytes += Entry.DefinitionBytes;
+        OutUsage.RuntimeBytes += Entry.RuntimeBytes;
+    }
+}
+
+void AQuestManager::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+    Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+    DOREPLIFETIME_CONDITION_NOTIFY(AQuestManager, ActiveQuests, COND_InitialOnly, REPNOTIFY_Always);
+    DOREPLIFETIME_CONDITION_NOTIFY(AQuestManager, CompletedQuests, COND_InitialOnly, REPNOTIFY_Always);
+    DOREPLIFETIME(AQuestManager, SpawnedStepActors);
+    DOREPLIFETIME(AQuestManager, PlayerSlots);
+    DOREPLIFETIME(AQuestManager, StepPlayerMasks);
+}
+
+
+TSharedPtr<FQuest> AQuestManager::GetQuestByID(const int IDToGet)
+{
+    TSharedPtr<FQuest> QuestToReturn = *AllQuests.FindByPredicate([&](const TSharedPtr<FQuest> quest)
+    {
+        return quest->QuestID == IDToGet;
+    });
+
+    return QuestToReturn;
+}
+
+TSharedPtr<FQuest> AQuestManager::GetQuestByID(const int IDToGet) const
+{
+    TSharedPtr<FQuest> QuestToReturn = *AllQuests.FindByPredicate([&](const TSharedPtr<FQuest> quest)
+    {
+        return quest->QuestID == IDToGet;
+    });
+
+    return QuestToReturn;
+}   
+
+TSharedPtr<FQuestStepObjective> AQuestManager::GetStepQuestByID(int IDToGet, TSharedPtr<FQuest> QuestToSearch)
+{
+    return QuestToSearch.Get()->GetStepObjectiveById(IDToGet);
+}
+
+void AQuestManager::ActivateQuestObjectives(int QuestID, int StepIDToActivate)
+{
+    PCQS_SCOPE_CYCLE_COUNTER(STAT_PCQS_StepActivation);
+    if (QuestID != -1)
+    {
+        TSharedPtr<FQuest> Quest = GetQuestByID(QuestID);
+        RemoveQuestFromEventIndex(Quest);
+
+        // Quests that are not linear resume from the steps they completed, linear ones only need to know how far they got
+        const FQuestStateInfo* QuestInfo = ActiveQuests.FindByPredicate([QuestID](const FQuestStateInfo& Info) { return Info.QuestID == QuestID; });
+        TArray<TSharedPtr<FQuestStepObjective>> CompletedObjectives;
+        if (QuestInfo && QuestInfo->CompletedSteps.Num() > 0)
+        {
+            for (int CompletedStepID : QuestInfo->CompletedSteps)
+            {
+                const int32 StepIndex = Quest->GetStepIndex(CompletedStepID);
+                if (StepIndex != INDEX_NONE)
+                {
+                    CompletedObjectives.Add(Quest->ObjectivesArray[StepIndex]);
+                }
+            }
+        }
+        else
+        {
+            for (int i = 0; i < StepIDToActivate && i < Quest->ObjectivesArray.Num(); ++i)
+            {
+                CompletedObjectives.Add(Quest->ObjectivesArray[i]);
+            }
+        }
+        for (const TSharedPtr<FQuestStepObjective>& Objective : CompletedObjectives)
+        {
+            Objective->Activate(GetWorld(), this);
+            Objective->SetCompleted();
+        }
+
+        Quest->StartSteps();
+        INC_DWORD_STAT_BY(STAT_PCQS_StepsActivated, CompletedObjectives.Num() + Quest->GetActiveSteps().Num());
+        // Activating can spawn actors but never changes the frontier, so it is safe to walk it
+        for (int32 StepIndex : Quest->GetActiveSteps())
+        {
+            Quest->ObjectivesArray[StepIndex]->Activate(GetWorld(), this);
+            AddStepToEventIndex(Quest, StepIndex);
+        }
+    }
+}
+
+void AQuestManager::ActivateQuestReferences(int QuestID)
+{
+    if (QuestID != -1)
+    {
+        if (QuestReferences.Contains(QuestID))
+        {
+            for (auto QuestActor : QuestReferences[QuestID].QuestActors)
+            {
+                if (IQuestObject* ActorAsQuestObject = Cast<IQuestObject>(QuestActor.ReferenceActor))
+                {
+                    ActorAsQuestObject->ActivateObject();
+                    IQuestObject::Execute_BP_ActivateObject(QuestActor.ReferenceActor);
+                }
+            }
+        }
+    }
+}
+
+void AQuestManager::DeactivateQuestReferences(int QuestID)
+{
+    if (QuestID != -1)
+    {
+        if (QuestReferences.Contains(QuestID))
+        {
+            for (auto QuestActor : QuestReferences[QuestID].QuestActors)
+            {
+                if (IQuestObject* ActorAsQuestObject = Cast<IQuestObject>(QuestActor.ReferenceActor))
+                {
+                    ActorAsQuestObject->DeactivateObject(false);
+                    IQuestObject::Execute_BP_DeactivateObject(QuestActor.ReferenceActor, false);
+                }
+            }
+        }
+    }
+}
+
+void AQuestManager::OnQuestCompleted(TSharedPtr<FQuest> CompletedQuest)
+{
+    PendingCompletedQuests.AddUnique(CompletedQuest->QuestID);
+}
+
+void AQuestManager::OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+    if (World == GetWorld())
+    {
+        // Before the completions, so the quests these events finish go out this frame
+        if (CoalescedEvents.Num() > 0 && GetWorld()->GetTimeSeconds() - CoalescingWindowStart >= CVarEventCoalescingWindow.GetValueOnGameThread())
+        {
+            FlushCoalescedEvents();
+        }
+        FlushCompletedQuests();
+    }
+}
+
+void AQuestManager::FlushCompletedQuests()
+{
+    if (PendingCompletedQuests.Num() == 0)
+    {
+        return;
+    }
+
+    // Moved out first, listeners can complete more quests and those go out next frame
+    const TArray<int> CompletedQuestIDs = MoveTemp(PendingCompletedQuests);
+    PendingCompletedQuests.Reset();
+    OnQuestsCompleted(CompletedQuestIDs);
+}
+
+void AQuestManager::OnQuestsCompleted_Implementation(const TArray<int>& CompletedQuestIDs)
+{
+    PCQS_SCOPE_CYCLE_COUNTER(STAT_PCQS_QuestCompletion);
+    INC_DWORD_STAT_BY(STAT_PCQS_QuestsCompleted, CompletedQuestIDs.Num());
+    TArray<int> NewlyAvailableQuests;
+    for (int CompletedQuestID : CompletedQuestIDs)
+    {
+        TSharedPtr<FQuest> CompletedQuest = GetQuestByID(CompletedQuestID);
+        // Optional steps can still be active when the required ones are done
+        for (int32 StepIndex : CompletedQuest->GetActiveSteps())
+        {
+            CompletedQuest->ObjectivesArray[StepIndex]->Deactivate(false);
+        }
+        RemoveActiveQuest(CompletedQuestID);
+        RemoveSpawnedStepActors(CompletedQuestID);
+        OnQuestCompletedDelegate.Broadcast(*CompletedQuest.Get());
+        DeactivateQuestReferences(CompletedQuestID);
+        CompletedQuests.Add(CompletedQuestID);
+
+        // Only the quests that depend on this one are updated, games pick what comes next from OnQuestAvailable
+        {
+            PCQS_SCOPE_CYCLE_COUNTER(STAT_PCQS_AvailabilityUpdate);
+            PrerequisiteGraph.CompleteQuest(CompletedQuestID, &NewlyAvailableQuests);
+        }
+    }
+    for (int AvailableQuestID : NewlyAvailableQuests)
+    {
+        OnQuestAvailable.Broadcast(*GetQuestByID(AvailableQuestID).Get());
+    }
+}
+
+void AQuestManager::OnStepQuestCompleted_Implementation(int CompletedStepQuestID, int QuestIDWhereStepBelongs)
+{
+    TSharedPtr<FQuest> QuestWhereStepBelongs = GetQuestByID(QuestIDWhereStepBelongs);
+    const int32 CompletedStepIndex = QuestWhereStepBelongs->GetStepIndex(CompletedStepQuestID);
+    TSharedPtr<FQuestStepObjective> CompletedStepQuest = QuestWhereStepBelongs->ObjectivesArray[CompletedStepIndex];
+
+    TArray<int32> ActivatedSteps;
+    TArray<int32> SkippedSteps;
+    RemoveStepFromEventIndex(QuestWhereStepBelongs, CompletedStepIndex);
+    QuestWhereStepBelongs->CompleteStep(CompletedStepIndex, ActivatedSteps, SkippedSteps);
+    for (int32 SkippedStepIndex : SkippedSteps)
+    {
+        RemoveStepFromEventIndex(QuestWhereStepBelongs, SkippedStepIndex);
+        QuestWhereStepBelongs->ObjectivesArray[SkippedStepIndex]->Deactivate(false);
+    }
+
+    if (ActivatedSteps.Num() > 0)
+    {
+        PCQS_SCOPE_CYCLE_COUNTER(STAT_PCQS_StepActivation);
+        INC_DWORD_STAT_BY(STAT_PCQS_StepsActivated, ActivatedSteps.Num());
+        for (int32 ActivatedStepIndex : ActivatedSteps)
+        {
+            QuestWhereStepBelongs->ObjectivesArray[ActivatedStepIndex]->Activate(GetWorld(), this);
+            AddStepToEventIndex(QuestWhereStepBelongs, ActivatedStepIndex);
+        }
+    }
+
+    for (FQuestStateInfo& ActiveQuest : ActiveQuests)
+    {
+        if (ActiveQuest.QuestID == QuestIDWhereStepBelongs)
+        {
+            if (ActivatedSteps.Num() > 0)
+            {
+                ActiveQuest.CurrentStepQuestObjectID++;
+            }
+            ActiveQuest.CompletedSteps.Add(CompletedStepQuestID);
+        }
+    }
+    CompletedStepQuest->SetCompleted();
+    OnQuestStepCompletedDelegate.Broadcast(*CompletedStepQuest.Get(), *QuestWhereStepBelongs.Get());
+}
+
+void AQuestManager::OnStepProgressed(const FQuestStepRef& Step)
+{
+    const TSharedPtr<FQuestStepObjective>& Objective = Step.Quest->ObjectivesArray[Step.StepIndex];
+    if (Objective->IsCompleted())
+    {
+        OnStepQuestCompleted(Objective->StepObjectiveInsideQuestOrder, Step.Quest->QuestID);
+        // Optional steps finished after the required ones would complete the quest twice
+        if (!Objective->bOptional && Step.Quest->AreRequiredStepsCompleted())
+        {
+            OnQuestCompleted(Step.Quest);
+        }
+    }
+}
+
+void AQuestManager::AddStepToEventIndex(const TSharedPtr<FQuest>& Quest, int32 StepIndex)
+{
+    const TSharedPtr<FQuestStepObjective>& Objective = Quest->ObjectivesArray[StepIndex];
+    if (IsCountedStepType(Objective->QuestStepType))
+    {
+        if (HasAuthority())
+        {
+            Counters.AddStep({ Quest, StepIndex });
+        }
+        return;
+    }
+
+    TArray<FGameplayTag> EventTags;
+    Objective->GetEventTags(EventTags);
+    for (const FGameplayTag& EventTag : EventTags)
+    {
+        TArray<FQuestStepRef>& Steps = StepEventIndex.FindOrAdd({ Objective->QuestStepType, EventTag, Objective->bMatchChildTags });
+        if (!Steps.ContainsByPredicate([&](const FQuestStepRef& Step) { return Step.Quest == Quest && Step.StepIndex == StepIndex; }))
+        {
+            Steps.Add({ Quest, StepIndex });
+        }
+    }
+}
+
+void AQuestManager::RemoveStepFromEventIndex(const TSharedPtr<FQuest>& Quest, int32 StepIndex)
+{
+    const TSharedPtr<FQuestStepObjective>& Objective = Quest->ObjectivesArray[StepIndex];
+    if (Objective->bRequiresAllPlayers && HasAuthority())
+    {
+        Objective->CompletedPlayerSlots.Empty();
+        UpdateStepPlayerMask(*Objective);
+    }
+    if (IsCountedStepType(Objective->QuestStepType))
+    {
+        Counters.RemoveStep({ Quest, StepIndex });
+        return;
+    }
+
+    TArray<FGameplayTag> EventTags;
+    Objective->GetEventTags(EventTags);
+    for (const FGameplayTag& EventTag : EventTags)
+    {
+        const FQuestStepEventKey Key{ Objective->QuestStepType, EventTag, Objective->bMatchChildTags };
+        if (TArray<FQuestStepRef>* Steps = StepEventIndex.Find(Key))
+        {
+            Steps->RemoveAllSwap([&](const FQuestStepRef& Step) { return Step.Quest == Quest && Step.StepIndex == StepIndex; });
+            if (Steps->Num() == 0)
+            {
+                StepEventIndex.Remove(Key);
+            }
+        }
+    }
+}
+
+void AQuestManager::RemoveQuestFromEventIndex(const TSharedPtr<FQuest>& Quest)
+{
+    if (Quest.IsValid())
+    {
+        for (int32 StepIndex : Quest->GetActiveSteps())
+        {
+            RemoveStepFromEventIndex(Quest, StepIndex);
+        }
+    }
+}
+
+void AQuestManager::GetEventKeys(EQuestStepType StepType, const FGameplayTag& Tag, TArray<FQuestStepEventKey, TInlineAllocator<4>>& OutKeys)
+{
+    OutKeys.Add({ StepType, Tag });
+    TArray<FGameplayTag, TInlineAllocator<4>> Filters;
+    TagFilters.GetMatchingFilters(Tag, Filters);
+    for (const FGameplayTag& Filter : Filters)
+    {
+        OutKeys.Add({ StepType, Filter, true });
+    }
+}
+
+TArray<FQuestStepRef> AQuestManager::GetStepsForEvent(EQuestStepType StepType, FGameplayTag Tag)
+{
+    TArray<FQuestStepEventKey, TInlineAllocator<4>> EventKeys;
+    GetEventKeys(StepType, Tag, EventKeys);
+    TArray<FQuestStepRef> EventSteps;
+    for (const FQuestStepEventKey& EventKey : EventKeys)
+    {
+        if (const TArray<FQuestStepRef>* Steps = StepEventIndex.Find(EventKey))
+        {
+            EventSteps.Append(*Steps);
+        }
+    }
+    return EventSteps;
+}
+
+void FQuestCounterTable::AddStep(const FQuestStepRef& Step)
+{
+    // Activating a step that is already counted starts it over
+    RemoveStep(Step);
+    FQuestStepObjective& Objective = *Step.Quest->ObjectivesArray[Step.StepIndex];
+    TArray<FQuestStepEventKey, TInlineAllocator<4>> Keys;
+    GetStepKeys(Objective, Keys);
+    Objective.CounterBaseline = 0.f;
+    for (const FQuestStepEventKey& Key : Keys)
+    {
+        Objective.CounterBaseline += Counters.FindOrAdd(Key).Value;
+    }
+    InsertStep(Step, nullptr);
+}
+
+void FQuestCounterTable::RemoveStep(const FQuestStepRef& Step)
+{
+    TArray<FQuestStepEventKey, TInlineAllocator<4>> Keys;
+    GetStepKeys(*Step.Quest->ObjectivesArray[Step.StepIndex], Keys);
+    for (const FQuestStepEventKey& Key : Keys)
+    {
+        if (FCounter* Counter = Counters.Find(Key))
+        {
+            // Kept in order, equal targets complete in the order they were added
+            Counter->Thresholds.RemoveAll([&Step](const FThreshold& Threshold) { return Threshold.Step == Step; });
+            Counter->Watchers.RemoveAllSwap([&Step](const FQuestStepRef& Watcher) { return Watcher == Step; });
+            if (Counter->Thresholds.Num() == 0 && Counter->Watchers.Num() == 0)
+            {
+                Counters.Remove(Key);
+            }
+        }
+    }
+}
+
+void FQuestCounterTable::RebaseStep(const FQuestStepRef& Step, float Amount, TArray<FQuestStepRef>& OutReached)
+{
+    TArray<FQuestStepEventKey, TInlineAllocator<4>> Keys;
+    FQuestStepObjective& Objective = *Step.Quest->ObjectivesArray[Step.StepIndex];
+    GetStepKeys(Objective, Keys);
+    for (const FQuestStepEventKey& Key : Keys)
+    {
+        if (FCounter* Counter = Counters.Find(Key))
+        {
+            Counter->Thresholds.RemoveAll([&Step](const FThreshold& Threshold) { return Threshold.Step == Step; });
+            Counter->Watchers.RemoveAllSwap([&Step](const FQuestStepRef& Watcher) { return Watcher == Step; });
+        }
+    }
+    Objective.CounterBaseline -= Amount;
+    InsertStep(Step, &OutReached);
+}
+
+void FQuestCounterTable::WatchStep(const FQuestStepRef& Step)
+{
+    TArray<FQuestStepEventKey, TInlineAllocator<4>> Keys;
+    GetStepKeys(*Step.Quest->ObjectivesArray[Step.StepIndex], Keys);
+    for (const FQuestStepEventKey& Key : Keys)
+    {
+        FCounter& Counter = Counters.FindOrAdd(Key);
+        Counter.Thresholds.RemoveAll([&Step](const FThreshold& Threshold) { return Threshold.Step == Step; });
+        Counter.Watchers.AddUnique(Step);
+    }
+}
+
+void FQuestCounterTable::Empty()
+{
+    Counters.Reset();
+}
+
+void FQuestCounterTable::Add(const FQuestStepEventKey& Key, float Amount, TArray<FQuestStepRef>& OutReached)
+{
+    FCounter* Counter = Counters.Find(Key);
+    if (!Counter)
+    {
+        return;
+    }
+
+    Counter->Value += Amount;
+    while (Counter->Thresholds.Num() > 0 && Counter->Thresholds.Last().Target <= Counter->Value)
+    {
+        OutReached.Add(Counter->Thresholds.Pop(false).Step);
+    }
+    for (const FQuestStepRef& Watcher : Counter->Watchers)
+    {
+        const FQuestStepObjective& Objective = *Watcher.Quest->ObjectivesArray[Watcher.StepIndex];
+        if (GetProgress(Objective) >= Objective.GetCounterTarget())
+        {
+            OutReached.Add(Watcher);
+        }
+    }
+}
+
+bool FQuestCounterTable::WouldReach(const FQuestStepEventKey& Key, float Amount) const
+{
+    const FCounter* Counter = Counters.Find(Key);
+    if (!Counter)
+    {
+        return false;
+    }
+    return Counter->Watchers.Num() > 0 || (Counter->Thresholds.Num() > 0 && Counter->Thresholds.Last().Target <= Counter->Value + Amount);
+}
 
-void AQuestManager::OnQuestCompletedNextTick_Implementation(int CompletedQuestID)
+float FQuestCounterTable::GetValue(const FQuestStepEventKey& Key) const
 {
-    RemoveActiveQuest(CompletedQuestID);
-    TSharedPtr<FQuest> CompletedQuest = GetQuestByID(CompletedQuestID);
-    OnQuestCompletedDelegate.Broadcast(*CompletedQuest.Get());
-    DeactivateQuestReferences(CompletedQuestID);
-    CompletedQuests.Add(CompletedQuestID);
+    const FCounter* Counter = Counters.Find(Key);
+    return Counter ? Counter->Value : 0.f;
+}
 
-    // TODO: Maybe we want to put the next main quest as the current quest?
+float FQuestCounterTable::GetProgress(const FQuestStepObjective& Objective) const
+{
+    TArray<FQuestStepEventKey, TInlineAllocator<4>> Keys;
+    GetStepKeys(Objective, Keys);
+    float Total = 0.f;
+    for (const FQuestStepEventKey& Key : Keys)
+    {
+        Total += GetValue(Key);
+    }
+    return Total - Objective.CounterBaseline;
 }
 
-void AQuestManager::OnStepQuestCompleted_Implementation(int CompletedStepQuestID, int QuestIDWhereStepBelongs)
+SIZE_T FQuestCounterTable::GetAllocatedSize() const
 {
-    TSharedPtr<FQuest> QuestWhereStepBelongs = GetQuestByID(QuestIDWhereStepBelongs);
-    TSharedPtr<FQuestStepObjective> CompletedStepQuest = GetStepQuestByID(CompletedStepQuestID, QuestWhereStepBelongs);
-    auto NextObjective = QuestWhereStepBelongs->GetCurrentObjectiveSharedPtr();
-    if (NextObjective.IsValid())
+    SIZE_T Size = Counters.GetAllocatedSize();
+    for (const TPair<FQuestStepEventKey, FCounter>& Counter : Counters)
     {
-        NextObjective->Activate(GetWorld(), this);
+        Size += Counter.Value.Thresholds.GetAllocatedSize() + Counter.Value.Watchers.GetAllocatedSize();
+    }
+    return Size;
+}
 
-        for (FQuestStateInfo& ActiveQuest : ActiveQuests)
+void FQuestCounterTable::GetStepKeys(const FQuestStepObjective& Objective, TArray<FQuestStepEventKey, TInlineAllocator<4>>& OutKeys)
+{
+    TArray<FGameplayTag> Tags;
+    Objective.GetEventTags(Tags);
+    for (const FGameplayTag& Tag : Tags)
+    {
+        const bool bUnderOtherFilter = Objective.bMatchChildTags && Tags.ContainsByPredicate([&Tag](const FGameplayTag& Other) { return Other != Tag && Tag.MatchesTag(Other); });
+        if (!bUnderOtherFilter)
         {
-            if (ActiveQuest.QuestID == QuestIDWhereStepBelongs)
-            {
-                ActiveQuest.CurrentStepQuestObjectID++;
-            }
+            OutKeys.AddUnique({ Objective.QuestStepType, Tag, Objective.bMatchChildTags });
         }
     }
-    CompletedStepQuest->SetCompleted();
-    OnQuestStepCompletedDelegate.Broadcast(*CompletedStepQuest.Get(), *QuestWhereStepBelongs.Get());
+}
+
+void FQuestCounterTable::InsertStep(const FQuestStepRef& Step, TArray<FQuestStepRef>* OutReached)
+{
+    const FQuestStepObjective& Objective = *Step.Quest->ObjectivesArray[Step.StepIndex];
+    TArray<FQuestStepEventKey, TInlineAllocator<4>> Keys;
+    GetStepKeys(Objective, Keys);
+    const bool bReached = OutReached && GetProgress(Objective) >= Objective.GetCounterTarget();
+    if (Keys.Num() > 1)
+    {
+        for (const FQuestStepEventKey& Key : Keys)
+        {
+            Counters.FindOrAdd(Key).Watchers.Add(Step);
+        }
+    }
+    else if (!bReached && Keys.Num() == 1)
+    {
+        const float Target = Objective.CounterBaseline + Objective.GetCounterTarget();
+        TArray<FThreshold>& Thresholds = Counters.FindOrAdd(Keys[0]).Thresholds;
+        Thresholds.Insert({ Target, Step }, Algo::LowerBoundBy(Thresholds, Target, &FThreshold::Target, TGreater<>()));
+    }
+
+    if (bReached)
+    {
+        OutReached->Add(Step);
+    }
+}
+
+void FQuestStepObjective::OnCompleted(APlayerController* CompletedBy)
+{
+    if (CompletedBy == nullptr)
+    {
+        return;
+    }
+
+    if (!bRequiresAllPlayers)
+    {
+        bIsCompleted = true;
+        return;
+    }
+    // Who got here is only tracked on the server, clients are told through OnStepQuestCompleted once everyone has
+    AQuestManager* QuestManager = OwningQuestManager.Get();
+    if (QuestManager && QuestManager->HasAuthority())
+    {
+        QuestManager->MarkPlayerCompleted(*this, CompletedBy);
+    }
+}
+
+void FQuestStepObjective::OnCountReached(APlayerController* CompletedBy)
+{
+    if (!bRequiresAllPlayers)
+    {
+        bIsCompleted = true;
+        return;
+    }
+    OnCompleted(CompletedBy);
+}
+
+bool FQuestStepObjective::UpdatePlayerCompletion(const TBitArray<>& ConnectedPlayerSlots)
+{
+    const uint32* ConnectedWords = ConnectedPlayerSlots.GetData();
+    const uint32* CompletedWords = CompletedPlayerSlots.GetData();
+    const int32 NumConnectedWords = FMath::DivideAndRoundUp(ConnectedPlayerSlots.Num(), NumBitsPerDWORD);
+    const int32 NumCompletedWords = FMath::DivideAndRoundUp(CompletedPlayerSlots.Num(), NumBitsPerDWORD);
+    bool bAnyConnected = false;
+    for (int32 Word = 0; Word < NumConnectedWords; ++Word)
+    {
+        const uint32 CompletedWord = Word < NumCompletedWords ? CompletedWords[Word] : 0u;
+        if (ConnectedWords[Word] & ~CompletedWord)
+        {
+            return false;
+        }
+        bAnyConnected |= ConnectedWords[Word] != 0;
+    }
+    bIsCompleted = bAnyConnected;
+    return bIsCompleted;
+}
+
+bool FQuestStepObjective::MatchesEventTag(const FGameplayTag& Tag) const
+{
+    TArray<FGameplayTag> EventTags;
+    GetEventTags(EventTags);
+    return EventTags.ContainsByPredicate([&](const FGameplayTag& EventTag) { return bMatchChildTags ? Tag.MatchesTag(EventTag) : Tag == EventTag; });
 }
 
 FString FQuestStepObjective::SplitEnumString(FString EnumString)
@@ -588,18 +1684,94 @@ FString FQuestStepObjective::SplitEnumString(FString EnumString)
     return RightSplit;
 }
 
+void FQuestStepObjective::Deactivate(bool bReset)
+{
+    DeactivateActorMarker();
+
+    for (AActor* AssociatedActor : ActorsAssociated)
+    {
+        if (IQuestObject* ActorAsQuestObject = Cast<IQuestObject>(AssociatedActor))
+        {
+            ActorAsQuestObject->DeactivateObject(bReset);
+            ActorAsQuestObject->Execute_BP_DeactivateObject(AssociatedActor, bReset);
+        }
+    }
+}
+
+void FQuestStepObjective::ActivateActorMarker()
+{
+    for (AActor* AssociatedActor : ActorsAssociated)
+    {
+        if (UIconMarkerComponent* ActorMarkerComponent = IsValid(AssociatedActor) ? AssociatedActor->FindComponentByClass<UIconMarkerComponent>() : nullptr)
+        {
+            ActorMarkerComponent->ActivateMarker();
+        }
+    }
+
+    if (UMarkerSubsystem* Markers = MarkerSubsystem.Get())
+    {
+        for (const FMarkerHandle& MarkerHandle : MarkerHandles)
+        {
+            Markers->ActivateMarker(MarkerHandle);
+        }
+    }
+}
+
+void FQuestStepObjective::DeactivateActorMarker()
+{
+    for (AActor* AssociatedActor : ActorsAssociated)
+    {
+        if (UIconMarkerComponent* ActorMarkerComponent = IsValid(AssociatedActor) ? AssociatedActor->FindComponentByClass<UIconMarkerComponent>() : nullptr)
+        {
+            ActorMarkerComponent->DeactivateMarker();
+        }
+    }
+
+    if (UMarkerSubsystem* Markers = MarkerSubsystem.Get())
+    {
+        for (const FMarkerHandle& MarkerHandle : MarkerHandles)
+        {
+            Markers->DeactivateMarker(MarkerHandle);
+        }
+    }
+}
+
 void FQuestStepObjective::AddIconMarkerToAssociatedActor()
 {
-    if (ObjectiveMarkerUMGInformation.bCreateMarker)
+    AActor* AssociatedActor = ActorsAssociated.Num() > 0 ? ActorsAssociated.Last() : nullptr;
+    if (!ObjectiveMarkerUMGInformation.bCreateMarker || !AssociatedActor)
+    {
+        return;
+    }
+
+    // Hand placed markers are activated through their own component
+    if (AssociatedActor->FindComponentByClass<UIconMarkerComponent>())
+    {
+        return;
+    }
+
+    if (!MarkerSubsystem.IsValid())
+    {
+        MarkerSubsystem = UMarkerSubsystem::Get(AssociatedActor);
+    }
+
+    if (UMarkerSubsystem* Markers = MarkerSubsystem.Get())
+    {
+        MarkerHandles.Add(Markers->AddMarker(AssociatedActor, ObjectiveMarkerUMGInformation.ObjectiveMarkerUMGClass, ObjectiveMarkerUMGInformation.IconToUse,
+            ObjectiveMarkerUMGInformation.MarkerToActorOffset, ObjectiveMarkerUMGInformation.bShowOnScreen, ObjectiveMarkerUMGInformation.bShowOnCompass, ObjectiveMarkerUMGInformation.MarkerPriority));
+    }
+}
+
+void FQuestStepObjective::RemoveIconMarkers()
+{
+    if (UMarkerSubsystem* Markers = MarkerSubsystem.Get())
     {
-        UIconMarkerComponent* IconMarkerComponent = Cast<UIconMarkerComponent>(ActorsAssociated[ActorsAssociated.Num() - 1]->AddComponentByClass(UIconMarkerComponent::StaticClass(), false, FTransform(), false));
-        IconMarkerComponent->SetIsReplicated(true);
-        IconMarkerComponent->SetMarkerUMGToUse(ObjectiveMarkerUMGInformation.ObjectiveMarkerUMGClass);
-        IconMarkerComponent->bShowOnCompass = ObjectiveMarkerUMGInformation.bShowOnCompass;
-        IconMarkerComponent->bShowOnScreen = ObjectiveMarkerUMGInformation.bShowOnScreen;
-        IconMarkerComponent->MarkerIcon = ObjectiveMarkerUMGInformation.IconToUse;
-        IconMarkerComponent->ActorOffset = ObjectiveMarkerUMGInformation.MarkerToActorOffset;
+        for (FMarkerHandle& MarkerHandle : MarkerHandles)
+        {
+            Markers->RemoveMarker(MarkerHandle);
+        }
     }
+    MarkerHandles.Empty();
 }
 
 void FQuestStepGoToObjective::Activate(UWorld* WorldContext, AQuestManager* QuestManager)
@@ -618,7 +1790,7 @@ void FQuestStepGoToObjective::Activate(UWorld* WorldContext, AQuestManager* Ques
         {
             if (ALocationTrigger* LocTrigger = Cast<ALocationTrigger>(LocationTrigger))
             {
-                if (LocTrigger->GetLocation() == PlaceToGo)
+                if (MatchesEventTag(LocTrigger->GetLocation()))
                 {
                     ReferenceActor = LocTrigger;
                 }
@@ -629,17 +1801,14 @@ void FQuestStepGoToObjective::Activate(UWorld* WorldContext, AQuestManager* Ques
     if (ReferenceActor)
     {
         QuestManager->AddAssociatedActorToQuestStep(StepObjectiveInsideQuestOrder, ParentQuestID, ReferenceActor);
-        if (ReferenceActor->FindComponentByClass<UIconMarkerComponent>() == nullptr)
-        {
-            AddIconMarkerToAssociatedActor();
-        }
     }
     Super::Activate(WorldContext, QuestManager);
 }
 
 void FQuestStepTalkWithObjective::Activate(UWorld* WorldContext, AQuestManager* QuestManager)
 {
-    if (PawnToSpawnWhenActive)
+    // Only the server spawns, clients get the spawned actors through OnRep_SpawnedStepActors
+    if (PawnToSpawnWhenActive && QuestManager->HasAuthority())
     {
         QuestManager->SpawnActor(PawnToSpawnWhenActive, WorldPositionToSpawn, WorldRotationToSpawn);
 
@@ -650,7 +1819,7 @@ void FQuestStepTalkWithObjective::Activate(UWorld* WorldContext, AQuestManager*
             {
                 ActorAsQuestObject->SetTag(EntityToTalkWith);
             }
-            QuestManager->AddAssociatedActorToQuestStep(StepObjectiveInsideQuestOrder, ParentQuestID, SpawnedActor);
+            QuestManager->AddSpawnedActorToQuestStep(StepObjectiveInsideQuestOrder, ParentQuestID, SpawnedActor);
         }
     }
 
@@ -667,19 +1836,23 @@ void FQuestStepTalkWithObjective::Activate(UWorld* WorldContext, AQuestManager*
 
 void FQuestStepKillObjective::Activate(UWorld* WorldContext, AQuestManager* QuestManager)
 {
-    for (TSubclassOf<AActor> SubClassActor : SpawnInformation.PawnsToSpawnWhenActive)
+    // Only the server spawns, clients get the spawned actors through OnRep_SpawnedStepActors
+    if (QuestManager->HasAuthority())
     {
-        for (int i = 0; i < SpawnInformation.NumToSpawnOfEachPawn; ++i)
+        for (TSubclassOf<AActor> SubClassActor : SpawnInformation.PawnsToSpawnWhenActive)
         {
-            FVector SpawnLocation = SpawnInformation.SpawnCenter;
-            SpawnLocation.X += FMath::RandRange(-SpawnInformation.SpawnRange, SpawnInformation.SpawnRange);
-            SpawnLocation.Y += FMath::RandRange(-SpawnInformation.SpawnRange, SpawnInformation.SpawnRange);
-            QuestManager->SpawnActor(SubClassActor, SpawnLocation, FRotator::ZeroRotator);
-           
-            if (AActor* SpawnedActor = QuestManager->GetLastSpawnedActor())
+            for (int i = 0; i < SpawnInformation.NumToSpawnOfEachPawn; ++i)
             {
-                SpawnedActors.Add(SpawnedActor);
-                QuestManager->AddAssociatedActorToQuestStep(StepObjectiveInsideQuestOrder, ParentQuestID, SpawnedActor);
+                FVector SpawnLocation = SpawnInformation.SpawnCenter;
+                SpawnLocation.X += FMath::RandRange(-SpawnInformation.SpawnRange, SpawnInformation.SpawnRange);
+                SpawnLocation.Y += FMath::RandRange(-SpawnInformation.SpawnRange, SpawnInformation.SpawnRange);
+                QuestManager->SpawnActor(SubClassActor, SpawnLocation, FRotator::ZeroRotator);
+
+                if (AActor* SpawnedActor = QuestManager->GetLastSpawnedActor())
+                {
+                    SpawnedActors.Add(SpawnedActor);
+                    QuestManager->AddSpawnedActorToQuestStep(StepObjectiveInsideQuestOrder, ParentQuestID, SpawnedActor);
+                }
             }
         }
     }
@@ -695,24 +1868,32 @@ void FQuestStepKillObjective::Activate(UWorld* WorldContext, AQuestManager* Ques
     Super::Activate(WorldContext, QuestManager);
 }
 
+void FQuest::Init()
+{
+    ForEachObjectiveTraits([this](auto Traits)
+    {
+        using FTraits = decltype(Traits);
+        for (const auto& Row : this->*FTraits::Rows)
+        {
+            ObjectivesArray.Emplace(MakeShareable(FTraits::MakeObjective(QuestID, Row.Key, Row.Value)));
+            ObjectivesArray.Last()->CopyStepSettings(Row.Value);
+        }
+    });
+    ObjectivesArray.Sort([](TSharedPtr<FQuestStepObjective> StepObjective1, TSharedPtr<FQuestStepObjective> StepObjective2) { return StepObjective1->StepObjectiveInsideQuestOrder < StepObjective2->StepObjectiveInsideQuestOrder; });
+    BuildStepGraph();
+}
+
 void FQuest::ActivateCurrentObjective(UWorld* ContextWorld, AQuestManager* QuestManager)
 {
     TSharedPtr<FQuestStepObjective> NextObjective = GetCurrentObjectiveSharedPtr();
     if (NextObjective.IsValid())
     {
-        switch (NextObjective->QuestStepType)
+        PCQS_SCOPE_CYCLE_COUNTER(STAT_PCQS_StepActivation);
+        INC_DWORD_STAT(STAT_PCQS_StepsActivated);
+        VisitObjective(*NextObjective, [ContextWorld, QuestManager](auto Traits, auto& Objective)
         {
-        case EQuestStepType::None:
-        case EQuestStepType::GoTo:
-        case EQuestStepType::Kill:
-        case EQuestStepType::Gather:
-            NextObjective->Activate(ContextWorld, QuestManager);
-            break;
-        case EQuestStepType::TalkWith:
-            TSharedPtr<FQuestStepTalkWithObjective> TalkWithObjective = StaticCastSharedPtr<FQuestStepTalkWithObjective>(NextObjective);
-            TalkWithObjective->Activate(ContextWorld, QuestManager);
-            break;
-        }
+            Objective.Activate(ContextWorld, QuestManager);
+        });
     }
 }
 
@@ -722,4 +1903,288 @@ void FQuest::DeactivateObjective(TSharedPtr<FQuestStepObjective> ObjectiveToDeac
     {
         ObjectiveToDeactivate->Deactivate(false);
     }
-}
\ No newline at end of file
+}
+
+void FQuest::BuildStepGraph()
+{
+    StepNodes.Reset();
+    StepNodes.SetNum(ObjectivesArray.Num());
+    for (int32 StepIndex = 0; StepIndex < ObjectivesArray.Num(); ++StepIndex)
+    {
+        const FQuestStepObjective& Objective = *ObjectivesArray[StepIndex];
+        FStepNode& Node = StepNodes[StepIndex];
+        if (Objective.bActiveOnQuestStart)
+        {
+            continue;
+        }
+        if (Objective.RequiredSteps.Num() == 0)
+        {
+            if (StepIndex > 0)
+            {
+                Node.Required.Add(StepIndex - 1);
+            }
+            continue;
+        }
+
+        for (int RequiredStepID : Objective.RequiredSteps)
+        {
+            const int32 RequiredIndex = GetStepIndex(RequiredStepID);
+            if (RequiredIndex == INDEX_NONE || RequiredIndex == StepIndex)
+            {
+                UE_LOG(LogPCQuestSystem, Warning, TEXT("Step %d of quest %d requires an invalid step %d, ignoring it"), Objective.StepObjectiveInsideQuestOrder, QuestID, RequiredStepID);
+                continue;
+            }
+            Node.Required.AddUnique(RequiredIndex);
+        }
+    }
+
+    for (int32 StepIndex = 0; StepIndex < StepNodes.Num(); ++StepIndex)
+    {
+        for (int32 RequiredIndex : StepNodes[StepIndex].Required)
+        {
+            StepNodes[RequiredIndex].Dependents.Add(StepIndex);
+        }
+    }
+
+    // Whatever a topological walk does not reach is waiting on itself, steps that need any requirement are reached by the first one
+    TArray<int32> PendingRequirements;
+    TArray<int32> Ready;
+    PendingRequirements.Reserve(StepNodes.Num());
+    for (int32 StepIndex = 0; StepIndex < StepNodes.Num(); ++StepIndex)
+    {
+        const int32 NumRequired = StepNodes[StepIndex].Required.Num();
+        PendingRequirements.Add(ObjectivesArray[StepIndex]->bRequireAnyStep ? FMath::Min(NumRequired, 1) : NumRequired);
+        if (PendingRequirements[StepIndex] == 0)
+        {
+            Ready.Add(StepIndex);
+        }
+    }
+    int32 NumReached = 0;
+    while (Ready.Num() > 0)
+    {
+        const FStepNode& Node = StepNodes[Ready.Pop(false)];
+        ++NumReached;
+        for (int32 DependentIndex : Node.Dependents)
+        {
+            if (PendingRequirements[DependentIndex] > 0 && --PendingRequirements[DependentIndex] == 0)
+            {
+                Ready.Add(DependentIndex);
+            }
+        }
+    }
+    bStepGraphValid = NumReached == StepNodes.Num();
+    for (int32 StepIndex = 0; !bStepGraphValid && StepIndex < StepNodes.Num(); ++StepIndex)
+    {
+        if (PendingRequirements[StepIndex] > 0)
+        {
+            UE_LOG(LogPCQuestSystem, Error, TEXT("Step %d of quest %d is part of a step cycle, the quest is rejected"), ObjectivesArray[StepIndex]->StepObjectiveInsideQuestOrder, QuestID);
+        }
+    }
+}
+
+void FQuest::ResetStepGraph()
+{
+    for (FStepNode& Node : StepNodes)
+    {
+        Node.NumPendingRequirements = 0;
+        Node.ActiveIndex = INDEX_NONE;
+        Node.bCompleted = false;
+        Node.bSkipped = false;
+    }
+    ActiveSteps.Reset();
+    NumRequiredStepsLeft = 0;
+}
+
+void FQuest::StartSteps()
+{
+    ResetStepGraph();
+    for (int32 StepIndex = 0; StepIndex < StepNodes.Num(); ++StepIndex)
+    {
+        StepNodes[StepIndex].bCompleted = ObjectivesArray[StepIndex]->IsCompleted();
+    }
+
+    for (int32 StepIndex = 0; StepIndex < StepNodes.Num(); ++StepIndex)
+    {
+        FStepNode& Node = StepNodes[StepIndex];
+        if (Node.bCompleted)
+        {
+            continue;
+        }
+        Node.NumPendingRequirements = GetNumPendingRequirements(StepIndex);
+        if (!ObjectivesArray[StepIndex]->bOptional)
+        {
+            ++NumRequiredStepsLeft;
+        }
+        if (Node.NumPendingRequirements == 0)
+        {
+            AddActiveStep(StepIndex);
+        }
+    }
+
+    // A quest resumed after one of its branches was taken drops the others. Nothing is activated yet, so what was dropped needs no cleanup
+    TArray<int32> SkippedSteps;
+    for (int32 StepIndex = 0; StepIndex < StepNodes.Num(); ++StepIndex)
+    {
+        if (StepNodes[StepIndex].bCompleted || StepNodes[StepIndex].ActiveIndex != INDEX_NONE)
+        {
+            for (int32 RequiredIndex : StepNodes[StepIndex].Required)
+            {
+                TrySkipStep(RequiredIndex, SkippedSteps);
+            }
+        }
+    }
+}
+
+void FQuest::CompleteStep(int32 StepIndex, TArray<int32>& OutActivatedSteps, TArray<int32>& OutSkippedSteps)
+{
+    if (!StepNodes.IsValidIndex(StepIndex) || StepNodes[StepIndex].bCompleted)
+    {
+        return;
+    }
+
+    FStepNode& Node = StepNodes[StepIndex];
+    Node.bCompleted = true;
+    RemoveActiveStep(StepIndex);
+    if (!ObjectivesArray[StepIndex]->bOptional && !Node.bSkipped)
+    {
+        --NumRequiredStepsLeft;
+    }
+
+    for (int32 DependentIndex : Node.Dependents)
+    {
+        FStepNode& Dependent = StepNodes[DependentIndex];
+        if (Dependent.bCompleted || Dependent.bSkipped || Dependent.NumPendingRequirements == 0)
+        {
+            continue;
+        }
+        Dependent.NumPendingRequirements = ObjectivesArray[DependentIndex]->bRequireAnyStep ? 0 : Dependent.NumPendingRequirements - 1;
+        if (Dependent.NumPendingRequirements > 0)
+        {
+            continue;
+        }
+
+        AddActiveStep(DependentIndex);
+        OutActivatedSteps.Add(DependentIndex);
+        for (int32 RequiredIndex : Dependent.Required)
+        {
+            TrySkipStep(RequiredIndex, OutSkippedSteps);
+        }
+    }
+}
+
+TSharedPtr<FQuestStepObjective> FQuest::GetFirstActiveStep() const
+{
+    int32 FirstStepIndex = INDEX_NONE;
+    for (int32 StepIndex : ActiveSteps)
+    {
+        FirstStepIndex = FirstStepIndex == INDEX_NONE ? StepIndex : FMath::Min(FirstStepIndex, StepIndex);
+    }
+    return FirstStepIndex != INDEX_NONE ? ObjectivesArray[FirstStepIndex] : TSharedPtr<FQuestStepObjective>();
+}
+
+int32 FQuest::GetNumPendingRequirements(int32 StepIndex) const
+{
+    const FStepNode& Node = StepNodes[StepIndex];
+    int32 NumPending = 0;
+    for (int32 RequiredIndex : Node.Required)
+    {
+        NumPending += StepNodes[RequiredIndex].bCompleted ? 0 : 1;
+    }
+    // Steps that need any of their requirements wait on a single one
+    if (ObjectivesArray[StepIndex]->bRequireAnyStep)
+    {
+        return Node.Required.Num() > 0 && NumPending == Node.Required.Num() ? 1 : 0;
+    }
+    return NumPending;
+}
+
+void FQuest::AddActiveStep(int32 StepIndex)
+{
+    StepNodes[StepIndex].ActiveIndex = ActiveSteps.Add(StepIndex);
+}
+
+void FQuest::RemoveActiveStep(int32 StepIndex)
+{
+    FStepNode& Node = StepNodes[StepIndex];
+    if (Node.ActiveIndex == INDEX_NONE)
+    {
+        return;
+    }
+
+    ActiveSteps.RemoveAtSwap(Node.ActiveIndex, 1, false);
+    if (ActiveSteps.IsValidIndex(Node.ActiveIndex))
+    {
+        StepNodes[ActiveSteps[Node.ActiveIndex]].ActiveIndex = Node.ActiveIndex;
+    }
+    Node.ActiveIndex = INDEX_NONE;
+}
+
+bool FQuest::TrySkipStep(int32 StepIndex, TArray<int32>& OutSkippedSteps)
+{
+    FStepNode& Node = StepNodes[StepIndex];
+    if (Node.bCompleted || Node.bSkipped || Node.Dependents.Num() == 0)
+    {
+        return false;
+    }
+    for (int32 DependentIndex : Node.Dependents)
+    {
+        const FStepNode& Dependent = StepNodes[DependentIndex];
+        if (!Dependent.bCompleted && !Dependent.bSkipped && Dependent.NumPendingRequirements > 0)
+        {
+            return false;
+        }
+    }
+
+    if (Node.ActiveIndex != INDEX_NONE)
+    {
+        RemoveActiveStep(StepIndex);
+        OutSkippedSteps.Add(StepIndex);
+    }
+    Node.bSkipped = true;
+    if (!ObjectivesArray[StepIndex]->bOptional)
+    {
+        --NumRequiredStepsLeft;
+    }
+    // The rest of the branch above it
+    for (int32 RequiredIndex : Node.Required)
+    {
+        TrySkipStep(RequiredIndex, OutSkippedSteps);
+    }
+    return true;
+}
+
+SIZE_T FQuest::GetDefinitionAllocatedSize() const
+{
+    SIZE_T Size = QuestRewards.GetAllocatedSize()
+        + PrerequisiteQuests.GetAllocatedSize()
+        + ObjectivesArray.GetAllocatedSize()
+        + StepNodes.GetAllocatedSize();
+    ForEachObjectiveTraits([this, &Size](auto Traits)
+    {
+        const auto& Rows = this->*decltype(Traits)::Rows;
+        Size += Rows.GetAllocatedSize();
+        for (const auto& Row : Rows)
+        {
+            Size += Row.Value.GetDefinitionAllocatedSize();
+        }
+    });
+    for (const TSharedPtr<FQuestStepObjective>& Objective : ObjectivesArray)
+    {
+        Size += Objective->GetStructSize() + Objective->GetDefinitionAllocatedSize() + Objective->RequiredSteps.GetAllocatedSize();
+    }
+    for (const FStepNode& Node : StepNodes)
+    {
+        Size += Node.Required.GetAllocatedSize() + Node.Dependents.GetAllocatedSize();
+    }
+    return Size;
+}
+
+SIZE_T FQuest::GetRuntimeAllocatedSize() const
+{
+    SIZE_T Size = ActiveSteps.GetAllocatedSize();
+    for (const TSharedPtr<FQuestStepObjective>& Objective : ObjectivesArray)
+    {
+        Size += Objective->GetRuntimeAllocatedSize();
+    }
+    return Size;
+}
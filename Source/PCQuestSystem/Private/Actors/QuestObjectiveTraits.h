@@ -0,0 +1,170 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Actors/QuestManager.h"
+#include "Profiling/QuestEventCapture.h"
+
+/**
+ * What differs between objective types, known at compile time: the struct a step is stored as, the quest row map it is loaded from,
+ * whether it is counted, the event it is captured as, the manager event that sends it and how an event progresses it.
+ * Code that treats step types differently goes through ForEachObjectiveTraits, VisitObjectiveTraits, VisitCaptureTraits or VisitObjective.
+ * Besides a specialization here and a line in ForEachObjectiveTraits, a new type (escort, timed, interact...) still needs its
+ * EQuestStepType value, its EQuestEventType value, its FQuest row map and its Server event on AQuestManager, which are reflected or replicated.
+ */
+template <EQuestStepType InStepType>
+struct TQuestObjectiveTraits;
+
+template <>
+struct TQuestObjectiveTraits<EQuestStepType::GoTo>
+{
+    using FObjective = FQuestStepGoToObjective;
+    static constexpr EQuestStepType StepType = EQuestStepType::GoTo;
+    static constexpr bool bCounted = false;
+    static constexpr EQuestEventType CaptureType = EQuestEventType::ArrivedToPlace;
+    static constexpr const TCHAR* CaptureName = TEXT("ArrivedToPlace");
+    static constexpr TMap<int, FObjective> FQuest::* Rows = &FQuest::GoToObjectives;
+
+    static FObjective* MakeObjective(int QuestID, int StepID, const FObjective& Row)
+    {
+        return new FObjective(QuestID, StepID, Row.Description, Row.ActorReference, Row.bRequiresAllPlayers, Row.QuestStepRewards, Row.ObjectiveMarkerUMGInformation, Row.PlaceToGo);
+    }
+    static void ApplyProgress(FObjective& Objective, float Amount, APlayerController* ProgressedBy) { Objective.OnArrivedToPlace(ProgressedBy); }
+    static void SendEvent(AQuestManager& QuestManager, FGameplayTag Tag, float Amount, APlayerController* Player) { QuestManager.OnArrivedToPlace(Tag, Player); }
+};
+
+template <>
+struct TQuestObjectiveTraits<EQuestStepType::TalkWith>
+{
+    using FObjective = FQuestStepTalkWithObjective;
+    static constexpr EQuestStepType StepType = EQuestStepType::TalkWith;
+    static constexpr bool bCounted = false;
+    static constexpr EQuestEventType CaptureType = EQuestEventType::EntityTalkedTo;
+    static constexpr const TCHAR* CaptureName = TEXT("EntityTalkedTo");
+    static constexpr TMap<int, FObjective> FQuest::* Rows = &FQuest::TalkWithObjectives;
+
+    static FObjective* MakeObjective(int QuestID, int StepID, const FObjective& Row)
+    {
+        return new FObjective(QuestID, StepID, Row.Description, Row.ActorReference, Row.bRequiresAllPlayers, Row.QuestStepRewards, Row.ObjectiveMarkerUMGInformation, Row.PawnToSpawnWhenActive, Row.WorldPositionToSpawn, Row.WorldRotationToSpawn, Row.EntityToTalkWith);
+    }
+    static void ApplyProgress(FObjective& Objective, float Amount, APlayerController* ProgressedBy) { Objective.OnTalkedWithEntity(ProgressedBy); }
+    static void SendEvent(AQuestManager& QuestManager, FGameplayTag Tag, float Amount, APlayerController* Player) { QuestManager.OnEntityTalkedTo(Tag, Player); }
+};
+
+/* Counted steps only get progress once their FQuestCounterTable counter reached the target, so progress completes them */
+template <>
+struct TQuestObjectiveTraits<EQuestStepType::Kill>
+{
+    using FObjective = FQuestStepKillObjective;
+    static constexpr EQuestStepType StepType = EQuestStepType::Kill;
+    static constexpr bool bCounted = true;
+    static constexpr EQuestEventType CaptureType = EQuestEventType::EntityKilled;
+    static constexpr const TCHAR* CaptureName = TEXT("EntityKilled");
+    static constexpr TMap<int, FObjective> FQuest::* Rows = &FQuest::KillObjectives;
+
+    static FObjective* MakeObjective(int QuestID, int StepID, const FObjective& Row)
+    {
+        return new FObjective(QuestID, StepID, Row.Description, Row.ActorReference, Row.bRequiresAllPlayers, Row.QuestStepRewards, Row.ObjectiveMarkerUMGInformation, Row.SpawnInformation, Row.EntityToKill, Row.AmountToKill);
+    }
+    static void ApplyProgress(FObjective& Objective, float Amount, APlayerController* ProgressedBy) { Objective.OnCountReached(ProgressedBy); }
+    static void SendEvent(AQuestManager& QuestManager, FGameplayTag Tag, float Amount, APlayerController* Player) { QuestManager.OnEntityKilled(Tag, Player); }
+};
+
+template <>
+struct TQuestObjectiveTraits<EQuestStepType::Gather>
+{
+    using FObjective = FQuestStepGatherObjective;
+    static constexpr EQuestStepType StepType = EQuestStepType::Gather;
+    static constexpr bool bCounted = true;
+    static constexpr EQuestEventType CaptureType = EQuestEventType::ItemGathered;
+    static constexpr const TCHAR* CaptureName = TEXT("ItemGathered");
+    static constexpr TMap<int, FObjective> FQuest::* Rows = &FQuest::GatherObjectives;
+
+    static FObjective* MakeObjective(int QuestID, int StepID, const FObjective& Row)
+    {
+        return new FObjective(QuestID, StepID, Row.Description, Row.ActorReference, Row.bRequiresAllPlayers, Row.QuestStepRewards, Row.ObjectiveMarkerUMGInformation, Row.ItemToGather, Row.AmountToGather);
+    }
+    static void ApplyProgress(FObjective& Objective, float Amount, APlayerController* ProgressedBy) { Objective.OnCountReached(ProgressedBy); }
+    static void SendEvent(AQuestManager& QuestManager, FGameplayTag Tag, float Amount, APlayerController* Player) { QuestManager.OnItemGathered(Tag, Amount, Player); }
+};
+
+template <>
+struct TQuestObjectiveTraits<EQuestStepType::Catch>
+{
+    using FObjective = FQuestStepCatchObjective;
+    static constexpr EQuestStepType StepType = EQuestStepType::Catch;
+    static constexpr bool bCounted = true;
+    static constexpr EQuestEventType CaptureType = EQuestEventType::Catch;
+    static constexpr const TCHAR* CaptureName = TEXT("Catch");
+    static constexpr TMap<int, FObjective> FQuest::* Rows = &FQuest::CatchObjectives;
+
+    static FObjective* MakeObjective(int QuestID, int StepID, const FObjective& Row)
+    {
+        return new FObjective(QuestID, StepID, Row.Description, Row.ActorReference, Row.bRequiresAllPlayers, Row.QuestStepRewards, Row.ObjectiveMarkerUMGInformation, Row.AllowedTagToCatch);
+    }
+    static void ApplyProgress(FObjective& Objective, float Amount, APlayerController* ProgressedBy) { Objective.OnCountReached(ProgressedBy); }
+    static void SendEvent(AQuestManager& QuestManager, FGameplayTag Tag, float Amount, APlayerController* Player) { QuestManager.OnCatch(Tag, Player); }
+};
+
+/* The list of objective types. Visitor is called with a default constructed TQuestObjectiveTraits of each */
+template <typename FVisitor>
+void ForEachObjectiveTraits(FVisitor&& Visitor)
+{
+    Visitor(TQuestObjectiveTraits<EQuestStepType::GoTo>());
+    Visitor(TQuestObjectiveTraits<EQuestStepType::TalkWith>());
+    Visitor(TQuestObjectiveTraits<EQuestStepType::Kill>());
+    Visitor(TQuestObjectiveTraits<EQuestStepType::Gather>());
+    Visitor(TQuestObjectiveTraits<EQuestStepType::Catch>());
+}
+
+/* Calls Visitor with the traits of StepType, nothing for types without traits */
+template <typename FVisitor>
+void VisitObjectiveTraits(EQuestStepType StepType, FVisitor&& Visitor)
+{
+    ForEachObjectiveTraits([StepType, &Visitor](auto Traits)
+    {
+        if (decltype(Traits)::StepType == StepType)
+        {
+            Visitor(Traits);
+        }
+    });
+}
+
+/* Calls Visitor with the traits of the objective type captured as CaptureType, nothing for events that are not objective events */
+template <typename FVisitor>
+void VisitCaptureTraits(EQuestEventType CaptureType, FVisitor&& Visitor)
+{
+    ForEachObjectiveTraits([CaptureType, &Visitor](auto Traits)
+    {
+        if (decltype(Traits)::CaptureType == CaptureType)
+        {
+            Visitor(Traits);
+        }
+    });
+}
+
+/* Calls Visitor with the traits of the objective and the objective as the type they say it is stored as */
+template <typename FVisitor>
+void VisitObjective(FQuestStepObjective& Objective, FVisitor&& Visitor)
+{
+    VisitObjectiveTraits(Objective.QuestStepType, [&Objective, &Visitor](auto Traits)
+    {
+        Visitor(Traits, static_cast<typename decltype(Traits)::FObjective&>(Objective));
+    });
+}
+
+inline EQuestEventType GetObjectiveCaptureType(EQuestStepType StepType)
+{
+    EQuestEventType CaptureType = EQuestEventType::Count;
+    VisitObjectiveTraits(StepType, [&CaptureType](auto Traits) { CaptureType = decltype(Traits)::CaptureType; });
+    return CaptureType;
+}
+
+/* Kill, gather and catch steps are counted in the manager's FQuestCounterTable, the other steps complete on their event */
+inline bool IsCountedStepType(EQuestStepType StepType)
+{
+    bool bCounted = false;
+    VisitObjectiveTraits(StepType, [&bCounted](auto Traits) { bCounted = decltype(Traits)::bCounted; });
+    return bCounted;
+}
@@ -0,0 +1,182 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#include "Actors/QuestPrerequisiteGraph.h"
+#include "Actors/QuestManager.h"
+#include "PCQuestSystem.h"
+
+void FQuestPrerequisiteGraph::Build(const TArray<TSharedPtr<FQuest>>& Quests)
+{
+    Empty();
+    Nodes.Reserve(Quests.Num());
+    NodeIndices.Reserve(Quests.Num());
+    for (const TSharedPtr<FQuest>& Quest : Quests)
+    {
+        NodeIndices.Add(Quest->QuestID, Nodes.Num());
+        FNode& Node = Nodes.AddDefaulted_GetRef();
+        Node.QuestID = Quest->QuestID;
+        Node.bRejected = !Quest->HasValidStepGraph();
+    }
+
+    // Edges go from the prerequisite to the quest it unlocks
+    TArray<TPair<int32, int32>> Edges;
+    for (int32 NodeIndex = 0; NodeIndex < Nodes.Num(); ++NodeIndex)
+    {
+        TArray<int> Prerequisites = Quests[NodeIndex]->PrerequisiteQuests;
+        Prerequisites.Sort();
+        for (int32 PrerequisiteIndex = 0; PrerequisiteIndex < Prerequisites.Num(); ++PrerequisiteIndex)
+        {
+            const int PrerequisiteID = Prerequisites[PrerequisiteIndex];
+            if (PrerequisiteIndex > 0 && Prerequisites[PrerequisiteIndex - 1] == PrerequisiteID)
+            {
+                continue;
+            }
+
+            const int32* PrerequisiteNode = NodeIndices.Find(PrerequisiteID);
+            if (!PrerequisiteNode || *PrerequisiteNode == NodeIndex)
+            {
+                UE_LOG(LogPCQuestSystem, Warning, TEXT("Quest %d has an invalid prerequisite %d, ignoring it"), Nodes[NodeIndex].QuestID, PrerequisiteID);
+                continue;
+            }
+            Edges.Emplace(*PrerequisiteNode, NodeIndex);
+            ++Nodes[*PrerequisiteNode].NumDependents;
+            ++Nodes[NodeIndex].NumPendingPrerequisites;
+        }
+    }
+
+    int32 FirstDependent = 0;
+    for (FNode& Node : Nodes)
+    {
+        Node.FirstDependent = FirstDependent;
+        FirstDependent += Node.NumDependents;
+        Node.NumDependents = 0;
+    }
+    Dependents.SetNumUninitialized(Edges.Num());
+    for (const TPair<int32, int32>& Edge : Edges)
+    {
+        FNode& Prerequisite = Nodes[Edge.Key];
+        Dependents[Prerequisite.FirstDependent + Prerequisite.NumDependents++] = Edge.Value;
+    }
+
+    // Whatever a topological walk does not reach is waiting on itself
+    TArray<int32> PendingPrerequisites;
+    TArray<int32> Ready;
+    PendingPrerequisites.Reserve(Nodes.Num());
+    for (int32 NodeIndex = 0; NodeIndex < Nodes.Num(); ++NodeIndex)
+    {
+        PendingPrerequisites.Add(Nodes[NodeIndex].NumPendingPrerequisites);
+        if (Nodes[NodeIndex].NumPendingPrerequisites == 0)
+        {
+            Ready.Add(NodeIndex);
+            AddAvailable(Nodes[NodeIndex]);
+        }
+    }
+    int32 NumReached = 0;
+    while (Ready.Num() > 0)
+    {
+        const FNode& Node = Nodes[Ready.Pop(false)];
+        ++NumReached;
+        for (int32 DependentIndex = Node.FirstDependent; DependentIndex < Node.FirstDependent + Node.NumDependents; ++DependentIndex)
+        {
+            if (--PendingPrerequisites[Dependents[DependentIndex]] == 0)
+            {
+                Ready.Add(Dependents[DependentIndex]);
+            }
+        }
+    }
+    if (NumReached < Nodes.Num())
+    {
+        for (int32 NodeIndex = 0; NodeIndex < Nodes.Num(); ++NodeIndex)
+        {
+            if (PendingPrerequisites[NodeIndex] > 0)
+            {
+                UE_LOG(LogPCQuestSystem, Error, TEXT("Quest %d is part of a prerequisite cycle and will never be available"), Nodes[NodeIndex].QuestID);
+            }
+        }
+    }
+}
+
+void FQuestPrerequisiteGraph::Empty()
+{
+    Nodes.Reset();
+    Dependents.Reset();
+    NodeIndices.Reset();
+    AvailableQuests.Reset();
+}
+
+void FQuestPrerequisiteGraph::CompleteQuest(int QuestID, TArray<int>* OutNewlyAvailable)
+{
+    const int32* NodeIndex = NodeIndices.Find(QuestID);
+    if (!NodeIndex || Nodes[*NodeIndex].bCompleted)
+    {
+        return;
+    }
+
+    FNode& Node = Nodes[*NodeIndex];
+    Node.bCompleted = true;
+    RemoveAvailable(Node);
+    for (int32 DependentIndex = Node.FirstDependent; DependentIndex < Node.FirstDependent + Node.NumDependents; ++DependentIndex)
+    {
+        FNode& Dependent = Nodes[Dependents[DependentIndex]];
+        if (--Dependent.NumPendingPrerequisites == 0 && !Dependent.bCompleted)
+        {
+            AddAvailable(Dependent);
+            if (OutNewlyAvailable && Dependent.AvailableIndex != INDEX_NONE)
+            {
+                OutNewlyAvailable->Add(Dependent.QuestID);
+            }
+        }
+    }
+}
+
+bool FQuestPrerequisiteGraph::IsAvailable(int QuestID) const
+{
+    const FNode* Node = FindNode(QuestID);
+    return Node && Node->AvailableIndex != INDEX_NONE;
+}
+
+bool FQuestPrerequisiteGraph::IsCompleted(int QuestID) const
+{
+    const FNode* Node = FindNode(QuestID);
+    return Node && Node->bCompleted;
+}
+
+int32 FQuestPrerequisiteGraph::GetNumPendingPrerequisites(int QuestID) const
+{
+    const FNode* Node = FindNode(QuestID);
+    return Node ? Node->NumPendingPrerequisites : 0;
+}
+
+SIZE_T FQuestPrerequisiteGraph::GetAllocatedSize() const
+{
+    return Nodes.GetAllocatedSize() + Dependents.GetAllocatedSize() + NodeIndices.GetAllocatedSize() + AvailableQuests.GetAllocatedSize();
+}
+
+const FQuestPrerequisiteGraph::FNode* FQuestPrerequisiteGraph::FindNode(int QuestID) const
+{
+    const int32* NodeIndex = NodeIndices.Find(QuestID);
+    return NodeIndex ? &Nodes[*NodeIndex] : nullptr;
+}
+
+void FQuestPrerequisiteGraph::AddAvailable(FNode& Node)
+{
+    if (Node.bRejected)
+    {
+        return;
+    }
+    Node.AvailableIndex = AvailableQuests.Add(Node.QuestID);
+}
+
+void FQuestPrerequisiteGraph::RemoveAvailable(FNode& Node)
+{
+    if (Node.AvailableIndex == INDEX_NONE)
+    {
+        return;
+    }
+
+    AvailableQuests.RemoveAtSwap(Node.AvailableIndex, 1, false);
+    if (AvailableQuests.IsValidIndex(Node.AvailableIndex))
+    {
+        Nodes[NodeIndices[AvailableQuests[Node.AvailableIndex]]].AvailableIndex = Node.AvailableIndex;
+    }
+    Node.AvailableIndex = INDEX_NONE;
+}
@@ -0,0 +1,68 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#include "Actors/QuestTagFilterTable.h"
+#include "Actors/QuestManager.h"
+
+void FQuestTagFilterTable::Build(const TArray<TSharedPtr<FQuest>>& Quests)
+{
+    Empty();
+    TArray<FGameplayTag> EventTags;
+    for (const TSharedPtr<FQuest>& Quest : Quests)
+    {
+        for (const TSharedPtr<FQuestStepObjective>& Objective : Quest->ObjectivesArray)
+        {
+            if (Objective->bMatchChildTags)
+            {
+                EventTags.Reset();
+                Objective->GetEventTags(EventTags);
+                for (const FGameplayTag& EventTag : EventTags)
+                {
+                    if (EventTag.IsValid())
+                    {
+                        Filters.AddUnique(EventTag);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void FQuestTagFilterTable::Empty()
+{
+    Filters.Reset();
+    TagMatches.Reset();
+}
+
+void FQuestTagFilterTable::GetMatchingFilters(const FGameplayTag& Tag, TArray<FGameplayTag, TInlineAllocator<4>>& OutFilters)
+{
+    if (Filters.Num() == 0)
+    {
+        return;
+    }
+
+    const TBitArray<>* Matches = TagMatches.Find(Tag);
+    if (!Matches)
+    {
+        TBitArray<> NewMatches(false, Filters.Num());
+        for (int32 FilterIndex = 0; FilterIndex < Filters.Num(); ++FilterIndex)
+        {
+            NewMatches[FilterIndex] = Tag.MatchesTag(Filters[FilterIndex]);
+        }
+        Matches = &TagMatches.Add(Tag, MoveTemp(NewMatches));
+    }
+
+    for (TConstSetBitIterator<> It(*Matches); It; ++It)
+    {
+        OutFilters.Add(Filters[It.GetIndex()]);
+    }
+}
+
+SIZE_T FQuestTagFilterTable::GetAllocatedSize() const
+{
+    SIZE_T Size = Filters.GetAllocatedSize() + TagMatches.GetAllocatedSize();
+    for (const TPair<FGameplayTag, TBitArray<>>& Matches : TagMatches)
+    {
+        Size += Matches.Value.GetAllocatedSize();
+    }
+    return Size;
+}
@@ -2,8 +2,8 @@
 
 #include <Components/IconMarkerComponent.h>
 #include "UObject/UObjectGlobals.h"
-#include <PCQSBlueprintFunctionLibrary.h>
 #include <UI/IconMarkerUMG.h>
+#include "Markers/MarkerSubsystem.h"
 
 // Sets default values for this component's properties
 UIconMarkerComponent::UIconMarkerComponent()
@@ -11,51 +11,51 @@ UIconMarkerComponent::UIconMarkerComponent()
     // Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
     // off to improve performance if you don't need them.
     PrimaryComponentTick.bCanEverTick = false;
-    SetIsReplicatedByDefault(true);
 }
 
 UIconMarkerComponent::~UIconMarkerComponent()
 {
-    if (MarkerUMG.IsValid())
-    {
-        MarkerUMG->RemoveFromParent();
-    }
-    MarkerUMG = nullptr;
-
-    UPCQSBlueprintFunctionLibrary::RemoveIconMarkerComponent(this);
 }
 
 void UIconMarkerComponent::BeginPlay()
 {
     Super::BeginPlay();
 
-    UPCQSBlueprintFunctionLibrary::AddIconMarkerComponent(this);
+    if (UMarkerSubsystem* MarkerSubsystem = UMarkerSubsystem::Get(this))
+    {
+        MarkerHandle = MarkerSubsystem->AddMarker(GetOwner(), MarkerUMGClass, MarkerIcon, ActorOffset, bShowOnScreen, bShowOnCompass, Priority, this);
+        if (bActive)
+        {
+            MarkerSubsystem->ActivateMarker(MarkerHandle);
+        }
+    }
 }
 
-void UIconMarkerComponent::ActivateMarker()
+void UIconMarkerComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-    if (bShowOnScreen)
+    if (UMarkerSubsystem* MarkerSubsystem = UMarkerSubsystem::Get(this))
     {
-        if (!MarkerUMG.IsValid())
-        {
-            MarkerUMG = CreateWidget<UIconMarkerUMG>(GetWorld(), MarkerUMGClass.Get());
-            MarkerUMG->SetMarkerIconImage(MarkerIcon);
-            MarkerUMG->SetMarkerOwner(GetOwner());
-            MarkerUMG->SetMarkerOffset(ActorOffset);
-        }
+        MarkerSubsystem->RemoveMarker(MarkerHandle);
+    }
+
+    Super::EndPlay(EndPlayReason);
+}
 
-        bActive = true;
-        MarkerUMG->AddToViewport();
-        MarkerUMG->PlayWidgetFadeAnimation();
+void UIconMarkerComponent::ActivateMarker()
+{
+    bActive = true;
+    if (UMarkerSubsystem* MarkerSubsystem = UMarkerSubsystem::Get(this))
+    {
+        MarkerSubsystem->ActivateMarker(MarkerHandle);
     }
 }
 
 void UIconMarkerComponent::DeactivateMarker()
 {
     bActive = false;
-    if (MarkerUMG.IsValid())
+    if (UMarkerSubsystem* MarkerSubsystem = UMarkerSubsystem::Get(this))
     {
-        MarkerUMG->RemoveFromParent();
+        MarkerSubsystem->DeactivateMarker(MarkerHandle);
     }
 }
 
@@ -81,17 +81,21 @@ bool UIconMarkerComponent::IsMarkerActive()
 
 void UIconMarkerComponent::ShowMarker() const
 {
-    if (MarkerUMG.IsValid())
+    const UMarkerSubsystem* MarkerSubsystem = UMarkerSubsystem::Get(this);
+    const FMarkerRecord* Marker = MarkerSubsystem ? MarkerSubsystem->GetMarker(MarkerHandle) : nullptr;
+    if (Marker && Marker->Widget)
     {
-        MarkerUMG->AddToViewport();
+        Marker->Widget->AddToViewport();
     }
 }
 
 void UIconMarkerComponent::HideMarker() const
 {
-    if (MarkerUMG.IsValid())
+    const UMarkerSubsystem* MarkerSubsystem = UMarkerSubsystem::Get(this);
+    const FMarkerRecord* Marker = MarkerSubsystem ? MarkerSubsystem->GetMarker(MarkerHandle) : nullptr;
+    if (Marker && Marker->Widget)
     {
-        MarkerUMG->RemoveFromParent();
+        Marker->Widget->RemoveFromParent();
     }
 }
 
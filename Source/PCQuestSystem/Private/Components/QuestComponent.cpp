@@ -2,8 +2,10 @@
 
 #include "Components/QuestComponent.h"
 #include "PCQSBlueprintFunctionLibrary.h"
-#include "GameFramework/Character.h"
+#include "GameFramework/Pawn.h"
 #include "Kismet/KismetSystemLibrary.h"
+#include "Misc/ScopeRWLock.h"
+#include "PCQuestSystem.h"
 
 UQuestComponent::UQuestComponent()
 {
@@ -21,9 +23,25 @@ void UQuestComponent::BeginPlay()
     {
         QuestManager = UPCQSBlueprintFunctionLibrary::GetWorldQuestManager(this);
     }
+    if (APawn* Pawn = Cast<APawn>(GetOwner()))
+    {
+        Pawn->ReceiveControllerChangedDelegate.AddUniqueDynamic(this, &UQuestComponent::OnOwnerControllerChanged);
+    }
     GetController();
 }
 
+void UQuestComponent::OnOwnerControllerChanged(APawn* Pawn, AController* OldController, AController* NewController)
+{
+    SetOwnerPlayerController(Cast<APlayerController>(NewController));
+}
+
+void UQuestComponent::SetOwnerPlayerController(APlayerController* PlayerController)
+{
+    OwnerPlayerController = PlayerController;
+    FWriteScopeLock Lock(WorkerPlayerControllerLock);
+    WorkerPlayerController = PlayerController;
+}
+
 UQuestComponent* UQuestComponent::GetQuestComponent(const AActor* Pawn)
 {
     if (Pawn == nullptr)
@@ -37,7 +55,7 @@ UQuestComponent* UQuestComponent::GetQuestComponent(const AActor* Pawn)
 void UQuestComponent::OnArrivedToPlace(FGameplayTag ArrivedPlace)
 {
     OnEnteredLocation.Broadcast(ArrivedPlace);
-    UKismetSystemLibrary::PrintString(this, FString::Printf(TEXT("OnArrivedToPlace")));
+    PCQS_LOG(Verbose, TEXT("OnArrivedToPlace %s"), *ArrivedPlace.ToString());
     if (GetOwner()->HasAuthority())
     {
         if (QuestManager && GetController())
@@ -84,16 +102,46 @@ void UQuestComponent::OnCatch(FGameplayTag CatchTag)
     }
 }
 
+bool UQuestComponent::EnqueueEvent(EQuestStepType StepType, FGameplayTag Tag, float Amount)
+{
+    // Only the server drains the queue
+    if (!GetOwner() || !GetOwner()->HasAuthority())
+    {
+        return false;
+    }
+
+    // GetController is not safe off the game thread, workers read what the game thread last resolved
+    TWeakObjectPtr<APlayerController> PlayerController;
+    if (IsInGameThread())
+    {
+        PlayerController = GetController();
+    }
+    else
+    {
+        FReadScopeLock Lock(WorkerPlayerControllerLock);
+        PlayerController = WorkerPlayerController;
+    }
+    if (!QuestManager || PlayerController.IsExplicitlyNull())
+    {
+        // Once per burst is enough, an unpossessed owner drops every event until it is possessed
+        const int64 NumDropped = NumDroppedEvents.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (FMath::IsPowerOfTwo(NumDropped))
+        {
+            UE_LOG(LogPCQuestSystem, Warning, TEXT("%s dropped a quest event for %s, it has no %s, %lld events dropped so far"), *GetNameSafe(GetOwner()), *Tag.ToString(),
+                QuestManager ? TEXT("player controller") : TEXT("quest manager"), NumDropped);
+        }
+        return false;
+    }
+    return QuestManager->EnqueueEvent({ StepType, Tag, Amount, PlayerController });
+}
+
 APlayerController* UQuestComponent::GetController()
 {
     if (!OwnerPlayerController)
     {
-        if (const ACharacter* Character = Cast<ACharacter>(GetOwner()))
+        if (const APawn* Pawn = Cast<APawn>(GetOwner()))
         {
-            if (APlayerController* PlayerController = Cast<APlayerController>(Character->GetController()))
-            {
-                OwnerPlayerController = PlayerController;
-            }
+            SetOwnerPlayerController(Cast<APlayerController>(Pawn->GetController()));
         }
     }
     return OwnerPlayerController;
@@ -0,0 +1,48 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#include "Markers/CompassStrip.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+
+bool FCompassStripView::Initialize(APlayerController* PlayerController, float FieldOfViewDegrees)
+{
+    if (!PlayerController || !PlayerController->GetPawn())
+    {
+        return false;
+    }
+
+    FVector CameraLoc;
+    FRotator CameraRot;
+    PlayerController->GetPlayerViewPoint(CameraLoc, CameraRot);
+    CameraLocation2D = FVector2D(CameraLoc);
+
+    const APawn* Pawn = PlayerController->GetPawn();
+    Right2D = FVector2D(Pawn->GetActorRightVector());
+    Forward2D = FVector2D(Pawn->GetActorForwardVector());
+
+    bCullByFieldOfView = FieldOfViewDegrees < 360.f;
+    MinForwardCosine = FMath::Cos(FMath::DegreesToRadians(FieldOfViewDegrees * 0.5f));
+    return true;
+}
+
+bool FCompassStripView::GetXPosition(const FVector& WorldLocation, float Margin, float& OutXPosition) const
+{
+    OutXPosition = 0.f;
+
+    // Looking from the camera or at the camera gives the same ratio, so there is no need for the look at rotation
+    const FVector2D ToMarker = FVector2D(WorldLocation) - CameraLocation2D;
+    const float ForwardDot = FVector2D::DotProduct(Forward2D, ToMarker);
+
+    if (bCullByFieldOfView && ForwardDot < MinForwardCosine * ToMarker.Size() * Forward2D.Size())
+    {
+        return false;
+    }
+
+    if (FMath::IsNearlyZero(ForwardDot))
+    {
+        return false;
+    }
+
+    OutXPosition = FVector2D::DotProduct(Right2D, ToMarker) / ForwardDot * Margin;
+    return true;
+}
@@ -0,0 +1,138 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#include "Markers/MarkerGrid.h"
+
+FMarkerGrid::FMarkerGrid(float InCellSize)
+    : CellSize(FMath::Max(InCellSize, 1.f)),
+    InvCellSize(1.f / FMath::Max(InCellSize, 1.f))
+{
+}
+
+FIntPoint FMarkerGrid::Add(int32 Id, const FVector& Location)
+{
+    const FVector2D Location2D(Location);
+    const FIntPoint Cell = GetCell(Location2D);
+    Cells.FindOrAdd(Cell).Add({ Id, Location2D });
+    return Cell;
+}
+
+void FMarkerGrid::Remove(int32 Id, const FIntPoint& Cell)
+{
+    TArray<FEntry>* Entries = Cells.Find(Cell);
+    if (!Entries)
+    {
+        return;
+    }
+
+    const int32 EntryIndex = Entries->IndexOfByPredicate([Id](const FEntry& Entry) { return Entry.Id == Id; });
+    if (EntryIndex != INDEX_NONE)
+    {
+        Entries->RemoveAtSwap(EntryIndex, 1, false);
+    }
+    if (Entries->Num() == 0)
+    {
+        Cells.Remove(Cell);
+    }
+}
+
+FIntPoint FMarkerGrid::Move(int32 Id, const FIntPoint& Cell, const FVector& NewLocation)
+{
+    const FVector2D Location2D(NewLocation);
+    const FIntPoint NewCell = GetCell(Location2D);
+    if (NewCell != Cell)
+    {
+        Remove(Id, Cell);
+        Cells.FindOrAdd(NewCell).Add({ Id, Location2D });
+    }
+    else if (TArray<FEntry>* Entries = Cells.Find(Cell))
+    {
+        for (FEntry& Entry : *Entries)
+        {
+            if (Entry.Id == Id)
+            {
+                Entry.Location = Location2D;
+                break;
+            }
+        }
+    }
+    return NewCell;
+}
+
+void FMarkerGrid::Empty()
+{
+    Cells.Empty();
+}
+
+template <typename PredicateType>
+void FMarkerGrid::Query(const FBox2D& Box, TArray<int32>& OutIds, PredicateType Predicate) const
+{
+    const FIntPoint MinCell = GetCell(Box.Min);
+    const FIntPoint MaxCell = GetCell(Box.Max);
+    const int64 NumBoxCells = int64(MaxCell.X - MinCell.X + 1) * int64(MaxCell.Y - MinCell.Y + 1);
+
+    // Boxes bigger than the occupied area are cheaper to answer by walking the occupied cells
+    if (NumBoxCells > Cells.Num())
+    {
+        for (const TPair<FIntPoint, TArray<FEntry>>& Cell : Cells)
+        {
+            if (Cell.Key.X < MinCell.X || Cell.Key.X > MaxCell.X || Cell.Key.Y < MinCell.Y || Cell.Key.Y > MaxCell.Y)
+            {
+                continue;
+            }
+            for (const FEntry& Entry : Cell.Value)
+            {
+                if (Predicate(Entry.Location))
+                {
+                    OutIds.Add(Entry.Id);
+                }
+            }
+        }
+        return;
+    }
+
+    for (int32 CellY = MinCell.Y; CellY <= MaxCell.Y; ++CellY)
+    {
+        for (int32 CellX = MinCell.X; CellX <= MaxCell.X; ++CellX)
+        {
+            const TArray<FEntry>* Entries = Cells.Find(FIntPoint(CellX, CellY));
+            if (!Entries)
+            {
+                continue;
+            }
+            for (const FEntry& Entry : *Entries)
+            {
+                if (Predicate(Entry.Location))
+                {
+                    OutIds.Add(Entry.Id);
+                }
+            }
+        }
+    }
+}
+
+void FMarkerGrid::QueryBox(const FBox2D& Box, TArray<int32>& OutIds) const
+{
+    Query(Box, OutIds, [&Box](const FVector2D& Location) { return Box.IsInside(Location); });
+}
+
+void FMarkerGrid::QueryRadius(const FVector2D& Center, float Radius, TArray<int32>& OutIds) const
+{
+    const float RadiusSquared = Radius * Radius;
+    const FBox2D Box(Center - FVector2D(Radius), Center + FVector2D(Radius));
+    Query(Box, OutIds, [&Center, RadiusSquared](const FVector2D& Location) { return FVector2D::DistSquared(Center, Location) <= RadiusSquared; });
+}
+
+FIntPoint FMarkerGrid::GetCell(const FVector2D& Location) const
+{
+    return FIntPoint(FMath::FloorToInt(Location.X * InvCellSize), FMath::FloorToInt(Location.Y * InvCellSize));
+}
+
+SIZE_T FMarkerGrid::GetAllocatedSize() const
+{
+    SIZE_T Size = Cells.GetAllocatedSize();
+    for (const TPair<FIntPoint, TArray<FEntry>>& Cell : Cells)
+    {
+        Size += Cell.Value.GetAllocatedSize();
+    }
+    return Size;
+}
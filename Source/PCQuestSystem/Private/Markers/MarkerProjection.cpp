@@ -0,0 +1,193 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#include "Markers/MarkerProjection.h"
+#include "Engine/LocalPlayer.h"
+#include "Engine/GameViewportClient.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "Misc/MemStack.h"
+#include "SceneView.h"
+
+bool FMarkerProjectionView::Initialize(APlayerController* PlayerController, bool bUseCameraLocation)
+{
+    bValid = false;
+
+    if (!PlayerController || !PlayerController->GetPawn())
+    {
+        return false;
+    }
+
+    ULocalPlayer* const LocalPlayer = PlayerController->GetLocalPlayer();
+    if (!LocalPlayer || !LocalPlayer->ViewportClient)
+    {
+        return false;
+    }
+
+    FSceneViewProjectionData ProjectionData;
+    if (!LocalPlayer->GetProjectionData(LocalPlayer->ViewportClient->Viewport, ProjectionData))
+    {
+        return false;
+    }
+
+    int32 ViewportX, ViewportY;
+    PlayerController->GetViewportSize(ViewportX, ViewportY);
+    ViewportSize = FVector2D(ViewportX, ViewportY);
+    ViewRect = ProjectionData.GetConstrainedViewRect();
+    ViewOrigin = ProjectionData.ViewOrigin;
+    TranslatedViewProjection = FMatrix44f(ProjectionData.ViewRotationMatrix * ProjectionData.ProjectionMatrix);
+
+    FRotator CameraRotation;
+    PlayerController->GetPlayerViewPoint(CameraLocation, CameraRotation);
+    CameraForward = FVector3f(CameraRotation.Vector());
+    PawnLocation = PlayerController->GetPawn()->GetActorLocation();
+    BehindCheckOrigin = bUseCameraLocation ? CameraLocation : PawnLocation;
+
+    bValid = true;
+    return true;
+}
+
+void FMarkerProjectionView::ProjectMarkers(TArrayView<const FVector> WorldLocations, TArrayView<const FVector> Offsets, float PercentageEdge, TArrayView<FMarkerScreenInfo> OutInfos) const
+{
+    ProjectMarkers(WorldLocations, Offsets, PercentageEdge, TArrayView<const float>(), OutInfos);
+}
+
+void FMarkerProjectionView::ProjectMarkers(TArrayView<const FVector> WorldLocations, TArrayView<const FVector> Offsets, TArrayView<const float> PercentageEdges, TArrayView<FMarkerScreenInfo> OutInfos) const
+{
+    check(PercentageEdges.Num() == WorldLocations.Num());
+    ProjectMarkers(WorldLocations, Offsets, 1.f, PercentageEdges, OutInfos);
+}
+
+void FMarkerProjectionView::ProjectMarkers(TArrayView<const FVector> WorldLocations, TArrayView<const FVector> Offsets, float DefaultPercentageEdge, TArrayView<const float> PercentageEdges, TArrayView<FMarkerScreenInfo> OutInfos) const
+{
+    check(OutInfos.Num() == WorldLocations.Num());
+    check(Offsets.Num() == 0 || Offsets.Num() == WorldLocations.Num());
+
+    const int32 NumMarkers = WorldLocations.Num();
+    if (!bValid || NumMarkers == 0)
+    {
+        return;
+    }
+
+    // Structure of arrays relative to the view origin, padded so the vector loop never needs a scalar tail
+    FMemMark Mark(FMemStack::Get());
+    const int32 NumPadded = Align(NumMarkers, 4);
+    TArray<float, TMemStackAllocator<>> Positions;
+    Positions.SetNumZeroed(NumPadded * 4);
+    float* PositionsX = Positions.GetData();
+    float* PositionsY = PositionsX + NumPadded;
+    float* PositionsZ = PositionsY + NumPadded;
+    float* Edges = PositionsZ + NumPadded;
+
+    for (int32 i = 0; i < NumMarkers; ++i)
+    {
+        const FVector Translated = WorldLocations[i] + (Offsets.Num() > 0 ? Offsets[i] : FVector::ZeroVector) - ViewOrigin;
+        PositionsX[i] = (float)Translated.X;
+        PositionsY[i] = (float)Translated.Y;
+        PositionsZ[i] = (float)Translated.Z;
+        Edges[i] = PercentageEdges.Num() > 0 ? PercentageEdges[i] : DefaultPercentageEdge;
+    }
+
+    const FMatrix44f& M = TranslatedViewProjection;
+    const VectorRegister4Float M00 = VectorSetFloat1(M.M[0][0]), M10 = VectorSetFloat1(M.M[1][0]), M20 = VectorSetFloat1(M.M[2][0]), M30 = VectorSetFloat1(M.M[3][0]);
+    const VectorRegister4Float M01 = VectorSetFloat1(M.M[0][1]), M11 = VectorSetFloat1(M.M[1][1]), M21 = VectorSetFloat1(M.M[2][1]), M31 = VectorSetFloat1(M.M[3][1]);
+    const VectorRegister4Float M03 = VectorSetFloat1(M.M[0][3]), M13 = VectorSetFloat1(M.M[1][3]), M23 = VectorSetFloat1(M.M[2][3]), M33 = VectorSetFloat1(M.M[3][3]);
+
+    // Markers behind the camera are mirrored through it (CameraLocation - (Location - BehindCheckOrigin)) before projecting
+    const FVector3f Mirror = FVector3f(CameraLocation + BehindCheckOrigin - ViewOrigin * 2.0);
+    const FVector3f BehindOrigin = FVector3f(BehindCheckOrigin - ViewOrigin);
+    const FVector3f Pawn = FVector3f(PawnLocation - ViewOrigin);
+
+    const VectorRegister4Float Zero = GlobalVectorConstants::FloatZero;
+    const VectorRegister4Float One = GlobalVectorConstants::FloatOne;
+    const VectorRegister4Float Half = VectorSetFloat1(0.5f);
+    const VectorRegister4Float MirrorX = VectorSetFloat1(Mirror.X), MirrorY = VectorSetFloat1(Mirror.Y), MirrorZ = VectorSetFloat1(Mirror.Z);
+    const VectorRegister4Float BehindX = VectorSetFloat1(BehindOrigin.X), BehindY = VectorSetFloat1(BehindOrigin.Y), BehindZ = VectorSetFloat1(BehindOrigin.Z);
+    const VectorRegister4Float PawnX = VectorSetFloat1(Pawn.X), PawnY = VectorSetFloat1(Pawn.Y), PawnZ = VectorSetFloat1(Pawn.Z);
+    const VectorRegister4Float ForwardX = VectorSetFloat1(CameraForward.X), ForwardY = VectorSetFloat1(CameraForward.Y), ForwardZ = VectorSetFloat1(CameraForward.Z);
+
+    const VectorRegister4Float RectMinX = VectorSetFloat1((float)ViewRect.Min.X), RectMinY = VectorSetFloat1((float)ViewRect.Min.Y);
+    const VectorRegister4Float RectWidth = VectorSetFloat1((float)ViewRect.Width()), RectHeight = VectorSetFloat1((float)ViewRect.Height());
+    const VectorRegister4Float ViewportX = VectorSetFloat1((float)ViewportSize.X), ViewportY = VectorSetFloat1((float)ViewportSize.Y);
+    const VectorRegister4Float CenterX = VectorSetFloat1((float)ViewportSize.X * 0.5f), CenterY = VectorSetFloat1((float)ViewportSize.Y * 0.5f);
+    const VectorRegister4Float RightAngle = VectorSetFloat1(90.f);
+    const VectorRegister4Float RadToDeg = VectorSetFloat1(180.f / PI);
+
+    for (int32 Base = 0; Base < NumPadded; Base += 4)
+    {
+        const VectorRegister4Float X = VectorLoad(PositionsX + Base);
+        const VectorRegister4Float Y = VectorLoad(PositionsY + Base);
+        const VectorRegister4Float Z = VectorLoad(PositionsZ + Base);
+        const VectorRegister4Float Edge = VectorLoad(Edges + Base);
+        const VectorRegister4Float BoundsX = VectorMultiply(CenterX, Edge);
+        const VectorRegister4Float BoundsY = VectorMultiply(CenterY, Edge);
+        const VectorRegister4Float NegBoundsX = VectorNegate(BoundsX);
+
+        // Behind camera check, same as the dot product against the camera forward in the per actor path
+        VectorRegister4Float Dot = VectorMultiply(VectorSubtract(X, BehindX), ForwardX);
+        Dot = VectorMultiplyAdd(VectorSubtract(Y, BehindY), ForwardY, Dot);
+        Dot = VectorMultiplyAdd(VectorSubtract(Z, BehindZ), ForwardZ, Dot);
+        const VectorRegister4Float InFront = VectorCompareGE(Dot, Zero);
+
+        const VectorRegister4Float SourceX = VectorSelect(InFront, X, VectorSubtract(MirrorX, X));
+        const VectorRegister4Float SourceY = VectorSelect(InFront, Y, VectorSubtract(MirrorY, Y));
+        const VectorRegister4Float SourceZ = VectorSelect(InFront, Z, VectorSubtract(MirrorZ, Z));
+
+        const VectorRegister4Float ClipX = VectorMultiplyAdd(SourceX, M00, VectorMultiplyAdd(SourceY, M10, VectorMultiplyAdd(SourceZ, M20, M30)));
+        const VectorRegister4Float ClipY = VectorMultiplyAdd(SourceX, M01, VectorMultiplyAdd(SourceY, M11, VectorMultiplyAdd(SourceZ, M21, M31)));
+        const VectorRegister4Float ClipW = VectorMultiplyAdd(SourceX, M03, VectorMultiplyAdd(SourceY, M13, VectorMultiplyAdd(SourceZ, M23, M33)));
+
+        // Same as FSceneView::ProjectWorldToScreen, which leaves the position at zero when W is not positive
+        const VectorRegister4Float Projected = VectorCompareGT(ClipW, Zero);
+        const VectorRegister4Float RHW = VectorDivide(One, VectorSelect(Projected, ClipW, One));
+        const VectorRegister4Float NormalizedX = VectorMultiplyAdd(VectorMultiply(ClipX, RHW), Half, Half);
+        const VectorRegister4Float NormalizedY = VectorSubtract(Half, VectorMultiply(VectorMultiply(ClipY, RHW), Half));
+        VectorRegister4Float ScreenX = VectorSelect(Projected, VectorMultiplyAdd(NormalizedX, RectWidth, RectMinX), Zero);
+        VectorRegister4Float ScreenY = VectorSelect(Projected, VectorMultiplyAdd(NormalizedY, RectHeight, RectMinY), Zero);
+        ScreenX = VectorSelect(InFront, ScreenX, VectorSubtract(ViewportX, ScreenX));
+        ScreenY = VectorSelect(InFront, ScreenY, VectorSubtract(ViewportY, ScreenY));
+
+        VectorRegister4Float OnScreen = VectorBitwiseAnd(VectorCompareGE(ScreenX, Zero), VectorCompareLE(ScreenX, ViewportX));
+        OnScreen = VectorBitwiseAnd(OnScreen, VectorBitwiseAnd(VectorCompareGE(ScreenY, Zero), VectorCompareLE(ScreenY, ViewportY)));
+        OnScreen = VectorBitwiseAnd(OnScreen, InFront);
+
+        // Edge clamping without trig: the per actor path boils down to a slope of |Y| / X from the viewport center
+        const VectorRegister4Float RelativeX = VectorSubtract(ScreenX, CenterX);
+        const VectorRegister4Float RelativeY = VectorSubtract(ScreenY, CenterY);
+        const VectorRegister4Float AbsRelativeY = VectorAbs(RelativeY);
+        const VectorRegister4Float Slope = VectorDivide(AbsRelativeY, RelativeX);
+        const VectorRegister4Float EdgeX = VectorDivide(VectorMultiply(BoundsY, RelativeX), AbsRelativeY);
+        const VectorRegister4Float OverRight = VectorCompareGT(EdgeX, BoundsX);
+        const VectorRegister4Float OverLeft = VectorCompareLT(EdgeX, NegBoundsX);
+        const VectorRegister4Float ClampedX = VectorSelect(OverRight, BoundsX, VectorSelect(OverLeft, NegBoundsX, EdgeX));
+        const VectorRegister4Float ClampedY = VectorSelect(OverRight, VectorMultiply(BoundsX, Slope), VectorSelect(OverLeft, VectorMultiply(NegBoundsX, Slope), BoundsY));
+
+        const VectorRegister4Float Angle = VectorMultiplyAdd(VectorAbs(VectorATan2(RelativeY, RelativeX)), RadToDeg, RightAngle);
+
+        const VectorRegister4Float OutX = VectorSelect(OnScreen, ScreenX, VectorAdd(ClampedX, CenterX));
+        const VectorRegister4Float OutY = VectorSelect(OnScreen, ScreenY, VectorAdd(ClampedY, CenterY));
+        const VectorRegister4Float OutAngle = VectorSelect(OnScreen, Zero, Angle);
+
+        const VectorRegister4Float ToPawnX = VectorSubtract(X, PawnX);
+        const VectorRegister4Float ToPawnY = VectorSubtract(Y, PawnY);
+        const VectorRegister4Float ToPawnZ = VectorSubtract(Z, PawnZ);
+        const VectorRegister4Float DistanceSquared = VectorMultiplyAdd(ToPawnX, ToPawnX, VectorMultiplyAdd(ToPawnY, ToPawnY, VectorMultiply(ToPawnZ, ToPawnZ)));
+        const VectorRegister4Float Distance = VectorSelect(VectorCompareGT(DistanceSquared, Zero), VectorMultiply(DistanceSquared, VectorReciprocalSqrtAccurate(DistanceSquared)), Zero);
+
+        alignas(16) float LanesX[4], LanesY[4], LanesAngle[4], LanesDistance[4];
+        VectorStoreAligned(OutX, LanesX);
+        VectorStoreAligned(OutY, LanesY);
+        VectorStoreAligned(OutAngle, LanesAngle);
+        VectorStoreAligned(Distance, LanesDistance);
+        const int32 OnScreenBits = VectorMaskBits(OnScreen);
+
+        const int32 NumLanes = FMath::Min(4, NumMarkers - Base);
+        for (int32 Lane = 0; Lane < NumLanes; ++Lane)
+        {
+            FMarkerScreenInfo& Info = OutInfos[Base + Lane];
+            Info.ScreenPosition = FVector2D(LanesX[Lane], LanesY[Lane]);
+            Info.RotationAngleDegrees = LanesAngle[Lane];
+            Info.DistanceToActor = LanesDistance[Lane];
+            Info.bIsOnScreen = (OnScreenBits & (1 << Lane)) != 0;
+        }
+    }
+}
@@ -0,0 +1,511 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#include "Markers/MarkerSubsystem.h"
+#include "Components/IconMarkerComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Markers/MarkerProjection.h"
+#include "Misc/MemStack.h"
+#include "PCQuestSystemStats.h"
+#include "UI/IconMarkerUMG.h"
+
+DECLARE_CYCLE_STAT(TEXT("Marker Layout"), STAT_PCQS_MarkerLayout, STATGROUP_PCQuestSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Visible Markers"), STAT_PCQS_VisibleMarkers, STATGROUP_PCQuestSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Clustered Markers"), STAT_PCQS_ClusteredMarkers, STATGROUP_PCQuestSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Marker Occlusion Traces"), STAT_PCQS_OcclusionTraces, STATGROUP_PCQuestSystem);
+
+static TAutoConsoleVariable<int32> CVarMarkerLayout(
+    TEXT("pcqs.Markers.Layout"),
+    1,
+    TEXT("0: every marker widget projects itself and is always shown. 1: markers are laid out together, capped and clustered."));
+
+static TAutoConsoleVariable<int32> CVarMarkerMaxVisible(
+    TEXT("pcqs.Markers.MaxVisible"),
+    16,
+    TEXT("Maximum number of on screen markers (clusters count as one). 0 means no limit."));
+
+static TAutoConsoleVariable<float> CVarMarkerClusterRadius(
+    TEXT("pcqs.Markers.ClusterRadius"),
+    48.f,
+    TEXT("Markers closer than this many pixels on screen are merged into one cluster. 0 disables clustering."));
+
+static TAutoConsoleVariable<int32> CVarMarkerOcclusion(
+    TEXT("pcqs.Markers.Occlusion"),
+    0,
+    TEXT("1: fade on screen markers whose owner is not in line of sight. Needs pcqs.Markers.Layout."));
+
+static TAutoConsoleVariable<int32> CVarMarkerOcclusionTracesPerFrame(
+    TEXT("pcqs.Markers.OcclusionTracesPerFrame"),
+    8,
+    TEXT("Maximum number of async line of sight traces queued per frame."));
+
+static TAutoConsoleVariable<float> CVarMarkerOcclusionInterval(
+    TEXT("pcqs.Markers.OcclusionInterval"),
+    0.2f,
+    TEXT("Seconds between line of sight checks of a marker next to the camera. Grows by this much for every 100 meters of distance."));
+
+UMarkerSubsystem* UMarkerSubsystem::Get(const UObject* WorldContext)
+{
+    const UWorld* World = WorldContext ? WorldContext->GetWorld() : nullptr;
+    if (!World || World->GetNetMode() == NM_DedicatedServer)
+    {
+        return nullptr;
+    }
+    return World->GetSubsystem<UMarkerSubsystem>();
+}
+
+bool UMarkerSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+    return !IsRunningDedicatedServer() && Super::ShouldCreateSubsystem(Outer);
+}
+
+void UMarkerSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+    Super::Initialize(Collection);
+    OcclusionTraceDelegate.BindUObject(this, &UMarkerSubsystem::OnOcclusionTraceDone);
+}
+
+void UMarkerSubsystem::Deinitialize()
+{
+    for (FMarkerRecord& Marker : Markers)
+    {
+        if (Marker.Widget)
+        {
+            Marker.Widget->RemoveFromParent();
+        }
+    }
+    Markers.Empty();
+    ActiveMarkerIndices.Empty();
+    OwnerMarkers.Empty();
+    MarkerGrid.Empty();
+
+    Super::Deinitialize();
+}
+
+void UMarkerSubsystem::AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector)
+{
+    UMarkerSubsystem* This = CastChecked<UMarkerSubsystem>(InThis);
+    for (FMarkerRecord& Marker : This->Markers)
+    {
+        Collector.AddReferencedObject(Marker.Icon, This);
+        Collector.AddReferencedObject(Marker.Widget, This);
+    }
+    Super::AddReferencedObjects(InThis, Collector);
+}
+
+void UMarkerSubsystem::Tick(float DeltaTime)
+{
+    Super::Tick(DeltaTime);
+
+    UpdateMarkerGrid();
+
+    if (CVarMarkerLayout.GetValueOnGameThread() != 0)
+    {
+        UpdateLayout();
+    }
+    else if (bLayoutApplied)
+    {
+        ClearLayout();
+    }
+}
+
+TStatId UMarkerSubsystem::GetStatId() const
+{
+    RETURN_QUICK_DECLARE_CYCLE_STAT(UMarkerSubsystem, STATGROUP_Tickables);
+}
+
+FMarkerHandle UMarkerSubsystem::AddMarker(AActor* Owner, TSubclassOf<UIconMarkerUMG> WidgetClass, UTexture2D* Icon, FVector Offset, bool bShowOnScreen, bool bShowOnCompass, int32 Priority, UIconMarkerComponent* Component)
+{
+    if (!Owner)
+    {
+        return FMarkerHandle();
+    }
+
+    LLM_SCOPE_BYTAG(PCQuestSystem_Markers);
+    FMarkerRecord Marker;
+    Marker.Owner = Owner;
+    Marker.OwnerKey = Owner;
+    Marker.Offset = Offset;
+    Marker.Icon = Icon;
+    Marker.WidgetClass = WidgetClass;
+    Marker.Component = Component;
+    Marker.Serial = NextSerial++;
+    Marker.Priority = Priority;
+    Marker.bShowOnScreen = bShowOnScreen;
+    Marker.bShowOnCompass = bShowOnCompass;
+
+    FMarkerHandle Handle;
+    Handle.Serial = Marker.Serial;
+    Handle.Index = Markers.Add(MoveTemp(Marker));
+
+    OwnerMarkers.Add(Owner, Handle.Index);
+    Owner->OnDestroyed.AddUniqueDynamic(this, &UMarkerSubsystem::OnMarkerOwnerDestroyed);
+    return Handle;
+}
+
+SIZE_T UMarkerSubsystem::GetAllocatedSize() const
+{
+    return Markers.GetAllocatedSize() + ActiveMarkerIndices.GetAllocatedSize() + OwnerMarkers.GetAllocatedSize() + MarkerGrid.GetAllocatedSize();
+}
+
+void UMarkerSubsystem::RemoveMarker(FMarkerHandle& Handle)
+{
+    if (FindMarker(Handle))
+    {
+        RemoveMarkerAt(Handle.Index);
+    }
+    Handle.Reset();
+}
+
+void UMarkerSubsystem::ActivateMarker(const FMarkerHandle& Handle)
+{
+    FMarkerRecord* Marker = FindMarker(Handle);
+    if (!Marker || !Marker->Owner.IsValid())
+    {
+        return;
+    }
+
+    SetMarkerActive(Handle.Index, true);
+
+    if (Marker->bShowOnScreen && Marker->WidgetClass)
+    {
+        if (!Marker->Widget)
+        {
+            LLM_SCOPE_BYTAG(PCQuestSystem_Markers);
+            Marker->Widget = CreateWidget<UIconMarkerUMG>(GetWorld(), Marker->WidgetClass.Get());
+            Marker->Widget->SetMarkerIconImage(Marker->Icon);
+            Marker->Widget->SetMarkerOwner(Marker->Owner.Get());
+            Marker->Widget->SetMarkerOffset(Marker->Offset);
+        }
+
+        Marker->Widget->AddToViewport();
+        Marker->Widget->PlayWidgetFadeAnimation();
+    }
+}
+
+void UMarkerSubsystem::DeactivateMarker(const FMarkerHandle& Handle)
+{
+    FMarkerRecord* Marker = FindMarker(Handle);
+    if (!Marker)
+    {
+        return;
+    }
+
+    SetMarkerActive(Handle.Index, false);
+
+    if (Marker->Widget)
+    {
+        Marker->Widget->RemoveFromParent();
+    }
+}
+
+bool UMarkerSubsystem::IsMarkerActive(const FMarkerHandle& Handle) const
+{
+    const FMarkerRecord* Marker = GetMarker(Handle);
+    return Marker && Marker->IsActive();
+}
+
+const FMarkerRecord* UMarkerSubsystem::GetMarker(const FMarkerHandle& Handle) const
+{
+    if (Markers.IsValidIndex(Handle.Index) && Markers[Handle.Index].Serial == Handle.Serial)
+    {
+        return &Markers[Handle.Index];
+    }
+    return nullptr;
+}
+
+TArray<UIconMarkerComponent*> UMarkerSubsystem::GetAllMarkerComponents() const
+{
+    TArray<UIconMarkerComponent*> AllMarkerComponents;
+    for (const FMarkerRecord& Marker : Markers)
+    {
+        if (UIconMarkerComponent* Component = Marker.Component.Get())
+        {
+            AllMarkerComponents.Add(Component);
+        }
+    }
+    return AllMarkerComponents;
+}
+
+void UMarkerSubsystem::QueryMarkersInRadius(const FVector& Center, float Radius, TArray<int32>& OutMarkerIndices) const
+{
+    MarkerGrid.QueryRadius(FVector2D(Center), Radius, OutMarkerIndices);
+}
+
+void UMarkerSubsystem::QueryMarkersInBox(const FBox2D& Box, TArray<int32>& OutMarkerIndices) const
+{
+    MarkerGrid.QueryBox(Box, OutMarkerIndices);
+}
+
+void UMarkerSubsystem::ShowActiveMarkers() const
+{
+    for (const int32 Index : ActiveMarkerIndices)
+    {
+        if (UIconMarkerUMG* Widget = Markers[Index].Widget)
+        {
+            Widget->AddToViewport();
+        }
+    }
+}
+
+void UMarkerSubsystem::HideActiveMarkers() const
+{
+    for (const int32 Index : ActiveMarkerIndices)
+    {
+        if (UIconMarkerUMG* Widget = Markers[Index].Widget)
+        {
+            Widget->RemoveFromParent();
+        }
+    }
+}
+
+bool UMarkerSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+    return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+FMarkerRecord* UMarkerSubsystem::FindMarker(const FMarkerHandle& Handle)
+{
+    return const_cast<FMarkerRecord*>(GetMarker(Handle));
+}
+
+void UMarkerSubsystem::RemoveMarkerAt(int32 Index)
+{
+    FMarkerRecord& Marker = Markers[Index];
+    SetMarkerActive(Index, false);
+
+    if (Marker.Widget)
+    {
+        Marker.Widget->RemoveFromParent();
+    }
+
+    OwnerMarkers.RemoveSingle(Marker.OwnerKey, Index);
+    Markers.RemoveAt(Index);
+}
+
+void UMarkerSubsystem::SetMarkerActive(int32 Index, bool bActive)
+{
+    FMarkerRecord& Marker = Markers[Index];
+    if (bActive && Marker.ActiveIndex == INDEX_NONE)
+    {
+        Marker.ActiveIndex = ActiveMarkerIndices.Add(Index);
+        Marker.GridCell = MarkerGrid.Add(Index, Marker.Owner.IsValid() ? Marker.Owner->GetActorLocation() : FVector::ZeroVector);
+    }
+    else if (!bActive && Marker.ActiveIndex != INDEX_NONE)
+    {
+        MarkerGrid.Remove(Index, Marker.GridCell);
+
+        const int32 RemovedIndex = Marker.ActiveIndex;
+        ActiveMarkerIndices.RemoveAtSwap(RemovedIndex, 1, false);
+        if (ActiveMarkerIndices.IsValidIndex(RemovedIndex))
+        {
+            Markers[ActiveMarkerIndices[RemovedIndex]].ActiveIndex = RemovedIndex;
+        }
+        Marker.ActiveIndex = INDEX_NONE;
+    }
+}
+
+void UMarkerSubsystem::UpdateMarkerGrid()
+{
+    for (const int32 Index : ActiveMarkerIndices)
+    {
+        FMarkerRecord& Marker = Markers[Index];
+        const AActor* Owner = Marker.Owner.Get();
+        if (Owner && Owner->IsRootComponentMovable())
+        {
+            Marker.GridCell = MarkerGrid.Move(Index, Marker.GridCell, Owner->GetActorLocation());
+        }
+    }
+}
+
+void UMarkerSubsystem::UpdateLayout()
+{
+    PCQS_SCOPE_CYCLE_COUNTER(STAT_PCQS_MarkerLayout);
+
+    FMarkerProjectionView ProjectionView;
+    if (ActiveMarkerIndices.Num() == 0 || !ProjectionView.Initialize(GetWorld()->GetFirstPlayerController(), true))
+    {
+        return;
+    }
+
+    FMemMark Mark(FMemStack::Get());
+    TArray<int32, TMemStackAllocator<>> Candidates;
+    TArray<FVector, TMemStackAllocator<>> Locations;
+    TArray<FVector, TMemStackAllocator<>> Offsets;
+    TArray<float, TMemStackAllocator<>> PercentageEdges;
+    Candidates.Reserve(ActiveMarkerIndices.Num());
+    Locations.Reserve(ActiveMarkerIndices.Num());
+    Offsets.Reserve(ActiveMarkerIndices.Num());
+    PercentageEdges.Reserve(ActiveMarkerIndices.Num());
+
+    for (const int32 Index : ActiveMarkerIndices)
+    {
+        const FMarkerRecord& Marker = Markers[Index];
+        const AActor* Owner = Marker.Owner.Get();
+        if (Owner && Marker.Widget && Marker.Widget->IsInViewport())
+        {
+            Candidates.Add(Index);
+            Locations.Add(Owner->GetActorLocation());
+            Offsets.Add(Marker.Offset);
+            PercentageEdges.Add(Marker.Widget->GetEdgePercentage());
+        }
+    }
+
+    const int32 NumCandidates = Candidates.Num();
+    TArray<FMarkerScreenInfo, TMemStackAllocator<>> ScreenInfos;
+    ScreenInfos.SetNum(NumCandidates);
+    ProjectionView.ProjectMarkers(Locations, Offsets, PercentageEdges, ScreenInfos);
+
+    // Highest priority first, then nearest first
+    TArray<int32, TMemStackAllocator<>> Order;
+    Order.SetNumUninitialized(NumCandidates);
+    for (int32 Slot = 0; Slot < NumCandidates; ++Slot)
+    {
+        Order[Slot] = Slot;
+    }
+    Order.Sort([this, &Candidates, &ScreenInfos](int32 A, int32 B)
+    {
+        const int32 PriorityA = Markers[Candidates[A]].Priority;
+        const int32 PriorityB = Markers[Candidates[B]].Priority;
+        return PriorityA != PriorityB ? PriorityA > PriorityB : ScreenInfos[A].DistanceToActor < ScreenInfos[B].DistanceToActor;
+    });
+
+    // Greedy clustering: a marker joins the first visible marker within the radius, otherwise takes a visible slot if one is left.
+    // Markers that do neither are culled. Cluster counts of zero mean hidden.
+    const int32 MaxVisible = CVarMarkerMaxVisible.GetValueOnGameThread();
+    const float ClusterRadiusSquared = FMath::Square(FMath::Max(0.f, CVarMarkerClusterRadius.GetValueOnGameThread()));
+    TArray<int32, TMemStackAllocator<>> ClusterCounts;
+    TArray<int32, TMemStackAllocator<>> Leaders;
+    ClusterCounts.SetNumZeroed(NumCandidates);
+
+    for (const int32 Slot : Order)
+    {
+        const FVector2D& ScreenPosition = ScreenInfos[Slot].ScreenPosition;
+        int32 Leader = INDEX_NONE;
+        if (ClusterRadiusSquared > 0.f)
+        {
+            for (const int32 LeaderSlot : Leaders)
+            {
+                if (FVector2D::DistSquared(ScreenPosition, ScreenInfos[LeaderSlot].ScreenPosition) <= ClusterRadiusSquared)
+                {
+                    Leader = LeaderSlot;
+                    break;
+                }
+            }
+        }
+
+        if (Leader != INDEX_NONE)
+        {
+            ++ClusterCounts[Leader];
+        }
+        else if (MaxVisible <= 0 || Leaders.Num() < MaxVisible)
+        {
+            Leaders.Add(Slot);
+            ClusterCounts[Slot] = 1;
+        }
+    }
+
+    // Only visible markers inside the screen can be occluded, edge clamped ones already point somewhere else
+    const bool bOcclusion = CVarMarkerOcclusion.GetValueOnGameThread() != 0;
+    if (bOcclusion)
+    {
+        TArray<int32, TMemStackAllocator<>> OcclusionMarkers;
+        TArray<FVector, TMemStackAllocator<>> OcclusionLocations;
+        for (const int32 Slot : Leaders)
+        {
+            if (ScreenInfos[Slot].bIsOnScreen)
+            {
+                OcclusionMarkers.Add(Candidates[Slot]);
+                OcclusionLocations.Add(Locations[Slot] + Offsets[Slot]);
+            }
+        }
+        RequestOcclusionTraces(ProjectionView.GetCameraLocation(), OcclusionMarkers, OcclusionLocations);
+    }
+
+    for (int32 Slot = 0; Slot < NumCandidates; ++Slot)
+    {
+        const FMarkerRecord& Marker = Markers[Candidates[Slot]];
+        UIconMarkerUMG* Widget = Marker.Widget;
+        if (ClusterCounts[Slot] > 0)
+        {
+            Widget->ApplyLayout(ScreenInfos[Slot], ClusterCounts[Slot]);
+            Widget->SetOccluded(bOcclusion && ScreenInfos[Slot].bIsOnScreen && Marker.bOccluded);
+        }
+        Widget->SetLayoutVisible(ClusterCounts[Slot] > 0);
+    }
+
+    INC_DWORD_STAT_BY(STAT_PCQS_VisibleMarkers, Leaders.Num());
+    INC_DWORD_STAT_BY(STAT_PCQS_ClusteredMarkers, NumCandidates - Leaders.Num());
+    bLayoutApplied = true;
+}
+
+void UMarkerSubsystem::ClearLayout()
+{
+    for (const FMarkerRecord& Marker : Markers)
+    {
+        if (Marker.Widget)
+        {
+            Marker.Widget->ClearLayout();
+            Marker.Widget->SetOccluded(false);
+        }
+    }
+    bLayoutApplied = false;
+}
+
+void UMarkerSubsystem::RequestOcclusionTraces(const FVector& ViewLocation, TArrayView<const int32> VisibleMarkers, TArrayView<const FVector> MarkerLocations)
+{
+    UWorld* World = GetWorld();
+    const double Now = World->GetTimeSeconds();
+    const float BaseInterval = FMath::Max(0.f, CVarMarkerOcclusionInterval.GetValueOnGameThread());
+    int32 Budget = CVarMarkerOcclusionTracesPerFrame.GetValueOnGameThread();
+
+    const APlayerController* PlayerController = World->GetFirstPlayerController();
+    const APawn* Pawn = PlayerController ? PlayerController->GetPawn() : nullptr;
+
+    // Markers come in layout order, so high priority and near markers get the budget first
+    for (int32 i = 0; i < VisibleMarkers.Num() && Budget > 0; ++i)
+    {
+        FMarkerRecord& Marker = Markers[VisibleMarkers[i]];
+        if (Marker.OcclusionTrace.IsValid() || Now < Marker.NextOcclusionCheckTime)
+        {
+            continue;
+        }
+
+        FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(PCQSMarkerOcclusion), false, Pawn);
+        QueryParams.AddIgnoredActor(Marker.Owner.Get());
+
+        Marker.OcclusionTrace = World->AsyncLineTraceByChannel(EAsyncTraceType::Test, ViewLocation, MarkerLocations[i], ECC_Visibility,
+            QueryParams, FCollisionResponseParams::DefaultResponseParam, &OcclusionTraceDelegate, (uint32)VisibleMarkers[i]);
+
+        const double MetersDistance = FVector::Dist(ViewLocation, MarkerLocations[i]) * 0.01;
+        Marker.NextOcclusionCheckTime = Now + BaseInterval * (1.0 + MetersDistance / 100.0);
+        --Budget;
+        INC_DWORD_STAT(STAT_PCQS_OcclusionTraces);
+    }
+}
+
+void UMarkerSubsystem::OnOcclusionTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum)
+{
+    // The record may have been removed, or its slot reused, while the trace was in flight
+    const int32 Index = (int32)TraceDatum.UserData;
+    if (Markers.IsValidIndex(Index) && Markers[Index].OcclusionTrace == TraceHandle)
+    {
+        FMarkerRecord& Marker = Markers[Index];
+        Marker.OcclusionTrace.Invalidate();
+        Marker.bOccluded = TraceDatum.OutHits.Num() > 0;
+    }
+}
+
+void UMarkerSubsystem::OnMarkerOwnerDestroyed(AActor* DestroyedActor)
+{
+    TArray<int32, TInlineAllocator<4>> OwnedMarkers;
+    OwnerMarkers.MultiFind(DestroyedActor, OwnedMarkers);
+    for (const int32 Index : OwnedMarkers)
+    {
+        RemoveMarkerAt(Index);
+    }
+    OwnerMarkers.Remove(DestroyedActor);
+}
@@ -6,8 +6,8 @@
 #include <Components/IconMarkerComponent.h>
 #include "Kismet/KismetSystemLibrary.h"
 #include "Kismet/GameplayStatics.h"
-
-TArray<UIconMarkerComponent*> UPCQSBlueprintFunctionLibrary::AllMarkerComponents = {};
+#include "Markers/MarkerSubsystem.h"
+#include "PCQuestSystem.h"
 
 void UPCQSBlueprintFunctionLibrary::GetActorInformationToPlayerController(APlayerController* PlayerController, AActor* ActorToCheck, bool bUseCameraLocation, FVector ActorToCheckOffSet, FVector2D& OutScreenPosition, float& OutRotationAngleDegrees, float& DistanceToActor, bool& bIsOnScreen, float PercentageEdge /*= 1.0f*/)
 {
@@ -119,9 +119,30 @@ void UPCQSBlueprintFunctionLibrary::GetActorInformationToPlayerController(APlaye
     OutScreenPosition = ScreenPosition;
 }
 
-TArray<UIconMarkerComponent*> UPCQSBlueprintFunctionLibrary::GetAllIconComponents()
+void UPCQSBlueprintFunctionLibrary::GetMarkersInformationToPlayerController(APlayerController* PlayerController, const TArray<FVector>& MarkerLocations, const TArray<FVector>& MarkerOffsets, bool bUseCameraLocation, TArray<FMarkerScreenInfo>& OutMarkersInformation, float PercentageEdge /*= 1.0f*/)
+{
+    OutMarkersInformation.Reset();
+    OutMarkersInformation.SetNum(MarkerLocations.Num());
+
+    if (MarkerOffsets.Num() != 0 && MarkerOffsets.Num() != MarkerLocations.Num())
+    {
+        return;
+    }
+
+    FMarkerProjectionView ProjectionView;
+    if (ProjectionView.Initialize(PlayerController, bUseCameraLocation))
+    {
+        ProjectionView.ProjectMarkers(MarkerLocations, MarkerOffsets, PercentageEdge, OutMarkersInformation);
+    }
+}
+
+TArray<UIconMarkerComponent*> UPCQSBlueprintFunctionLibrary::GetAllIconComponents(const UObject* WorldContextObject)
 {
-    return AllMarkerComponents;
+    if (const UMarkerSubsystem* MarkerSubsystem = UMarkerSubsystem::Get(WorldContextObject))
+    {
+        return MarkerSubsystem->GetAllMarkerComponents();
+    }
+    return {};
 }
 
 void UPCQSBlueprintFunctionLibrary::GetActorXPositionOnCompass(APlayerController* PlayerController, AActor* ActorToCheck, float margin, float& XPosition)
@@ -140,51 +161,109 @@ void UPCQSBlueprintFunctionLibrary::GetActorXPositionOnCompass(APlayerController
     XPosition = UKismetMathLibrary::DotProduct2D(RightVector2D, normalized2D) / UKismetMathLibrary::DotProduct2D(ForwardVector2D, normalized2D) * margin;
 }
 
-AQuestManager* UPCQSBlueprintFunctionLibrary::GetWorldQuestManager(UObject* WorldContext)
+void UPCQSBlueprintFunctionLibrary::GetCompassMarkers(APlayerController* PlayerController, float Margin, TArray<FCompassMarker>& OutCompassMarkers, float FieldOfViewDegrees /*= 360.f*/)
 {
-    if (WorldContext && WorldContext->GetWorld())
+    OutCompassMarkers.Reset();
+
+    const UMarkerSubsystem* MarkerSubsystem = UMarkerSubsystem::Get(PlayerController);
+    FCompassStripView CompassView;
+    if (!MarkerSubsystem || !CompassView.Initialize(PlayerController, FieldOfViewDegrees))
     {
-        TArray<AActor*> questManager;
-        UGameplayStatics::GetAllActorsOfClass(WorldContext, AQuestManager::StaticClass(), questManager);
-        if (questManager.Num() == 0)
+        return;
+    }
+
+    for (const int32 MarkerIndex : MarkerSubsystem->GetActiveMarkerIndices())
+    {
+        const FMarkerRecord& Marker = MarkerSubsystem->GetMarkerAt(MarkerIndex);
+        AActor* MarkerOwner = Marker.Owner.Get();
+        if (!Marker.bShowOnCompass || !MarkerOwner)
         {
-            UKismetSystemLibrary::PrintString(WorldContext, FString::Printf(TEXT("Tried to get Quest Manager but the world has none. Please put a QuestManager in the World.")));
-            return nullptr;
+            continue;
+        }
+
+        float XPosition;
+        if (CompassView.GetXPosition(MarkerOwner->GetActorLocation(), Margin, XPosition))
+        {
+            FCompassMarker& CompassMarker = OutCompassMarkers.AddDefaulted_GetRef();
+            CompassMarker.MarkerComponent = Marker.Component.Get();
+            CompassMarker.MarkerOwner = MarkerOwner;
+            CompassMarker.Icon = Marker.Icon;
+            CompassMarker.XPosition = XPosition;
         }
-        return Cast<AQuestManager>(questManager[0]);
     }
+}
 
-    return nullptr;
+namespace PCQSMapMarkers
+{
+    static void ToMapMarkers(const UMarkerSubsystem& MarkerSubsystem, const TArray<int32>& MarkerIndices, TArray<FMapMarker>& OutMapMarkers)
+    {
+        OutMapMarkers.Reserve(MarkerIndices.Num());
+        for (const int32 MarkerIndex : MarkerIndices)
+        {
+            const FMarkerRecord& Marker = MarkerSubsystem.GetMarkerAt(MarkerIndex);
+            if (AActor* MarkerOwner = Marker.Owner.Get())
+            {
+                FMapMarker& MapMarker = OutMapMarkers.AddDefaulted_GetRef();
+                MapMarker.MarkerComponent = Marker.Component.Get();
+                MapMarker.MarkerOwner = MarkerOwner;
+                MapMarker.Icon = Marker.Icon;
+                MapMarker.WorldLocation = MarkerOwner->GetActorLocation();
+            }
+        }
+    }
 }
 
-void UPCQSBlueprintFunctionLibrary::AddIconMarkerComponent(UIconMarkerComponent* Component)
+void UPCQSBlueprintFunctionLibrary::GetMarkersInRadius(const UObject* WorldContextObject, FVector Center, float Radius, TArray<FMapMarker>& OutMapMarkers)
 {
-    AllMarkerComponents.Add(Component);
+    OutMapMarkers.Reset();
+    if (const UMarkerSubsystem* MarkerSubsystem = UMarkerSubsystem::Get(WorldContextObject))
+    {
+        TArray<int32> MarkerIndices;
+        MarkerSubsystem->QueryMarkersInRadius(Center, Radius, MarkerIndices);
+        PCQSMapMarkers::ToMapMarkers(*MarkerSubsystem, MarkerIndices, OutMapMarkers);
+    }
 }
 
-void UPCQSBlueprintFunctionLibrary::RemoveIconMarkerComponent(UIconMarkerComponent* Component)
+void UPCQSBlueprintFunctionLibrary::GetMarkersInBox(const UObject* WorldContextObject, FVector2D BoxMin, FVector2D BoxMax, TArray<FMapMarker>& OutMapMarkers)
 {
-    AllMarkerComponents.Remove(Component);
+    OutMapMarkers.Reset();
+    if (const UMarkerSubsystem* MarkerSubsystem = UMarkerSubsystem::Get(WorldContextObject))
+    {
+        TArray<int32> MarkerIndices;
+        MarkerSubsystem->QueryMarkersInBox(FBox2D(BoxMin, BoxMax), MarkerIndices);
+        PCQSMapMarkers::ToMapMarkers(*MarkerSubsystem, MarkerIndices, OutMapMarkers);
+    }
 }
 
-void UPCQSBlueprintFunctionLibrary::ShowHiddenIconMarkerComponents()
+AQuestManager* UPCQSBlueprintFunctionLibrary::GetWorldQuestManager(UObject* WorldContext)
 {
-    for (auto MarkerComponent : AllMarkerComponents)
+    if (WorldContext && WorldContext->GetWorld())
     {
-        if (MarkerComponent->IsMarkerActive())
+        TArray<AActor*> questManager;
+        UGameplayStatics::GetAllActorsOfClass(WorldContext, AQuestManager::StaticClass(), questManager);
+        if (questManager.Num() == 0)
         {
-            MarkerComponent->ShowMarker();
+            UE_LOG(LogPCQuestSystem, Warning, TEXT("Tried to get Quest Manager but the world has none. Please put a QuestManager in the World."));
+            return nullptr;
         }
+        return Cast<AQuestManager>(questManager[0]);
     }
+
+    return nullptr;
 }
 
-void UPCQSBlueprintFunctionLibrary::HideIconMarkerComponents()
+void UPCQSBlueprintFunctionLibrary::ShowHiddenIconMarkerComponents(const UObject* WorldContextObject)
 {
-    for (auto MarkerComponent : AllMarkerComponents)
+    if (const UMarkerSubsystem* MarkerSubsystem = UMarkerSubsystem::Get(WorldContextObject))
     {
-        if (MarkerComponent->IsMarkerActive())
-        {
-            MarkerComponent->HideMarker();
-        }
+        MarkerSubsystem->ShowActiveMarkers();
+    }
+}
+
+void UPCQSBlueprintFunctionLibrary::HideIconMarkerComponents(const UObject* WorldContextObject)
+{
+    if (const UMarkerSubsystem* MarkerSubsystem = UMarkerSubsystem::Get(WorldContextObject))
+    {
+        MarkerSubsystem->HideActiveMarkers();
     }
 }
@@ -1,9 +1,18 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "PCQuestSystem.h"
+#include "PCQuestSystemStats.h"
 
 #define LOCTEXT_NAMESPACE "FPCQuestSystemModule"
 
+DEFINE_LOG_CATEGORY(LogPCQuestSystem);
+UE_TRACE_CHANNEL_DEFINE(PCQuestSystemChannel);
+LLM_DEFINE_TAG(PCQuestSystem);
+LLM_DEFINE_TAG(PCQuestSystem_Definitions, TEXT("Definitions"), TEXT("PCQuestSystem"));
+LLM_DEFINE_TAG(PCQuestSystem_RuntimeState, TEXT("RuntimeState"), TEXT("PCQuestSystem"));
+LLM_DEFINE_TAG(PCQuestSystem_Markers, TEXT("Markers"), TEXT("PCQuestSystem"));
+LLM_DEFINE_TAG(PCQuestSystem_SpawnedActors, TEXT("SpawnedActors"), TEXT("PCQuestSystem"));
+
 void FPCQuestSystemModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
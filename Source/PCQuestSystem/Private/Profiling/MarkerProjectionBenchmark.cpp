@@ -0,0 +1,103 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#include "CoreMinimal.h"
+#include "PCQuestSystem.h"
+#include "PCQSBlueprintFunctionLibrary.h"
+#include "Markers/MarkerProjection.h"
+#include "Engine/TargetPoint.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+
+#if !UE_BUILD_SHIPPING
+
+namespace MarkerProjectionBenchmark
+{
+    static void Run(const TArray<FString>& Args, UWorld* World)
+    {
+        APlayerController* PlayerController = World ? World->GetFirstPlayerController() : nullptr;
+        if (!PlayerController || !PlayerController->GetPawn())
+        {
+            UE_LOG(LogPCQuestSystem, Warning, TEXT("pcqs.Bench.MarkerProjection needs a local player controller with a pawn."));
+            return;
+        }
+
+        const int32 Iterations = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 200;
+        const FVector Offset = FVector(0.f, 0.f, 100.f);
+        const FVector Center = PlayerController->GetPawn()->GetActorLocation();
+        FRandomStream RandomStream(1337);
+
+        for (const int32 NumMarkers : { 1, 100, 1000 })
+        {
+            TArray<AActor*> Actors;
+            FActorSpawnParameters SpawnParameters;
+            SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+            for (int32 i = 0; i < NumMarkers; ++i)
+            {
+                const FVector Location = Center + RandomStream.VRand() * RandomStream.FRandRange(500.f, 50000.f);
+                Actors.Add(World->SpawnActor<ATargetPoint>(Location, FRotator::ZeroRotator, SpawnParameters));
+            }
+
+            TArray<FMarkerScreenInfo> PerActorInfos;
+            PerActorInfos.SetNum(NumMarkers);
+            const double PerActorStart = FPlatformTime::Seconds();
+            for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+            {
+                for (int32 i = 0; i < NumMarkers; ++i)
+                {
+                    FMarkerScreenInfo& Info = PerActorInfos[i];
+                    UPCQSBlueprintFunctionLibrary::GetActorInformationToPlayerController(PlayerController, Actors[i], true, Offset, Info.ScreenPosition, Info.RotationAngleDegrees, Info.DistanceToActor, Info.bIsOnScreen, 0.8f);
+                }
+            }
+            const double PerActorSeconds = FPlatformTime::Seconds() - PerActorStart;
+
+            TArray<FVector> Locations;
+            TArray<FVector> Offsets;
+            TArray<FMarkerScreenInfo> BatchInfos;
+            Locations.SetNumUninitialized(NumMarkers);
+            Offsets.Init(Offset, NumMarkers);
+            BatchInfos.SetNum(NumMarkers);
+            const double BatchStart = FPlatformTime::Seconds();
+            for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+            {
+                for (int32 i = 0; i < NumMarkers; ++i)
+                {
+                    Locations[i] = Actors[i]->GetActorLocation();
+                }
+                FMarkerProjectionView ProjectionView;
+                ProjectionView.Initialize(PlayerController, true);
+                ProjectionView.ProjectMarkers(Locations, Offsets, 0.8f, BatchInfos);
+            }
+            const double BatchSeconds = FPlatformTime::Seconds() - BatchStart;
+
+            float MaxPositionError = 0.f;
+            int32 OnScreenMismatches = 0;
+            for (int32 i = 0; i < NumMarkers; ++i)
+            {
+                MaxPositionError = FMath::Max(MaxPositionError, (float)FVector2D::Distance(PerActorInfos[i].ScreenPosition, BatchInfos[i].ScreenPosition));
+                OnScreenMismatches += PerActorInfos[i].bIsOnScreen != BatchInfos[i].bIsOnScreen ? 1 : 0;
+            }
+
+            const double PerActorMicroseconds = PerActorSeconds * 1e6 / Iterations;
+            const double BatchMicroseconds = BatchSeconds * 1e6 / Iterations;
+            UE_LOG(LogPCQuestSystem, Display, TEXT("MarkerProjection %4d markers: per actor %9.2f us/frame, batch %9.2f us/frame, speedup %5.2fx, max error %.3f px, on screen mismatches %d"),
+                NumMarkers, PerActorMicroseconds, BatchMicroseconds, BatchMicroseconds > 0.0 ? PerActorMicroseconds / BatchMicroseconds : 0.0, MaxPositionError, OnScreenMismatches);
+
+            for (AActor* Actor : Actors)
+            {
+                if (Actor)
+                {
+                    Actor->Destroy();
+                }
+            }
+        }
+    }
+
+    static FAutoConsoleCommandWithWorldAndArgs BenchmarkCommand(
+        TEXT("pcqs.Bench.MarkerProjection"),
+        TEXT("Compares the per actor and batched marker projection at 1, 100 and 1000 markers. Optional argument: iterations per size (default 200)."),
+        FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&Run));
+}
+
+#endif
@@ -0,0 +1,422 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#include "Profiling/PCQSBenchmarkCommandlet.h"
+#include "Dom/JsonObject.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/MemoryBase.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "NativeGameplayTags.h"
+#include "PCQuestSystem.h"
+#include "Profiling/PCQSHeadlessWorld.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include <atomic>
+
+// Editor only, so the benchmark tags are not registered in games
+#if WITH_EDITOR
+
+namespace PCQSBenchmark
+{
+    UE_DEFINE_GAMEPLAY_TAG_STATIC(Place0, "PCQS.Benchmark.Place.0");
+    UE_DEFINE_GAMEPLAY_TAG_STATIC(Place1, "PCQS.Benchmark.Place.1");
+    UE_DEFINE_GAMEPLAY_TAG_STATIC(Place2, "PCQS.Benchmark.Place.2");
+    UE_DEFINE_GAMEPLAY_TAG_STATIC(Place3, "PCQS.Benchmark.Place.3");
+    UE_DEFINE_GAMEPLAY_TAG_STATIC(Entity0, "PCQS.Benchmark.Entity.0");
+    UE_DEFINE_GAMEPLAY_TAG_STATIC(Entity1, "PCQS.Benchmark.Entity.1");
+    UE_DEFINE_GAMEPLAY_TAG_STATIC(Entity2, "PCQS.Benchmark.Entity.2");
+    UE_DEFINE_GAMEPLAY_TAG_STATIC(Entity3, "PCQS.Benchmark.Entity.3");
+    UE_DEFINE_GAMEPLAY_TAG_STATIC(Item0, "PCQS.Benchmark.Item.0");
+    UE_DEFINE_GAMEPLAY_TAG_STATIC(Item1, "PCQS.Benchmark.Item.1");
+    UE_DEFINE_GAMEPLAY_TAG_STATIC(Item2, "PCQS.Benchmark.Item.2");
+    UE_DEFINE_GAMEPLAY_TAG_STATIC(Item3, "PCQS.Benchmark.Item.3");
+
+    static const FNativeGameplayTag* const PlaceTags[] = { &Place0, &Place1, &Place2, &Place3 };
+    static const FNativeGameplayTag* const EntityTags[] = { &Entity0, &Entity1, &Entity2, &Entity3 };
+    static const FNativeGameplayTag* const ItemTags[] = { &Item0, &Item1, &Item2, &Item3 };
+
+    template <int32 NumTags>
+    static FGameplayTag RandomTag(FRandomStream& Random, const FNativeGameplayTag* const (&Tags)[NumTags])
+    {
+        return Tags[Random.RandHelper(NumTags)]->GetTag();
+    }
+
+    /* Forwards to the real allocator and counts what goes through it */
+    class FCountingMalloc final : public FMalloc
+    {
+    public:
+        explicit FCountingMalloc(FMalloc* InInner)
+            : Inner(InInner)
+        {
+        }
+
+        virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+        {
+            Allocations.fetch_add(1, std::memory_order_relaxed);
+            AllocatedBytes.fetch_add(Count, std::memory_order_relaxed);
+            return Inner->Malloc(Count, Alignment);
+        }
+
+        virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+        {
+            Allocations.fetch_add(1, std::memory_order_relaxed);
+            AllocatedBytes.fetch_add(Count, std::memory_order_relaxed);
+            return Inner->Realloc(Original, Count, Alignment);
+        }
+
+        virtual void Free(void* Original) override { Inner->Free(Original); }
+        virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+        virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+        virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+        virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+        virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+        virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+        virtual void UpdateStats() override { Inner->UpdateStats(); }
+        virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override { Inner->GetAllocatorStats(OutStats); }
+        virtual bool ValidateHeap() override { return Inner->ValidateHeap(); }
+        virtual const TCHAR* GetDescriptiveName() override { return TEXT("PCQSBenchmarkCountingMalloc"); }
+
+        FMalloc* GetInner() const { return Inner; }
+        uint64 GetAllocations() const { return Allocations.load(std::memory_order_relaxed); }
+        uint64 GetAllocatedBytes() const { return AllocatedBytes.load(std::memory_order_relaxed); }
+
+    private:
+        FMalloc* Inner;
+        std::atomic<uint64> Allocations{ 0 };
+        std::atomic<uint64> AllocatedBytes{ 0 };
+    };
+
+    struct FAllocationSnapshot
+    {
+        explicit FAllocationSnapshot(const FCountingMalloc& InCounter)
+            : Counter(InCounter),
+            StartAllocations(InCounter.GetAllocations()),
+            StartBytes(InCounter.GetAllocatedBytes())
+        {
+        }
+
+        uint64 GetAllocations() const { return Counter.GetAllocations() - StartAllocations; }
+        uint64 GetBytes() const { return Counter.GetAllocatedBytes() - StartBytes; }
+
+        const FCountingMalloc& Counter;
+        uint64 StartAllocations;
+        uint64 StartBytes;
+    };
+
+    static void BuildQuests(int32 NumQuests, FRandomStream& Random, TArray<FQuest>& OutQuests)
+    {
+        const FIconMarkerInformation NoMarker{};
+        OutQuests.SetNum(NumQuests);
+        for (FQuest& Quest : OutQuests)
+        {
+            Quest.QuestType = EQuestType::Side;
+            const int32 NumSteps = Random.RandRange(1, 5);
+            for (int32 Step = 0; Step < NumSteps; ++Step)
+            {
+                switch (Random.RandHelper(5))
+                {
+                case 0:
+                {
+                    FQuestStepGoToObjective& Objective = Quest.GoToObjectives.Add(Step);
+                    Objective.ObjectiveMarkerUMGInformation = NoMarker;
+                    Objective.PlaceToGo = RandomTag(Random, PlaceTags);
+                    break;
+                }
+                case 1:
+                {
+                    FQuestStepTalkWithObjective& Objective = Quest.TalkWithObjectives.Add(Step);
+                    Objective.ObjectiveMarkerUMGInformation = NoMarker;
+                    Objective.EntityToTalkWith = RandomTag(Random, EntityTags);
+                    break;
+                }
+                case 2:
+                {
+                    FQuestStepKillObjective& Objective = Quest.KillObjectives.Add(Step);
+                    Objective.ObjectiveMarkerUMGInformation = NoMarker;
+                    Objective.EntityToKill = RandomTag(Random, EntityTags);
+                    Objective.AmountToKill = Random.RandRange(1, 5);
+                    break;
+                }
+                case 3:
+                {
+                    FQuestStepGatherObjective& Objective = Quest.GatherObjectives.Add(Step);
+                    Objective.ObjectiveMarkerUMGInformation = NoMarker;
+                    Objective.ItemToGather = RandomTag(Random, ItemTags);
+                    Objective.AmountToGather = Random.RandRange(1, 5);
+                    break;
+                }
+                default:
+                {
+                    FQuestStepCatchObjective& Objective = Quest.CatchObjectives.Add(Step);
+                    Objective.ObjectiveMarkerUMGInformation = NoMarker;
+                    Objective.AllowedTagToCatch.Add(RandomTag(Random, ItemTags));
+                    break;
+                }
+                }
+            }
+        }
+    }
+
+    static double Percentile(TArray<double>& SortedValues, double Fraction)
+    {
+        if (SortedValues.Num() == 0)
+        {
+            return 0.0;
+        }
+        const int32 Index = FMath::Clamp(FMath::CeilToInt(Fraction * SortedValues.Num()) - 1, 0, SortedValues.Num() - 1);
+        return SortedValues[Index];
+    }
+
+    static void DispatchRandomEvent(AQuestManager* QuestManager, APlayerController* PlayerController, FRandomStream& Random)
+    {
+        switch (Random.RandHelper(5))
+        {
+        case 0:
+            QuestManager->OnArrivedToPlace(RandomTag(Random, PlaceTags), PlayerController);
+            break;
+        case 1:
+            QuestManager->OnEntityTalkedTo(RandomTag(Random, EntityTags), PlayerController);
+            break;
+        case 2:
+            QuestManager->OnEntityKilled(RandomTag(Random, EntityTags), PlayerController);
+            break;
+        case 3:
+            QuestManager->OnItemGathered(RandomTag(Random, ItemTags), 1.f, PlayerController);
+            break;
+        default:
+            QuestManager->OnCatch(RandomTag(Random, ItemTags), PlayerController);
+            break;
+        }
+    }
+
+    /* Returns the names of the metrics that got worse than the baseline by more than the tolerance */
+    static TArray<FString> CompareWithBaseline(const FJsonObject& Result, const FJsonObject& Baseline, double Tolerance)
+    {
+        TArray<FString> Regressions;
+        const double EventsPerSecond = Result.GetNumberField(TEXT("events_per_second"));
+        const double BaselineEventsPerSecond = Baseline.GetNumberField(TEXT("events_per_second"));
+        if (EventsPerSecond < BaselineEventsPerSecond * (1.0 - Tolerance))
+        {
+            Regressions.Add(FString::Printf(TEXT("events_per_second %.1f (baseline %.1f)"), EventsPerSecond, BaselineEventsPerSecond));
+        }
+
+        for (const TCHAR* Field : { TEXT("activation_us_p95"), TEXT("allocations_per_event") })
+        {
+            const double Value = Result.GetNumberField(Field);
+            const double BaselineValue = Baseline.GetNumberField(Field);
+            if (Value > BaselineValue * (1.0 + Tolerance) && Value - BaselineValue > UE_KINDA_SMALL_NUMBER)
+            {
+                Regressions.Add(FString::Printf(TEXT("%s %.2f (baseline %.2f)"), Field, Value, BaselineValue));
+            }
+        }
+        return Regressions;
+    }
+}
+
+#endif
+
+UPCQSBenchmarkCommandlet::UPCQSBenchmarkCommandlet()
+{
+    IsClient = false;
+    IsEditor = false;
+    IsServer = true;
+    LogToConsole = true;
+}
+
+void UPCQSBenchmarkCommandlet::OnBenchmarkQuestCompleted(FQuest CompletedQuest)
+{
+    ++CompletedQuestCount;
+}
+
+int32 UPCQSBenchmarkCommandlet::Main(const FString& Params)
+{
+#if !WITH_EDITOR
+    UE_LOG(LogPCQuestSystem, Error, TEXT("PCQSBenchmark only runs in editor builds"));
+    return 2;
+#else
+    using namespace PCQSBenchmark;
+
+    FString QuestCountsString = TEXT("100,1000,10000,50000");
+    FParse::Value(*Params, TEXT("Quests="), QuestCountsString);
+    TArray<FString> QuestCountStrings;
+    QuestCountsString.ParseIntoArray(QuestCountStrings, TEXT(","));
+
+    int32 MaxActiveQuests = 256;
+    int32 NumEvents = 20000;
+    int32 EventsPerFrame = 100;
+    int32 Seed = 1337;
+    float MaxSeconds = 30.f;
+    float Tolerance = 0.15f;
+    FParse::Value(*Params, TEXT("Active="), MaxActiveQuests);
+    FParse::Value(*Params, TEXT("Events="), NumEvents);
+    FParse::Value(*Params, TEXT("EventsPerFrame="), EventsPerFrame);
+    FParse::Value(*Params, TEXT("Seed="), Seed);
+    FParse::Value(*Params, TEXT("MaxSeconds="), MaxSeconds);
+    FParse::Value(*Params, TEXT("Tolerance="), Tolerance);
+    EventsPerFrame = FMath::Max(1, EventsPerFrame);
+
+    FString OutputPath = FPaths::ProjectSavedDir() / TEXT("Profiling") / TEXT("PCQSBenchmark.json");
+    FString BaselinePath;
+    FParse::Value(*Params, TEXT("Output="), OutputPath);
+    FParse::Value(*Params, TEXT("Baseline="), BaselinePath);
+
+    // Leaked on purpose, allocations made through it are freed later straight through the inner allocator
+    FCountingMalloc* CountingMalloc = new FCountingMalloc(GMalloc);
+    GMalloc = CountingMalloc;
+
+    TArray<TSharedPtr<FJsonValue>> Results;
+    for (const FString& QuestCountString : QuestCountStrings)
+    {
+        const int32 NumQuests = FCString::Atoi(*QuestCountString);
+        if (NumQuests <= 0)
+        {
+            continue;
+        }
+
+        FRandomStream Random(Seed);
+        TArray<FQuest> QuestRows;
+        BuildQuests(NumQuests, Random, QuestRows);
+        TArray<FQuest*> QuestRowPointers;
+        for (FQuest& QuestRow : QuestRows)
+        {
+            QuestRowPointers.Add(&QuestRow);
+        }
+
+        FPCQSHeadlessWorld HeadlessWorld;
+        AQuestManager* QuestManager = HeadlessWorld.QuestManager;
+        APlayerController* PlayerController = HeadlessWorld.AddPlayer();
+        QuestManager->OnQuestCompletedDelegate.AddDynamic(this, &UPCQSBenchmarkCommandlet::OnBenchmarkQuestCompleted);
+        CompletedQuestCount = 0;
+
+        // Load
+        const uint64 UsedMemoryBeforeLoad = FPlatformMemory::GetStats().UsedPhysical;
+        const FAllocationSnapshot LoadAllocations(*CountingMalloc);
+        const double LoadStart = FPlatformTime::Seconds();
+        QuestManager->LoadQuests(QuestRowPointers);
+        const double LoadSeconds = FPlatformTime::Seconds() - LoadStart;
+        const uint64 LoadAllocationCount = LoadAllocations.GetAllocations();
+        const uint64 LoadAllocationBytes = LoadAllocations.GetBytes();
+        const int64 LoadMemoryDelta = (int64)FPlatformMemory::GetStats().UsedPhysical - (int64)UsedMemoryBeforeLoad;
+
+        // Activation, and again every frame to replace the quests that completed
+        TArray<double> ActivationMicroseconds;
+        int32 NextQuestID = 1;
+        auto TopUpActiveQuests = [&]()
+        {
+            int32 NumActive = QuestManager->GetAllActiveQuestsInfo().Num();
+            while (NumActive < MaxActiveQuests && NextQuestID <= NumQuests)
+            {
+                const double ActivationStart = FPlatformTime::Seconds();
+                QuestManager->ActivateQuest(NextQuestID++);
+                ActivationMicroseconds.Add((FPlatformTime::Seconds() - ActivationStart) * 1e6);
+                ++NumActive;
+            }
+        };
+        TopUpActiveQuests();
+
+        // Event replay. Only the dispatch calls are timed, world ticks and top ups are not
+        double DispatchSeconds = 0.0;
+        int32 EventsDispatched = 0;
+        uint64 EventAllocationCount = 0;
+        const double ReplayStart = FPlatformTime::Seconds();
+        while (EventsDispatched < NumEvents && FPlatformTime::Seconds() - ReplayStart < MaxSeconds)
+        {
+            const int32 FrameEvents = FMath::Min(EventsPerFrame, NumEvents - EventsDispatched);
+            const FAllocationSnapshot EventAllocations(*CountingMalloc);
+            const double FrameStart = FPlatformTime::Seconds();
+            for (int32 i = 0; i < FrameEvents; ++i)
+            {
+                DispatchRandomEvent(QuestManager, PlayerController, Random);
+            }
+            DispatchSeconds += FPlatformTime::Seconds() - FrameStart;
+            EventAllocationCount += EventAllocations.GetAllocations();
+            EventsDispatched += FrameEvents;
+
+            HeadlessWorld.Tick(1.f / 60.f);
+            TopUpActiveQuests();
+        }
+
+        ActivationMicroseconds.Sort();
+        const double EventsPerSecond = DispatchSeconds > 0.0 ? EventsDispatched / DispatchSeconds : 0.0;
+
+        TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+        Result->SetNumberField(TEXT("quests"), NumQuests);
+        Result->SetNumberField(TEXT("load_ms"), LoadSeconds * 1000.0);
+        Result->SetNumberField(TEXT("load_allocations"), (double)LoadAllocationCount);
+        Result->SetNumberField(TEXT("load_allocated_bytes"), (double)LoadAllocationBytes);
+        Result->SetNumberField(TEXT("load_used_physical_delta_bytes"), (double)LoadMemoryDelta);
+        Result->SetNumberField(TEXT("activations"), ActivationMicroseconds.Num());
+        Result->SetNumberField(TEXT("activation_us_p50"), Percentile(ActivationMicroseconds, 0.5));
+        Result->SetNumberField(TEXT("activation_us_p95"), Percentile(ActivationMicroseconds, 0.95));
+        Result->SetNumberField(TEXT("activation_us_max"), Percentile(ActivationMicroseconds, 1.0));
+        Result->SetNumberField(TEXT("events"), EventsDispatched);
+        Result->SetNumberField(TEXT("events_per_second"), EventsPerSecond);
+        Result->SetNumberField(TEXT("allocations_per_event"), EventsDispatched > 0 ? (double)EventAllocationCount / EventsDispatched : 0.0);
+        Result->SetNumberField(TEXT("completed_quests"), CompletedQuestCount);
+        Results.Add(MakeShared<FJsonValueObject>(Result));
+
+        UE_LOG(LogPCQuestSystem, Display, TEXT("PCQSBenchmark %6d quests: load %8.2f ms, activation p50 %8.2f us p95 %8.2f us, %9.1f events/s over %d events, %.2f allocations/event, %d quests completed"),
+            NumQuests, LoadSeconds * 1000.0, Percentile(ActivationMicroseconds, 0.5), Percentile(ActivationMicroseconds, 0.95),
+            EventsPerSecond, EventsDispatched, EventsDispatched > 0 ? (double)EventAllocationCount / EventsDispatched : 0.0, CompletedQuestCount);
+        if (EventsDispatched < NumEvents)
+        {
+            UE_LOG(LogPCQuestSystem, Warning, TEXT("PCQSBenchmark %d quests: stopped after %.0f seconds with %d of %d events"), NumQuests, MaxSeconds, EventsDispatched, NumEvents);
+        }
+    }
+
+    GMalloc = CountingMalloc->GetInner();
+
+    TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+    Report->SetNumberField(TEXT("version"), 1);
+    Report->SetNumberField(TEXT("seed"), Seed);
+    Report->SetNumberField(TEXT("max_active_quests"), MaxActiveQuests);
+    Report->SetArrayField(TEXT("results"), Results);
+
+    FString ReportString;
+    const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&ReportString);
+    FJsonSerializer::Serialize(Report, Writer);
+    if (!FFileHelper::SaveStringToFile(ReportString, *OutputPath))
+    {
+        UE_LOG(LogPCQuestSystem, Error, TEXT("PCQSBenchmark could not write %s"), *OutputPath);
+        return 2;
+    }
+    UE_LOG(LogPCQuestSystem, Display, TEXT("PCQSBenchmark results written to %s"), *OutputPath);
+
+    if (BaselinePath.IsEmpty())
+    {
+        return 0;
+    }
+
+    FString BaselineString;
+    TSharedPtr<FJsonObject> Baseline;
+    if (!FFileHelper::LoadFileToString(BaselineString, *BaselinePath) || !FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(BaselineString), Baseline) || !Baseline.IsValid())
+    {
+        UE_LOG(LogPCQuestSystem, Error, TEXT("PCQSBenchmark could not read baseline %s"), *BaselinePath);
+        return 2;
+    }
+
+    bool bRegressed = false;
+    for (const TSharedPtr<FJsonValue>& ResultValue : Results)
+    {
+        const TSharedPtr<FJsonObject>& Result = ResultValue->AsObject();
+        const int32 NumQuests = (int32)Result->GetNumberField(TEXT("quests"));
+        for (const TSharedPtr<FJsonValue>& BaselineValue : Baseline->GetArrayField(TEXT("results")))
+        {
+            const TSharedPtr<FJsonObject>& BaselineResult = BaselineValue->AsObject();
+            if ((int32)BaselineResult->GetNumberField(TEXT("quests")) != NumQuests)
+            {
+                continue;
+            }
+            for (const FString& Regression : CompareWithBaseline(*Result, *BaselineResult, Tolerance))
+            {
+                UE_LOG(LogPCQuestSystem, Error, TEXT("PCQSBenchmark %d quests regressed: %s"), NumQuests, *Regression);
+                bRegressed = true;
+            }
+        }
+    }
+    return bRegressed ? 1 : 0;
+#endif
+}
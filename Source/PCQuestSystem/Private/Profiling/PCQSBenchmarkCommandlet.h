@@ -0,0 +1,37 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Actors/QuestManager.h"
+#include "Commandlets/Commandlet.h"
+#include "PCQSBenchmarkCommandlet.generated.h"
+
+/**
+ * Headless benchmark of quest dispatch and activation.
+ * For every quest count it builds a synthetic quest database with mixed step types, loads it into a quest manager
+ * in a standalone world and replays a synthetic event stream through it, measuring events per second,
+ * activation latency, allocations and memory. Results go to a JSON file and can be checked against a baseline.
+ *
+ * UnrealEditor-Cmd <Project> -run=PCQSBenchmark -nullrhi -unattended
+ *     [-Quests=100,1000,10000,50000] [-Active=256] [-Events=20000] [-MaxSeconds=30] [-Seed=1337]
+ *     [-Output=<file>] [-Baseline=<file>] [-Tolerance=0.15]
+ *
+ * Returns 1 when a result is worse than the baseline by more than the tolerance.
+ */
+UCLASS()
+class UPCQSBenchmarkCommandlet : public UCommandlet
+{
+    GENERATED_BODY()
+
+public:
+    UPCQSBenchmarkCommandlet();
+
+    virtual int32 Main(const FString& Params) override;
+
+private:
+    UFUNCTION()
+    void OnBenchmarkQuestCompleted(FQuest CompletedQuest);
+
+    int32 CompletedQuestCount = 0;
+};
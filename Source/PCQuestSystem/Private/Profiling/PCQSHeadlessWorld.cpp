@@ -0,0 +1,51 @@
+// Copyright  Pedro Costa, 2021. All rights reserved
+
+#include "Profiling/PCQSHeadlessWorld.h"
+
+#if WITH_EDITOR
+
+#include "Actors/QuestManager.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+#include "UObject/UObjectGlobals.h"
+
+FPCQSHeadlessWorld::FPCQSHeadlessWorld()
+{
+    World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("PCQSHeadless"));
+    FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+    WorldContext.SetCurrentWorld(World);
+    World->InitializeActorsForPlay(FURL());
+    QuestManager = World->SpawnActor<AQuestManager>();
+}
+
+FPCQSHeadlessWorld::~FPCQSHeadlessWorld()
+{
+    GEngine->DestroyWorldContext(World);
+    World->DestroyWorld(false);
+    CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+}
+
+APlayerController* FPCQSHeadlessWorld::AddPlayer(int32 PlayerId)
+{
+    // There is no game mode to log the player in, so it gets its player state and slot here
+    APlayerController* PlayerController = World->SpawnActor<APlayerController>();
+    FActorSpawnParameters SpawnParameters;
+    SpawnParameters.Owner = PlayerController;
+    APlayerState* PlayerState = World->SpawnActor<APlayerState>(SpawnParameters);
+    if (PlayerId != INDEX_NONE)
+    {
+        PlayerState->SetPlayerId(PlayerId);
+    }
+    PlayerController->PlayerState = PlayerState;
+    QuestManager->AddPlayerSlot(PlayerState);
+    return PlayerController;
+}
+
+void FPCQSHeadlessWorld::Tick(float DeltaSeconds)
+{
+    World->Tick(LEVELTICK_All, DeltaSeconds);
+}
+
+#endif
@@ -0,0 +1,27 @@
+// Copyright  Pedro Costa, 2021. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class APlayerController;
+class AQuestManager;
+class UWorld;
+
+#if WITH_EDITOR
+
+/* Standalone game world with a quest manager and no map, for the profiling commandlets. Destroyed with the object */
+struct FPCQSHeadlessWorld
+{
+    FPCQSHeadlessWorld();
+    ~FPCQSHeadlessWorld();
+
+    /* A player controller with a player state and a quest manager player slot */
+    APlayerController* AddPlayer(int32 PlayerId = INDEX_NONE);
+    void Tick(float DeltaSeconds);
+
+    UWorld* World = nullptr;
+    AQuestManager* QuestManager = nullptr;
+};
+
+#endif
@@ -0,0 +1,108 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#include "CoreMinimal.h"
+#include "Actors/QuestManager.h"
+#include "Components/IconMarkerComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Markers/MarkerSubsystem.h"
+#include "PCQSBlueprintFunctionLibrary.h"
+#include "UI/IconMarkerUMG.h"
+#include "UObject/UObjectIterator.h"
+
+#if !UE_BUILD_SHIPPING
+
+namespace PCQSMemReport
+{
+    static double ToKB(SIZE_T Bytes)
+    {
+        return Bytes / 1024.0;
+    }
+
+    /* Object memory plus what it reports as its own resources, good enough to compare against a budget */
+    static SIZE_T GetObjectSize(const UObject* Object)
+    {
+        return Object->GetClass()->GetStructureSize() + Object->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+    }
+
+    template <typename ObjectType>
+    static SIZE_T GetWorldObjectsSize(const UWorld* World, int32& OutCount)
+    {
+        SIZE_T Size = 0;
+        OutCount = 0;
+        for (TObjectIterator<ObjectType> Iterator; Iterator; ++Iterator)
+        {
+            if (Iterator->GetWorld() == World)
+            {
+                Size += GetObjectSize(*Iterator);
+                ++OutCount;
+            }
+        }
+        return Size;
+    }
+
+    static void Run(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+    {
+        AQuestManager* QuestManager = World ? UPCQSBlueprintFunctionLibrary::GetWorldQuestManager(World) : nullptr;
+        if (!QuestManager)
+        {
+            return;
+        }
+
+        const int32 MaxQuests = Args.Num() > 0 ? FMath::Max(0, FCString::Atoi(*Args[0])) : 20;
+        FQuestMemoryUsage Usage;
+        QuestManager->GetMemoryUsage(Usage);
+        Usage.Quests.Sort([](const FQuestMemoryUsage::FQuestEntry& A, const FQuestMemoryUsage::FQuestEntry& B)
+        {
+            return A.DefinitionBytes + A.RuntimeBytes > B.DefinitionBytes + B.RuntimeBytes;
+        });
+
+        Ar.Logf(TEXT("Quest memory, the %d largest of %d quests:"), FMath::Min(MaxQuests, Usage.Quests.Num()), Usage.Quests.Num());
+        Ar.Logf(TEXT("%6s  %-32s %5s %6s %14s %14s %8s"), TEXT("ID"), TEXT("Name"), TEXT("Steps"), TEXT("Active"), TEXT("Definition KB"), TEXT("Runtime KB"), TEXT("Spawned"));
+        for (int32 QuestIndex = 0; QuestIndex < FMath::Min(MaxQuests, Usage.Quests.Num()); ++QuestIndex)
+        {
+            const FQuestMemoryUsage::FQuestEntry& Quest = Usage.Quests[QuestIndex];
+            Ar.Logf(TEXT("%6d  %-32.32s %5d %6s %14.2f %14.2f %8d"), Quest.QuestID, *Quest.Name, Quest.NumSteps, Quest.bActive ? TEXT("yes") : TEXT("no"),
+                ToKB(Quest.DefinitionBytes), ToKB(Quest.RuntimeBytes), Quest.NumSpawnedActors);
+        }
+
+        SIZE_T MarkerBytes = 0;
+        int32 NumMarkers = 0;
+        if (const UMarkerSubsystem* MarkerSubsystem = UMarkerSubsystem::Get(World))
+        {
+            MarkerBytes += MarkerSubsystem->GetAllocatedSize();
+            NumMarkers = MarkerSubsystem->GetNumMarkers();
+        }
+        int32 NumMarkerWidgets = 0;
+        int32 NumMarkerComponents = 0;
+        MarkerBytes += GetWorldObjectsSize<UIconMarkerUMG>(World, NumMarkerWidgets);
+        MarkerBytes += GetWorldObjectsSize<UIconMarkerComponent>(World, NumMarkerComponents);
+
+        SIZE_T SpawnedActorBytes = 0;
+        for (const AActor* SpawnedActor : Usage.SpawnedActors)
+        {
+            if (IsValid(SpawnedActor))
+            {
+                SpawnedActorBytes += GetObjectSize(SpawnedActor);
+                for (const UActorComponent* Component : SpawnedActor->GetComponents())
+                {
+                    SpawnedActorBytes += Component ? GetObjectSize(Component) : 0;
+                }
+            }
+        }
+
+        Ar.Logf(TEXT("Quest memory totals:"));
+        Ar.Logf(TEXT("  Definitions     %12.2f KB"), ToKB(Usage.DefinitionBytes));
+        Ar.Logf(TEXT("  Runtime state   %12.2f KB"), ToKB(Usage.RuntimeBytes));
+        Ar.Logf(TEXT("  Markers         %12.2f KB  (%d records, %d widgets, %d components)"), ToKB(MarkerBytes), NumMarkers, NumMarkerWidgets, NumMarkerComponents);
+        Ar.Logf(TEXT("  Spawned actors  %12.2f KB  (%d actors)"), ToKB(SpawnedActorBytes), Usage.SpawnedActors.Num());
+        Ar.Logf(TEXT("Allocator totals per category are in the PCQuestSystem LLM tags, run with -llm and use \"stat LLMFULL\"."));
+    }
+
+    static FAutoConsoleCommandWithWorldArgsAndOutputDevice MemReportCommand(
+        TEXT("pcqs.MemReport"),
+        TEXT("Prints the quest system memory per quest and per category (definitions, runtime state, markers, spawned actors). Optional argument: number of quests listed (default 20)."),
+        FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&Run));
+}
+
+#endif
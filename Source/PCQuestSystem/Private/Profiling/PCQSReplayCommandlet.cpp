@@ -0,0 +1,257 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#include "Profiling/PCQSReplayCommandlet.h"
+#include "Actors/QuestObjectiveTraits.h"
+#include "Dom/JsonObject.h"
+#include "Engine/DataTable.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "PCQuestSystem.h"
+#include "Profiling/PCQSHeadlessWorld.h"
+#include "Profiling/QuestEventCapture.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+// Commandlets run from UnrealEditor-Cmd, so none of this is built into games
+#if WITH_EDITOR
+
+namespace PCQSReplay
+{
+    static constexpr float FrameTime = 1.f / 60.f;
+
+    struct FEventTypeStats
+    {
+        int32 Count = 0;
+        double Seconds = 0.0;
+        double MaxSeconds = 0.0;
+    };
+
+    static void DispatchEvent(AQuestManager* QuestManager, const FQuestEvent& Event, APlayerController* PlayerController)
+    {
+        VisitCaptureTraits(Event.Type, [QuestManager, &Event, PlayerController](auto Traits)
+        {
+            decltype(Traits)::SendEvent(*QuestManager, Event.Tag, Event.Amount, PlayerController);
+        });
+        switch (Event.Type)
+        {
+        case EQuestEventType::ActivateQuest:
+            QuestManager->ActivateQuest(Event.QuestID, Event.StepID);
+            break;
+        case EQuestEventType::RemoveAllActiveQuests:
+            QuestManager->RemoveAllActiveQuests();
+            break;
+        default:
+            break;
+        }
+    }
+
+    static double Percentile(const TArray<float>& SortedValues, double Fraction)
+    {
+        if (SortedValues.Num() == 0)
+        {
+            return 0.0;
+        }
+        const int32 Index = FMath::Clamp(FMath::CeilToInt(Fraction * SortedValues.Num()) - 1, 0, SortedValues.Num() - 1);
+        return SortedValues[Index];
+    }
+}
+
+#endif
+
+UPCQSReplayCommandlet::UPCQSReplayCommandlet()
+{
+    IsClient = false;
+    IsEditor = false;
+    IsServer = true;
+    LogToConsole = true;
+}
+
+void UPCQSReplayCommandlet::OnReplayQuestCompleted(FQuest CompletedQuest)
+{
+    ++CompletedQuestCount;
+}
+
+int32 UPCQSReplayCommandlet::Main(const FString& Params)
+{
+#if !WITH_EDITOR
+    UE_LOG(LogPCQuestSystem, Error, TEXT("PCQSReplay only runs in editor builds"));
+    return 2;
+#else
+    using namespace PCQSReplay;
+
+    FString CapturePath;
+    if (!FParse::Value(*Params, TEXT("Capture="), CapturePath))
+    {
+        UE_LOG(LogPCQuestSystem, Error, TEXT("PCQSReplay needs -Capture=<file>"));
+        return 2;
+    }
+
+    FQuestEventCapture Capture;
+    if (!Capture.Load(CapturePath))
+    {
+        return 2;
+    }
+
+    FString QuestTablePath = Capture.QuestTablePath;
+    FParse::Value(*Params, TEXT("QuestTable="), QuestTablePath);
+    const UDataTable* QuestTable = QuestTablePath.IsEmpty() ? nullptr : LoadObject<UDataTable>(nullptr, *QuestTablePath);
+    if (!QuestTable)
+    {
+        UE_LOG(LogPCQuestSystem, Error, TEXT("PCQSReplay could not load the quest table '%s', pass it with -QuestTable=<asset path>"), *QuestTablePath);
+        return 2;
+    }
+
+    const bool bRealTime = FParse::Param(*Params, TEXT("RealTime"));
+    float Tolerance = 0.15f;
+    FParse::Value(*Params, TEXT("Tolerance="), Tolerance);
+    FString OutputPath = FPaths::ProjectSavedDir() / TEXT("Profiling") / (FPaths::GetBaseFilename(CapturePath) + TEXT("_Replay.json"));
+    FString BaselinePath;
+    FParse::Value(*Params, TEXT("Output="), OutputPath);
+    FParse::Value(*Params, TEXT("Baseline="), BaselinePath);
+
+    FPCQSHeadlessWorld HeadlessWorld;
+    AQuestManager* QuestManager = HeadlessWorld.QuestManager;
+    QuestManager->OnQuestCompletedDelegate.AddDynamic(this, &UPCQSReplayCommandlet::OnReplayQuestCompleted);
+    TArray<FQuest*> QuestRows;
+    QuestTable->GetAllRows(TEXT("PCQSReplay"), QuestRows);
+    QuestManager->LoadQuests(QuestRows);
+    QuestManager->RestoreCaptureSnapshot(Capture.Snapshot);
+
+    // One player controller for every player that shows up in the capture
+    TMap<int32, APlayerController*> PlayerControllers;
+    for (const FQuestEvent& Event : Capture.Events)
+    {
+        if (Event.PlayerId != INDEX_NONE && !PlayerControllers.Contains(Event.PlayerId))
+        {
+            PlayerControllers.Add(Event.PlayerId, HeadlessWorld.AddPlayer(Event.PlayerId));
+        }
+    }
+
+    TArray<float> DispatchMicroseconds;
+    DispatchMicroseconds.Reserve(Capture.Events.Num());
+    FEventTypeStats TypeStats[(int32)EQuestEventType::Count];
+    double DispatchSeconds = 0.0;
+    double NextTickTime = FrameTime;
+    int32 NumTicks = 0;
+    const double ReplayStart = FPlatformTime::Seconds();
+    for (const FQuestEvent& Event : Capture.Events)
+    {
+        if (bRealTime)
+        {
+            // Keep ticking at the frame rate while waiting for the event
+            for (double Now = FPlatformTime::Seconds() - ReplayStart; Now < Event.Time; Now = FPlatformTime::Seconds() - ReplayStart)
+            {
+                if (Now >= NextTickTime)
+                {
+                    HeadlessWorld.Tick(FrameTime);
+                    NextTickTime += FrameTime;
+                    ++NumTicks;
+                }
+                FPlatformProcess::Sleep((float)FMath::Max(FMath::Min(Event.Time, NextTickTime) - Now, 0.0));
+            }
+        }
+        else if (Event.Time >= NextTickTime)
+        {
+            // Idle gaps in the capture collapse into a single frame
+            HeadlessWorld.Tick(FrameTime);
+            NextTickTime = Event.Time + FrameTime;
+            ++NumTicks;
+        }
+
+        APlayerController* const* PlayerController = PlayerControllers.Find(Event.PlayerId);
+        const double DispatchStart = FPlatformTime::Seconds();
+        DispatchEvent(QuestManager, Event, PlayerController ? *PlayerController : nullptr);
+        const double EventSeconds = FPlatformTime::Seconds() - DispatchStart;
+
+        DispatchSeconds += EventSeconds;
+        DispatchMicroseconds.Add(EventSeconds * 1e6);
+        FEventTypeStats& Stats = TypeStats[(int32)Event.Type];
+        ++Stats.Count;
+        Stats.Seconds += EventSeconds;
+        Stats.MaxSeconds = FMath::Max(Stats.MaxSeconds, EventSeconds);
+    }
+    // Ends the frame of the last events, which is when their completions are broadcast
+    HeadlessWorld.Tick(FrameTime);
+    ++NumTicks;
+    const double WallSeconds = FPlatformTime::Seconds() - ReplayStart;
+
+    DispatchMicroseconds.Sort();
+    const double EventsPerSecond = DispatchSeconds > 0.0 ? Capture.Events.Num() / DispatchSeconds : 0.0;
+
+    TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+    Report->SetStringField(TEXT("capture"), CapturePath);
+    Report->SetStringField(TEXT("quest_table"), QuestTablePath);
+    Report->SetBoolField(TEXT("real_time"), bRealTime);
+    Report->SetNumberField(TEXT("players"), PlayerControllers.Num());
+    Report->SetNumberField(TEXT("events"), Capture.Events.Num());
+    Report->SetNumberField(TEXT("capture_seconds"), Capture.Events.Num() > 0 ? Capture.Events.Last().Time : 0.0);
+    Report->SetNumberField(TEXT("wall_seconds"), WallSeconds);
+    Report->SetNumberField(TEXT("ticks"), NumTicks);
+    Report->SetNumberField(TEXT("dispatch_seconds"), DispatchSeconds);
+    Report->SetNumberField(TEXT("events_per_second"), EventsPerSecond);
+    Report->SetNumberField(TEXT("dispatch_us_p50"), Percentile(DispatchMicroseconds, 0.5));
+    Report->SetNumberField(TEXT("dispatch_us_p99"), Percentile(DispatchMicroseconds, 0.99));
+    Report->SetNumberField(TEXT("dispatch_us_max"), Percentile(DispatchMicroseconds, 1.0));
+    Report->SetNumberField(TEXT("completed_quests"), CompletedQuestCount);
+
+    TSharedRef<FJsonObject> Types = MakeShared<FJsonObject>();
+    for (int32 TypeIndex = 0; TypeIndex < (int32)EQuestEventType::Count; ++TypeIndex)
+    {
+        const FEventTypeStats& Stats = TypeStats[TypeIndex];
+        if (Stats.Count == 0)
+        {
+            continue;
+        }
+        TSharedRef<FJsonObject> TypeObject = MakeShared<FJsonObject>();
+        TypeObject->SetNumberField(TEXT("count"), Stats.Count);
+        TypeObject->SetNumberField(TEXT("total_ms"), Stats.Seconds * 1000.0);
+        TypeObject->SetNumberField(TEXT("max_us"), Stats.MaxSeconds * 1e6);
+        Types->SetObjectField(LexToString((EQuestEventType)TypeIndex), TypeObject);
+        UE_LOG(LogPCQuestSystem, Display, TEXT("PCQSReplay %-24s %8d events %10.2f ms total %10.2f us max"),
+            LexToString((EQuestEventType)TypeIndex), Stats.Count, Stats.Seconds * 1000.0, Stats.MaxSeconds * 1e6);
+    }
+    Report->SetObjectField(TEXT("types"), Types);
+
+    UE_LOG(LogPCQuestSystem, Display, TEXT("PCQSReplay %d events from %d players in %.2f s: %.1f events/s, dispatch p50 %.2f us p99 %.2f us max %.2f us, %d quests completed"),
+        Capture.Events.Num(), PlayerControllers.Num(), WallSeconds, EventsPerSecond, Percentile(DispatchMicroseconds, 0.5),
+        Percentile(DispatchMicroseconds, 0.99), Percentile(DispatchMicroseconds, 1.0), CompletedQuestCount);
+
+    FString ReportString;
+    const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&ReportString);
+    FJsonSerializer::Serialize(Report, Writer);
+    if (!FFileHelper::SaveStringToFile(ReportString, *OutputPath))
+    {
+        UE_LOG(LogPCQuestSystem, Error, TEXT("PCQSReplay could not write %s"), *OutputPath);
+        return 2;
+    }
+    UE_LOG(LogPCQuestSystem, Display, TEXT("PCQSReplay results written to %s"), *OutputPath);
+
+    if (BaselinePath.IsEmpty())
+    {
+        return 0;
+    }
+
+    FString BaselineString;
+    TSharedPtr<FJsonObject> Baseline;
+    if (!FFileHelper::LoadFileToString(BaselineString, *BaselinePath) || !FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(BaselineString), Baseline) || !Baseline.IsValid())
+    {
+        UE_LOG(LogPCQuestSystem, Error, TEXT("PCQSReplay could not read baseline %s"), *BaselinePath);
+        return 2;
+    }
+
+    const double BaselineEventsPerSecond = Baseline->GetNumberField(TEXT("events_per_second"));
+    const double BaselineP99 = Baseline->GetNumberField(TEXT("dispatch_us_p99"));
+    UE_LOG(LogPCQuestSystem, Display, TEXT("PCQSReplay against baseline: %.1f -> %.1f events/s, p99 %.2f -> %.2f us"),
+        BaselineEventsPerSecond, EventsPerSecond, BaselineP99, Percentile(DispatchMicroseconds, 0.99));
+    if (EventsPerSecond < BaselineEventsPerSecond * (1.0 - Tolerance))
+    {
+        UE_LOG(LogPCQuestSystem, Error, TEXT("PCQSReplay regressed: events_per_second %.1f (baseline %.1f)"), EventsPerSecond, BaselineEventsPerSecond);
+        return 1;
+    }
+    return 0;
+#endif
+}
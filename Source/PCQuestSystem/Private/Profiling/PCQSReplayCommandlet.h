@@ -0,0 +1,37 @@
+// Copyright  Pedro Costa, 2021. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Actors/QuestManager.h"
+#include "Commandlets/Commandlet.h"
+#include "PCQSReplayCommandlet.generated.h"
+
+/**
+ * Plays a quest event capture (AQuestManager::StartEventCapture) back into a headless quest manager.
+ * Quests are loaded from the DataTable the captured manager used, unless -QuestTable overrides it,
+ * and put back in the state the capture started from (active quests, completed steps and counter progress).
+ * Runs at maximum speed by default, -RealTime keeps the captured timing. Every event dispatch is timed
+ * and the results go to a JSON file, which a later run can use as -Baseline for a before/after comparison.
+ *
+ * UnrealEditor-Cmd <Project> -run=PCQSReplay -Capture=<file> [-QuestTable=<asset path>] [-RealTime]
+ *     [-Output=<file>] [-Baseline=<file>] [-Tolerance=0.15]
+ *
+ * Returns 1 when the replay is slower than the baseline by more than the tolerance.
+ */
+UCLASS()
+class UPCQSReplayCommandlet : public UCommandlet
+{
+    GENERATED_BODY()
+
+public:
+    UPCQSReplayCommandlet();
+
+    virtual int32 Main(const FString& Params) override;
+
+private:
+    UFUNCTION()
+    void OnReplayQuestCompleted(FQuest CompletedQuest);
+
+    int32 CompletedQuestCount = 0;
+};
@@ -0,0 +1,508 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#include "Profiling/PCQSSoak.h"
+
+#if !UE_BUILD_SHIPPING
+
+#include "Actors/QuestManager.h"
+#include "Actors/QuestObjectiveTraits.h"
+#include "Containers/Ticker.h"
+#include "Dom/JsonObject.h"
+#include "Engine/ActorChannel.h"
+#include "Engine/Channel.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "PCQSBlueprintFunctionLibrary.h"
+#include "PCQuestSystem.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+namespace PCQSSoak
+{
+    /* Seconds between latency probes */
+    static constexpr double ProbeInterval = 0.1;
+
+    static TAutoConsoleVariable<int32> CVarSoakTrafficAccounting(
+        TEXT("pcqs.Soak.TrafficAccounting"),
+        1,
+        TEXT("1: while the soak records, the quest manager measures the bytes of its RPCs and replicated properties. 0 leaves its replication untouched."));
+
+    struct FSoakSettings
+    {
+        float EventsPerSecondPerPlayer = 10.f;
+        float Seconds = 120.f;
+        /* The server only starts recording once this many clients are connected */
+        int32 MinClients = 1;
+        int32 ActiveQuests = 8;
+        bool bExitWhenDone = false;
+    };
+
+    struct FTrafficStats
+    {
+        int64 Count = 0;
+        int64 Bits = 0;
+    };
+
+    struct FSoakState
+    {
+        TWeakObjectPtr<AQuestManager> QuestManager;
+        FSoakSettings Settings;
+        FTSTicker::FDelegateHandle TickerHandle;
+        bool bRecording = false;
+        double StartTime = 0.0;
+
+        // Bots, server only
+        FRandomStream Random{ 1337 };
+        /* Tags the quests listen to, one pool per objective type */
+        struct FEventTags
+        {
+            EQuestStepType StepType = EQuestStepType::None;
+            TArray<FGameplayTag> Tags;
+        };
+        TArray<FEventTags> EventTags;
+        double PendingEvents = 0.0;
+        double NextProbeTime = 0.0;
+        int32 NextQuestID = 1;
+        int64 EventsDispatched = 0;
+
+        // Traffic
+        TMap<FName, FTrafficStats> RemoteFunctions;
+        FTrafficStats InitialReplication;
+        FTrafficStats DeltaReplication;
+
+        // Reliable buffer of the quest manager channel, server only
+        int32 MaxClients = 0;
+        int32 MaxReliableOut = 0;
+        int64 ReliableSamples = 0;
+        int64 NearFullSamples = 0;
+        int64 NotNetReadySamples = 0;
+
+        // Client only
+        TArray<double> LatencyMilliseconds;
+    };
+
+    static FSoakState& GetState()
+    {
+        static FSoakState State;
+        return State;
+    }
+
+    static bool IsServer(const AQuestManager* QuestManager)
+    {
+        return QuestManager->GetNetMode() != NM_Client;
+    }
+
+    static FSoakSettings GetCommandLineSettings()
+    {
+        FSoakSettings Settings;
+        FParse::Value(FCommandLine::Get(), TEXT("PCQSSoakRate="), Settings.EventsPerSecondPerPlayer);
+        FParse::Value(FCommandLine::Get(), TEXT("PCQSSoakSeconds="), Settings.Seconds);
+        FParse::Value(FCommandLine::Get(), TEXT("PCQSSoakClients="), Settings.MinClients);
+        FParse::Value(FCommandLine::Get(), TEXT("PCQSSoakQuests="), Settings.ActiveQuests);
+        Settings.bExitWhenDone = FParse::Param(FCommandLine::Get(), TEXT("PCQSSoakExit"));
+        return Settings;
+    }
+
+    static void CollectEventTags(AQuestManager* QuestManager, FSoakState& State)
+    {
+        State.EventTags.Reset();
+        const TArray<FQuest> Quests = QuestManager->GetAllQuests();
+        ForEachObjectiveTraits([&Quests, &State](auto Traits)
+        {
+            using FTraits = decltype(Traits);
+            TArray<FGameplayTag> Tags;
+            for (const FQuest& Quest : Quests)
+            {
+                for (const TPair<int, typename FTraits::FObjective>& Objective : Quest.*FTraits::Rows)
+                {
+                    Objective.Value.GetEventTags(Tags);
+                }
+            }
+
+            FSoakState::FEventTags& Pool = State.EventTags.AddDefaulted_GetRef();
+            Pool.StepType = FTraits::StepType;
+            for (const FGameplayTag& Tag : Tags)
+            {
+                Pool.Tags.AddUnique(Tag);
+            }
+        });
+    }
+
+    /* Keeps the configured amount of quests active, cycling through all of them */
+    static void TopUpActiveQuests(AQuestManager* QuestManager, FSoakState& State)
+    {
+        const int32 NumQuests = QuestManager->GetNumQuests();
+        int32 NumActive = QuestManager->GetAllActiveQuestsInfo().Num();
+        for (int32 Attempt = 0; Attempt < NumQuests && NumActive < State.Settings.ActiveQuests; ++Attempt)
+        {
+            if (State.NextQuestID > NumQuests)
+            {
+                State.NextQuestID = 1;
+            }
+            QuestManager->ActivateQuest(State.NextQuestID++);
+            NumActive = QuestManager->GetAllActiveQuestsInfo().Num();
+        }
+    }
+
+    static void DispatchBotEvent(AQuestManager* QuestManager, APlayerController* PlayerController, FSoakState& State)
+    {
+        if (State.EventTags.Num() == 0)
+        {
+            return;
+        }
+        const FSoakState::FEventTags& Pool = State.EventTags[State.Random.RandHelper(State.EventTags.Num())];
+        if (Pool.Tags.Num() == 0)
+        {
+            return;
+        }
+
+        const FGameplayTag& Tag = Pool.Tags[State.Random.RandHelper(Pool.Tags.Num())];
+        VisitObjectiveTraits(Pool.StepType, [QuestManager, &Tag, PlayerController](auto Traits)
+        {
+            decltype(Traits)::SendEvent(*QuestManager, Tag, 1.f, PlayerController);
+        });
+        ++State.EventsDispatched;
+    }
+
+    static void DispatchBotEvents(AQuestManager* QuestManager, FSoakState& State, float DeltaTime)
+    {
+        TArray<APlayerController*, TInlineAllocator<16>> PlayerControllers;
+        for (FConstPlayerControllerIterator Iterator = QuestManager->GetWorld()->GetPlayerControllerIterator(); Iterator; ++Iterator)
+        {
+            if (APlayerController* PlayerController = Iterator->Get())
+            {
+                PlayerControllers.Add(PlayerController);
+            }
+        }
+        if (PlayerControllers.Num() == 0)
+        {
+            return;
+        }
+
+        State.PendingEvents += State.Settings.EventsPerSecondPerPlayer * PlayerControllers.Num() * DeltaTime;
+        while (State.PendingEvents >= 1.0)
+        {
+            State.PendingEvents -= 1.0;
+            DispatchBotEvent(QuestManager, PlayerControllers[State.Random.RandHelper(PlayerControllers.Num())], State);
+        }
+    }
+
+    static void SampleConnections(AQuestManager* QuestManager, FSoakState& State)
+    {
+        const UNetDriver* NetDriver = QuestManager->GetNetDriver();
+        if (!NetDriver)
+        {
+            return;
+        }
+
+        State.MaxClients = FMath::Max(State.MaxClients, NetDriver->ClientConnections.Num());
+        for (UNetConnection* Connection : NetDriver->ClientConnections)
+        {
+            const UActorChannel* Channel = Connection ? Connection->FindActorChannelRef(QuestManager) : nullptr;
+            if (!Channel)
+            {
+                continue;
+            }
+
+            ++State.ReliableSamples;
+            State.MaxReliableOut = FMath::Max(State.MaxReliableOut, Channel->NumOutRec);
+            if (Channel->NumOutRec >= RELIABLE_BUFFER * 3 / 4)
+            {
+                ++State.NearFullSamples;
+            }
+            if (!Connection->IsNetReady(false))
+            {
+                ++State.NotNetReadySamples;
+            }
+        }
+    }
+
+    static TSharedRef<FJsonObject> MakeTrafficObject(const FTrafficStats& Stats, double Seconds)
+    {
+        TSharedRef<FJsonObject> Object = MakeShared<FJsonObject>();
+        Object->SetNumberField(TEXT("count"), (double)Stats.Count);
+        Object->SetNumberField(TEXT("bytes"), Stats.Bits / 8.0);
+        Object->SetNumberField(TEXT("bytes_per_second"), Seconds > 0.0 ? Stats.Bits / 8.0 / Seconds : 0.0);
+        Object->SetNumberField(TEXT("average_bytes"), Stats.Count > 0 ? Stats.Bits / 8.0 / Stats.Count : 0.0);
+        return Object;
+    }
+
+    static double Percentile(const TArray<double>& SortedValues, double Fraction)
+    {
+        if (SortedValues.Num() == 0)
+        {
+            return 0.0;
+        }
+        const int32 Index = FMath::Clamp(FMath::CeilToInt(Fraction * SortedValues.Num()) - 1, 0, SortedValues.Num() - 1);
+        return SortedValues[Index];
+    }
+
+    static void WriteReport(const FSoakState& State, bool bServer)
+    {
+        const double Seconds = FPlatformTime::Seconds() - State.StartTime;
+        const TCHAR* Role = bServer ? TEXT("Server") : TEXT("Client");
+
+        TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+        Report->SetStringField(TEXT("role"), Role);
+        Report->SetNumberField(TEXT("seconds"), Seconds);
+
+        TSharedRef<FJsonObject> RemoteFunctions = MakeShared<FJsonObject>();
+        for (const TPair<FName, FTrafficStats>& RemoteFunction : State.RemoteFunctions)
+        {
+            RemoteFunctions->SetObjectField(RemoteFunction.Key.ToString(), MakeTrafficObject(RemoteFunction.Value, Seconds));
+            UE_LOG(LogPCQuestSystem, Display, TEXT("PCQSSoak %s RPC %-32s %8lld calls %10.1f bytes/s %8.1f bytes/call"), Role, *RemoteFunction.Key.ToString(),
+                RemoteFunction.Value.Count, RemoteFunction.Value.Bits / 8.0 / FMath::Max(Seconds, UE_SMALL_NUMBER), RemoteFunction.Value.Bits / 8.0 / FMath::Max<int64>(RemoteFunction.Value.Count, 1));
+        }
+        Report->SetObjectField(TEXT("rpcs"), RemoteFunctions);
+
+        // ActiveQuests and CompletedQuests are COND_InitialOnly. After the initial bunch what replicates is SpawnedStepActors, PlayerSlots and StepPlayerMasks
+        TSharedRef<FJsonObject> Replication = MakeShared<FJsonObject>();
+        Replication->SetObjectField(TEXT("initial"), MakeTrafficObject(State.InitialReplication, Seconds));
+        Replication->SetObjectField(TEXT("delta"), MakeTrafficObject(State.DeltaReplication, Seconds));
+        Report->SetObjectField(TEXT("replication"), Replication);
+        UE_LOG(LogPCQuestSystem, Display, TEXT("PCQSSoak %s replication: initial %lld bunches %.1f bytes, delta %lld bunches %.1f bytes/s"), Role,
+            State.InitialReplication.Count, State.InitialReplication.Bits / 8.0, State.DeltaReplication.Count, State.DeltaReplication.Bits / 8.0 / FMath::Max(Seconds, UE_SMALL_NUMBER));
+
+        if (bServer)
+        {
+            Report->SetNumberField(TEXT("clients"), State.MaxClients);
+            Report->SetNumberField(TEXT("events"), (double)State.EventsDispatched);
+            Report->SetNumberField(TEXT("events_per_second"), Seconds > 0.0 ? State.EventsDispatched / Seconds : 0.0);
+
+            TSharedRef<FJsonObject> ReliableBuffer = MakeShared<FJsonObject>();
+            ReliableBuffer->SetNumberField(TEXT("limit"), RELIABLE_BUFFER);
+            ReliableBuffer->SetNumberField(TEXT("max_out"), State.MaxReliableOut);
+            ReliableBuffer->SetNumberField(TEXT("samples"), (double)State.ReliableSamples);
+            ReliableBuffer->SetNumberField(TEXT("near_full_samples"), (double)State.NearFullSamples);
+            ReliableBuffer->SetNumberField(TEXT("not_net_ready_samples"), (double)State.NotNetReadySamples);
+            Report->SetObjectField(TEXT("reliable_buffer"), ReliableBuffer);
+            UE_LOG(LogPCQuestSystem, Display, TEXT("PCQSSoak Server: %d clients, %.1f events/s, reliable buffer max %d/%d, %lld of %lld samples near full, %lld saturated"),
+                State.MaxClients, Seconds > 0.0 ? State.EventsDispatched / Seconds : 0.0, State.MaxReliableOut, RELIABLE_BUFFER,
+                State.NearFullSamples, State.ReliableSamples, State.NotNetReadySamples);
+        }
+        else
+        {
+            TArray<double> SortedLatency = State.LatencyMilliseconds;
+            SortedLatency.Sort();
+            TSharedRef<FJsonObject> Latency = MakeShared<FJsonObject>();
+            Latency->SetNumberField(TEXT("samples"), SortedLatency.Num());
+            Latency->SetNumberField(TEXT("p50"), Percentile(SortedLatency, 0.5));
+            Latency->SetNumberField(TEXT("p95"), Percentile(SortedLatency, 0.95));
+            Latency->SetNumberField(TEXT("max"), Percentile(SortedLatency, 1.0));
+            Report->SetObjectField(TEXT("latency_ms"), Latency);
+            UE_LOG(LogPCQuestSystem, Display, TEXT("PCQSSoak Client: event to client latency p50 %.2f ms p95 %.2f ms max %.2f ms over %d probes"),
+                Percentile(SortedLatency, 0.5), Percentile(SortedLatency, 0.95), Percentile(SortedLatency, 1.0), SortedLatency.Num());
+        }
+
+        FString ReportString;
+        const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&ReportString);
+        FJsonSerializer::Serialize(Report, Writer);
+        const FString OutputPath = FPaths::ProjectSavedDir() / TEXT("Profiling") / FString::Printf(TEXT("PCQSSoak_%s_%u.json"), Role, FPlatformProcess::GetCurrentProcessId());
+        if (FFileHelper::SaveStringToFile(ReportString, *OutputPath))
+        {
+            UE_LOG(LogPCQuestSystem, Display, TEXT("PCQSSoak report written to %s"), *OutputPath);
+        }
+        else
+        {
+            UE_LOG(LogPCQuestSystem, Error, TEXT("PCQSSoak could not write %s"), *OutputPath);
+        }
+    }
+
+    static void Stop()
+    {
+        FSoakState& State = GetState();
+        if (State.TickerHandle.IsValid())
+        {
+            FTSTicker::GetCoreTicker().RemoveTicker(State.TickerHandle);
+        }
+
+        AQuestManager* QuestManager = State.QuestManager.Get();
+        if (State.bRecording)
+        {
+            WriteReport(State, QuestManager ? IsServer(QuestManager) : false);
+        }
+
+        const bool bExitWhenDone = State.Settings.bExitWhenDone;
+        State = FSoakState();
+        if (bExitWhenDone)
+        {
+            FPlatformMisc::RequestExit(false);
+        }
+    }
+
+    static bool Tick(float DeltaTime)
+    {
+        FSoakState& State = GetState();
+        AQuestManager* QuestManager = State.QuestManager.Get();
+        if (!QuestManager)
+        {
+            Stop();
+            return false;
+        }
+
+        const bool bServer = IsServer(QuestManager);
+        if (!State.bRecording)
+        {
+            const UNetDriver* NetDriver = QuestManager->GetNetDriver();
+            if (bServer && (!NetDriver || NetDriver->ClientConnections.Num() < State.Settings.MinClients))
+            {
+                return true;
+            }
+            State.bRecording = true;
+            State.StartTime = FPlatformTime::Seconds();
+            UE_LOG(LogPCQuestSystem, Display, TEXT("PCQSSoak recording for %.0f seconds"), State.Settings.Seconds);
+        }
+
+        const double Now = FPlatformTime::Seconds();
+        if (Now - State.StartTime >= State.Settings.Seconds)
+        {
+            Stop();
+            return false;
+        }
+
+        if (bServer)
+        {
+            TopUpActiveQuests(QuestManager, State);
+            DispatchBotEvents(QuestManager, State, DeltaTime);
+            SampleConnections(QuestManager, State);
+
+            // Sent after the events on the same reliable channel, so it arrives after their multicasts
+            if (Now >= State.NextProbeTime)
+            {
+                State.NextProbeTime = Now + ProbeInterval;
+                QuestManager->SoakLatencyProbe(Now);
+            }
+        }
+        return true;
+    }
+
+    static void Start(AQuestManager* QuestManager, const FSoakSettings& Settings)
+    {
+        if (GetState().QuestManager.IsValid())
+        {
+            UE_LOG(LogPCQuestSystem, Warning, TEXT("PCQSSoak is already running."));
+            return;
+        }
+
+        FSoakState& State = GetState();
+        State.QuestManager = QuestManager;
+        State.Settings = Settings;
+        if (IsServer(QuestManager))
+        {
+            CollectEventTags(QuestManager, State);
+        }
+        State.TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&Tick));
+    }
+
+    bool IsRecording()
+    {
+        return GetState().bRecording;
+    }
+
+    bool IsAccountingTraffic()
+    {
+        return IsRecording() && CVarSoakTrafficAccounting.GetValueOnGameThread() != 0;
+    }
+
+    void OnQuestManagerBeginPlay(AQuestManager* QuestManager)
+    {
+        if (FParse::Param(FCommandLine::Get(), TEXT("PCQSSoak")))
+        {
+            Start(QuestManager, GetCommandLineSettings());
+        }
+    }
+
+    void OnQuestManagerEndPlay(AQuestManager* QuestManager)
+    {
+        if (GetState().QuestManager == QuestManager)
+        {
+            Stop();
+        }
+    }
+
+    int64 GetSentBits(const AActor* Actor)
+    {
+        const UNetDriver* NetDriver = Actor->GetNetDriver();
+        if (!NetDriver)
+        {
+            return 0;
+        }
+
+        // OutBytes holds what was flushed this stat period and SendBuffer what is still waiting for the next packet
+        int64 SentBits = 0;
+        for (const UNetConnection* Connection : NetDriver->ClientConnections)
+        {
+            SentBits += int64(Connection->OutBytes) * 8 + Connection->SendBuffer.GetNumBits();
+        }
+        if (const UNetConnection* ServerConnection = NetDriver->ServerConnection)
+        {
+            SentBits += int64(ServerConnection->OutBytes) * 8 + ServerConnection->SendBuffer.GetNumBits();
+        }
+        return SentBits;
+    }
+
+    void RecordRemoteFunction(const UFunction* Function, int64 SentBits)
+    {
+        FTrafficStats& Stats = GetState().RemoteFunctions.FindOrAdd(Function->GetFName());
+        ++Stats.Count;
+        Stats.Bits += FMath::Max<int64>(SentBits, 0);
+    }
+
+    void RecordReplication(bool bInitial, int64 SentBits)
+    {
+        FSoakState& State = GetState();
+        FTrafficStats& Stats = bInitial ? State.InitialReplication : State.DeltaReplication;
+        ++Stats.Count;
+        Stats.Bits += SentBits;
+    }
+
+    void RecordLatencyProbe(double SentTime)
+    {
+        if (IsRecording())
+        {
+            GetState().LatencyMilliseconds.Add((FPlatformTime::Seconds() - SentTime) * 1000.0);
+        }
+    }
+
+    static void StartCommand(const TArray<FString>& Args, UWorld* World)
+    {
+        AQuestManager* QuestManager = World ? UPCQSBlueprintFunctionLibrary::GetWorldQuestManager(World) : nullptr;
+        if (!QuestManager)
+        {
+            return;
+        }
+
+        FSoakSettings Settings = GetCommandLineSettings();
+        Settings.MinClients = 0;
+        Settings.bExitWhenDone = false;
+        if (Args.Num() > 0)
+        {
+            Settings.EventsPerSecondPerPlayer = FCString::Atof(*Args[0]);
+        }
+        if (Args.Num() > 1)
+        {
+            Settings.Seconds = FCString::Atof(*Args[1]);
+        }
+        Start(QuestManager, Settings);
+    }
+
+    static FAutoConsoleCommandWithWorldAndArgs SoakStartCommand(
+        TEXT("pcqs.Soak.Start"),
+        TEXT("Starts the quest network soak. On the server bots send quest events for every player. Args: [EventsPerSecondPerPlayer] [Seconds]"),
+        FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StartCommand));
+
+    static FAutoConsoleCommand SoakStopCommand(
+        TEXT("pcqs.Soak.Stop"),
+        TEXT("Stops the quest network soak and writes its report."),
+        FConsoleCommandDelegate::CreateStatic(&Stop));
+}
+
+#endif
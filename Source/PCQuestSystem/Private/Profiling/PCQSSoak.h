@@ -0,0 +1,45 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AActor;
+class AQuestManager;
+class UFunction;
+
+#if !UE_BUILD_SHIPPING
+
+/**
+ * Network soak of the quest system, meant for a dedicated server and headless clients on loopback (Scripts/RunSoak.sh).
+ * The server drives bots that send random goto, talk, kill, gather and catch events for every player and keeps quests active.
+ * While recording it accounts the bytes sent by every quest manager RPC and by its replicated properties (pcqs.Soak.TrafficAccounting).
+ * RPC bytes are the growth of the connections' send buffers across the call. Property bytes are an estimate, the size of the manager's bunch
+ * when the generic replication path reaches ReplicateSubobjects, header included. Iris does not go through it, so there are none with Iris.
+ * It also samples the reliable buffer of the quest manager channel on every connection and sends a latency probe
+ * through the same reliable channel so clients can measure event to client latency.
+ * Latency uses FPlatformTime on both ends, so it is only valid with all processes on the same machine.
+ *
+ * pcqs.Soak.Start [EventsPerSecondPerPlayer] [Seconds], pcqs.Soak.Stop
+ * -PCQSSoak [-PCQSSoakRate=10] [-PCQSSoakSeconds=120] [-PCQSSoakClients=1] [-PCQSSoakQuests=8] [-PCQSSoakExit]
+ *
+ * Reports are written to Saved/Profiling/PCQSSoak_<Role>_<ProcessId>.json.
+ */
+namespace PCQSSoak
+{
+    bool IsRecording();
+    /* Recording with pcqs.Soak.TrafficAccounting on, what the quest manager's traffic hooks check */
+    bool IsAccountingTraffic();
+
+    /* Starts the soak when the command line asks for it, stops it and writes the report when the manager goes away */
+    void OnQuestManagerBeginPlay(AQuestManager* QuestManager);
+    void OnQuestManagerEndPlay(AQuestManager* QuestManager);
+
+    /* Bits queued so far on the connections the actor replicates through */
+    int64 GetSentBits(const AActor* Actor);
+    void RecordRemoteFunction(const UFunction* Function, int64 SentBits);
+    void RecordReplication(bool bInitial, int64 SentBits);
+    void RecordLatencyProbe(double SentTime);
+}
+
+#endif
@@ -0,0 +1,275 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#include "Profiling/QuestEventCapture.h"
+#include "Actors/QuestManager.h"
+#include "Actors/QuestObjectiveTraits.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/Paths.h"
+#include "PCQSBlueprintFunctionLibrary.h"
+#include "PCQuestSystem.h"
+
+namespace QuestEventCapture
+{
+    static constexpr uint32 Magic = 0x45514350; // PCQE
+    static constexpr uint32 Version = 2;
+    /* Seconds between flushes, so a crash loses at most this much of the capture */
+    static constexpr double FlushInterval = 1.0;
+
+    static bool HasTag(EQuestEventType Type)
+    {
+        return Type <= EQuestEventType::Catch;
+    }
+
+    static void StartCapture(const TArray<FString>& Args, UWorld* World)
+    {
+        AQuestManager* QuestManager = World ? UPCQSBlueprintFunctionLibrary::GetWorldQuestManager(World) : nullptr;
+        if (!QuestManager)
+        {
+            return;
+        }
+
+        const FString Path = Args.Num() > 0 ? Args[0] : FPaths::ProjectSavedDir() / TEXT("Profiling") / FString::Printf(TEXT("PCQSCapture_%s.pcqe"), *FDateTime::Now().ToString());
+        if (QuestManager->StartEventCapture(Path))
+        {
+            UE_LOG(LogPCQuestSystem, Display, TEXT("Capturing quest events to %s"), *Path);
+        }
+    }
+
+    static void StopCapture(const TArray<FString>& Args, UWorld* World)
+    {
+        if (AQuestManager* QuestManager = World ? UPCQSBlueprintFunctionLibrary::GetWorldQuestManager(World) : nullptr)
+        {
+            QuestManager->StopEventCapture();
+        }
+    }
+
+    static FAutoConsoleCommandWithWorldAndArgs StartCaptureCommand(
+        TEXT("pcqs.Capture.Start"),
+        TEXT("Server only. Captures every inbound quest event for replay with -run=PCQSReplay. Optional argument: capture file."),
+        FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StartCapture));
+
+    static FAutoConsoleCommandWithWorldAndArgs StopCaptureCommand(
+        TEXT("pcqs.Capture.Stop"),
+        TEXT("Stops the quest event capture."),
+        FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StopCapture));
+}
+
+const TCHAR* LexToString(EQuestEventType Type)
+{
+    const TCHAR* Name = TEXT("Unknown");
+    VisitCaptureTraits(Type, [&Name](auto Traits) { Name = decltype(Traits)::CaptureName; });
+    switch (Type)
+    {
+    case EQuestEventType::ActivateQuest: return TEXT("ActivateQuest");
+    case EQuestEventType::RemoveAllActiveQuests: return TEXT("RemoveAllActiveQuests");
+    default: return Name;
+    }
+}
+
+FArchive& operator<<(FArchive& Ar, FQuestCaptureSnapshot& Snapshot)
+{
+    Ar << Snapshot.CompletedQuests;
+
+    int32 NumActiveQuests = Snapshot.ActiveQuests.Num();
+    Ar << NumActiveQuests;
+    if (Ar.IsLoading())
+    {
+        Snapshot.ActiveQuests.SetNum(FMath::Max(NumActiveQuests, 0));
+    }
+    for (FQuestCaptureSnapshot::FQuestState& Quest : Snapshot.ActiveQuests)
+    {
+        Ar << Quest.QuestID << Quest.CurrentStepID << Quest.bCurrentActive << Quest.CompletedSteps;
+    }
+
+    int32 NumStepProgress = Snapshot.StepProgress.Num();
+    Ar << NumStepProgress;
+    if (Ar.IsLoading())
+    {
+        Snapshot.StepProgress.SetNum(FMath::Max(NumStepProgress, 0));
+    }
+    for (FQuestCaptureSnapshot::FStepProgress& Step : Snapshot.StepProgress)
+    {
+        Ar << Step.QuestID << Step.StepID << Step.Progress;
+    }
+    return Ar;
+}
+
+TUniquePtr<FQuestEventCaptureWriter> FQuestEventCaptureWriter::Create(const FString& Path, const FString& QuestTablePath, FQuestCaptureSnapshot& Snapshot)
+{
+    TUniquePtr<FArchive> Archive(IFileManager::Get().CreateFileWriter(*Path));
+    if (!Archive)
+    {
+        UE_LOG(LogPCQuestSystem, Error, TEXT("Could not create quest event capture %s"), *Path);
+        return nullptr;
+    }
+
+    uint32 Magic = QuestEventCapture::Magic;
+    uint32 Version = QuestEventCapture::Version;
+    FString TablePath = QuestTablePath;
+    int64 StartTicks = FDateTime::UtcNow().GetTicks();
+    *Archive << Magic << Version << TablePath << StartTicks << Snapshot;
+    return TUniquePtr<FQuestEventCaptureWriter>(new FQuestEventCaptureWriter(Path, MoveTemp(Archive)));
+}
+
+FQuestEventCaptureWriter::FQuestEventCaptureWriter(const FString& InPath, TUniquePtr<FArchive>&& InArchive)
+    : Path(InPath),
+    Archive(MoveTemp(InArchive)),
+    StartTime(FPlatformTime::Seconds())
+{
+    LastEventTime = StartTime;
+    LastFlushTime = StartTime;
+}
+
+FQuestEventCaptureWriter::~FQuestEventCaptureWriter()
+{
+    Archive->Close();
+    UE_LOG(LogPCQuestSystem, Display, TEXT("Quest event capture %s closed with %lld events"), *Path, NumEvents);
+}
+
+void FQuestEventCaptureWriter::Record(EQuestEventType Type, const APlayerController* Player, FGameplayTag Tag, float Amount, int32 QuestID, int32 StepID)
+{
+    const double Now = FPlatformTime::Seconds();
+    uint64 DeltaMicroseconds = (uint64)((Now - LastEventTime) * 1e6);
+    LastEventTime += DeltaMicroseconds / 1e6;
+
+    const APlayerState* PlayerState = Player ? Player->PlayerState.Get() : nullptr;
+    // Stored plus one so a missing player is 0
+    uint32 PackedPlayerId = PlayerState ? (uint32)(PlayerState->GetPlayerId() + 1) : 0;
+
+    uint8 TypeValue = (uint8)Type;
+    *Archive << TypeValue;
+    Archive->SerializeIntPacked64(DeltaMicroseconds);
+    Archive->SerializeIntPacked(PackedPlayerId);
+
+    if (QuestEventCapture::HasTag(Type))
+    {
+        const FName TagName = Tag.GetTagName();
+        if (const uint32* TagIndex = TagIndices.Find(TagName))
+        {
+            uint32 Index = *TagIndex;
+            Archive->SerializeIntPacked(Index);
+        }
+        else
+        {
+            // A new index is followed by the tag name
+            uint32 Index = TagIndices.Add(TagName, TagIndices.Num());
+            FString TagString = TagName.ToString();
+            Archive->SerializeIntPacked(Index);
+            *Archive << TagString;
+        }
+    }
+
+    if (Type == EQuestEventType::ItemGathered)
+    {
+        *Archive << Amount;
+    }
+    else if (Type == EQuestEventType::ActivateQuest)
+    {
+        uint32 PackedQuestID = (uint32)QuestID;
+        uint32 PackedStepID = (uint32)StepID;
+        Archive->SerializeIntPacked(PackedQuestID);
+        Archive->SerializeIntPacked(PackedStepID);
+    }
+
+    ++NumEvents;
+    if (Now - LastFlushTime >= QuestEventCapture::FlushInterval)
+    {
+        LastFlushTime = Now;
+        Archive->Flush();
+    }
+}
+
+bool FQuestEventCapture::Load(const FString& Path)
+{
+    TUniquePtr<FArchive> Archive(IFileManager::Get().CreateFileReader(*Path));
+    if (!Archive)
+    {
+        UE_LOG(LogPCQuestSystem, Error, TEXT("Could not open quest event capture %s"), *Path);
+        return false;
+    }
+
+    uint32 Magic = 0;
+    uint32 Version = 0;
+    int64 StartTicks = 0;
+    *Archive << Magic << Version;
+    if (Magic != QuestEventCapture::Magic || Version != QuestEventCapture::Version)
+    {
+        UE_LOG(LogPCQuestSystem, Error, TEXT("%s is not a quest event capture of version %u"), *Path, QuestEventCapture::Version);
+        return false;
+    }
+    *Archive << QuestTablePath << StartTicks << Snapshot;
+    StartTime = FDateTime(StartTicks);
+    if (Archive->IsError())
+    {
+        UE_LOG(LogPCQuestSystem, Error, TEXT("Quest event capture %s has a broken header"), *Path);
+        return false;
+    }
+
+    TArray<FGameplayTag> Tags;
+    double Time = 0.0;
+    Events.Reset();
+    while (!Archive->AtEnd() && !Archive->IsError())
+    {
+        FQuestEvent& Event = Events.AddDefaulted_GetRef();
+        uint8 TypeValue = 0;
+        uint64 DeltaMicroseconds = 0;
+        uint32 PackedPlayerId = 0;
+        *Archive << TypeValue;
+        Archive->SerializeIntPacked64(DeltaMicroseconds);
+        Archive->SerializeIntPacked(PackedPlayerId);
+
+        Time += DeltaMicroseconds / 1e6;
+        Event.Time = Time;
+        Event.Type = (EQuestEventType)FMath::Min<uint8>(TypeValue, (uint8)EQuestEventType::Count);
+        Event.PlayerId = (int32)PackedPlayerId - 1;
+
+        if (QuestEventCapture::HasTag(Event.Type))
+        {
+            uint32 TagIndex = 0;
+            Archive->SerializeIntPacked(TagIndex);
+            if (TagIndex == (uint32)Tags.Num())
+            {
+                FString TagString;
+                *Archive << TagString;
+                Tags.Add(FGameplayTag::RequestGameplayTag(FName(*TagString), false));
+            }
+            if (!Tags.IsValidIndex(TagIndex))
+            {
+                Archive->SetError();
+                break;
+            }
+            Event.Tag = Tags[TagIndex];
+        }
+
+        if (Event.Type == EQuestEventType::ItemGathered)
+        {
+            *Archive << Event.Amount;
+        }
+        else if (Event.Type == EQuestEventType::ActivateQuest)
+        {
+            uint32 PackedQuestID = 0;
+            uint32 PackedStepID = 0;
+            Archive->SerializeIntPacked(PackedQuestID);
+            Archive->SerializeIntPacked(PackedStepID);
+            Event.QuestID = (int32)PackedQuestID;
+            Event.StepID = (int32)PackedStepID;
+        }
+        else if (Event.Type == EQuestEventType::Count)
+        {
+            Archive->SetError();
+        }
+    }
+
+    // A capture cut short by a crash still replays up to its last complete event
+    if (Archive->IsError())
+    {
+        Events.Pop();
+        UE_LOG(LogPCQuestSystem, Warning, TEXT("Quest event capture %s is truncated, loaded %d events"), *Path, Events.Num());
+    }
+    return true;
+}
@@ -0,0 +1,103 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameplayTagContainer.h"
+
+class APlayerController;
+
+/* Inbound quest manager calls that can be captured */
+enum class EQuestEventType : uint8
+{
+    ArrivedToPlace,
+    EntityTalkedTo,
+    EntityKilled,
+    ItemGathered,
+    Catch,
+    ActivateQuest,
+    RemoveAllActiveQuests,
+    Count
+};
+
+const TCHAR* LexToString(EQuestEventType Type);
+
+struct FQuestEvent
+{
+    /* Seconds since the capture started */
+    double Time = 0.0;
+    EQuestEventType Type = EQuestEventType::ArrivedToPlace;
+    /* PlayerState id of the player that caused the event, INDEX_NONE when there was none */
+    int32 PlayerId = INDEX_NONE;
+    FGameplayTag Tag;
+    float Amount = 0.f;
+    int32 QuestID = 0;
+    int32 StepID = 0;
+};
+
+/* Quest manager state when a capture starts, so a capture taken mid-session replays from where it began */
+struct FQuestCaptureSnapshot
+{
+    struct FQuestState
+    {
+        int32 QuestID = -1;
+        int32 CurrentStepID = -1;
+        bool bCurrentActive = false;
+        TArray<int32> CompletedSteps;
+    };
+
+    /* Counter progress of an active kill, gather or catch step */
+    struct FStepProgress
+    {
+        int32 QuestID = -1;
+        int32 StepID = -1;
+        float Progress = 0.f;
+    };
+
+    TArray<int32> CompletedQuests;
+    TArray<FQuestState> ActiveQuests;
+    TArray<FStepProgress> StepProgress;
+
+    friend FArchive& operator<<(FArchive& Ar, FQuestCaptureSnapshot& Snapshot);
+};
+
+/**
+ * Streams quest events to a capture file as they happen.
+ * Events are written with microsecond time deltas and packed integers, and every tag name is written once
+ * and referenced by index afterwards, so a capture is a few bytes per event.
+ */
+class FQuestEventCaptureWriter
+{
+public:
+    /* Returns null when the file can't be created */
+    static TUniquePtr<FQuestEventCaptureWriter> Create(const FString& Path, const FString& QuestTablePath, FQuestCaptureSnapshot& Snapshot);
+    ~FQuestEventCaptureWriter();
+
+    void Record(EQuestEventType Type, const APlayerController* Player, FGameplayTag Tag = FGameplayTag(), float Amount = 0.f, int32 QuestID = 0, int32 StepID = 0);
+
+    const FString& GetPath() const { return Path; }
+    int64 GetNumEvents() const { return NumEvents; }
+
+private:
+    FQuestEventCaptureWriter(const FString& InPath, TUniquePtr<FArchive>&& InArchive);
+
+    FString Path;
+    TUniquePtr<FArchive> Archive;
+    TMap<FName, uint32> TagIndices;
+    double StartTime = 0.0;
+    double LastEventTime = 0.0;
+    double LastFlushTime = 0.0;
+    int64 NumEvents = 0;
+};
+
+/* A capture file loaded back into memory */
+struct FQuestEventCapture
+{
+    /* Quest DataTable of the manager that was captured, replays load the same quests from it */
+    FString QuestTablePath;
+    FDateTime StartTime;
+    FQuestCaptureSnapshot Snapshot;
+    TArray<FQuestEvent> Events;
+
+    bool Load(const FString& Path);
+};
@@ -0,0 +1,242 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#include "Regions/QuestRegionSubsystem.h"
+#include "Components/QuestComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "PCQuestSystemStats.h"
+
+DECLARE_CYCLE_STAT(TEXT("Region Sampling"), STAT_PCQS_RegionSampling, STATGROUP_PCQuestSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Region Tests"), STAT_PCQS_RegionTests, STATGROUP_PCQuestSystem);
+
+static TAutoConsoleVariable<float> CVarRegionSampleInterval(
+    TEXT("pcqs.Regions.SampleInterval"),
+    0.1f,
+    TEXT("Seconds between samples of the player positions against the quest regions. 0 samples every frame."));
+
+static TAutoConsoleVariable<float> CVarRegionExitMargin(
+    TEXT("pcqs.Regions.ExitMargin"),
+    50.f,
+    TEXT("Distance a pawn has to move past a region border before it counts as having left it."));
+
+/* Grid cell size for the regions, big regions just cover more cells */
+static constexpr float RegionCellSize = 10000.f;
+
+bool FQuestRegion::IsInside(const FVector& Point, float Margin) const
+{
+    const FVector Relative = Point - Center;
+    if (Shape == EQuestRegionShape::Sphere)
+    {
+        return Relative.SizeSquared() <= FMath::Square(Extent.X + Margin);
+    }
+
+    const FVector Local = InverseRotation.RotateVector(Relative);
+    return FMath::Abs(Local.X) <= Extent.X + Margin
+        && FMath::Abs(Local.Y) <= Extent.Y + Margin
+        && FMath::Abs(Local.Z) <= Extent.Z + Margin;
+}
+
+UQuestRegionSubsystem* UQuestRegionSubsystem::Get(const UObject* WorldContext)
+{
+    const UWorld* World = WorldContext ? WorldContext->GetWorld() : nullptr;
+    return World ? World->GetSubsystem<UQuestRegionSubsystem>() : nullptr;
+}
+
+void UQuestRegionSubsystem::Deinitialize()
+{
+    Regions.Empty();
+    RegionCells.Empty();
+    PlayerStates.Empty();
+
+    Super::Deinitialize();
+}
+
+void UQuestRegionSubsystem::Tick(float DeltaTime)
+{
+    Super::Tick(DeltaTime);
+
+    if (Regions.Num() == 0)
+    {
+        return;
+    }
+
+    TimeSinceSample += DeltaTime;
+    if (TimeSinceSample >= CVarRegionSampleInterval.GetValueOnGameThread())
+    {
+        TimeSinceSample = 0.f;
+        SamplePlayers();
+    }
+}
+
+TStatId UQuestRegionSubsystem::GetStatId() const
+{
+    RETURN_QUICK_DECLARE_CYCLE_STAT(UQuestRegionSubsystem, STATGROUP_Tickables);
+}
+
+int32 UQuestRegionSubsystem::RegisterBoxRegion(FGameplayTag Location, const FTransform& Transform, const FVector& Extent)
+{
+    FQuestRegion Region;
+    Region.Location = Location;
+    Region.Center = Transform.GetLocation();
+    Region.InverseRotation = Transform.GetRotation().Inverse();
+    Region.Extent = Extent;
+    Region.Shape = EQuestRegionShape::Box;
+
+    // Axis aligned bounds of the rotated box
+    const FVector BoundsExtent = FBox(-Extent, Extent).TransformBy(FTransform(Transform.GetRotation())).GetExtent();
+    return AddRegion(MoveTemp(Region), BoundsExtent);
+}
+
+int32 UQuestRegionSubsystem::RegisterSphereRegion(FGameplayTag Location, const FVector& Center, float Radius)
+{
+    FQuestRegion Region;
+    Region.Location = Location;
+    Region.Center = Center;
+    Region.Extent = FVector(Radius);
+    Region.Shape = EQuestRegionShape::Sphere;
+    return AddRegion(MoveTemp(Region), FVector(Radius));
+}
+
+void UQuestRegionSubsystem::UnregisterRegion(int32 RegionId)
+{
+    if (!Regions.IsValidIndex(RegionId))
+    {
+        return;
+    }
+
+    const FQuestRegion& Region = Regions[RegionId];
+    for (int32 CellY = Region.MinCell.Y; CellY <= Region.MaxCell.Y; ++CellY)
+    {
+        for (int32 CellX = Region.MinCell.X; CellX <= Region.MaxCell.X; ++CellX)
+        {
+            const FIntPoint Cell(CellX, CellY);
+            if (TArray<int32>* CellRegions = RegionCells.Find(Cell))
+            {
+                CellRegions->RemoveSingleSwap(RegionId, false);
+                if (CellRegions->Num() == 0)
+                {
+                    RegionCells.Remove(Cell);
+                }
+            }
+        }
+    }
+
+    for (TPair<TObjectKey<APawn>, FPlayerRegionState>& PlayerState : PlayerStates)
+    {
+        PlayerState.Value.InsideRegions.RemoveSingleSwap(RegionId, false);
+    }
+
+    Regions.RemoveAt(RegionId);
+}
+
+bool UQuestRegionSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+    return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+int32 UQuestRegionSubsystem::AddRegion(FQuestRegion&& Region, const FVector& BoundsExtent)
+{
+    Region.MinCell = GetCell(Region.Center - BoundsExtent);
+    Region.MaxCell = GetCell(Region.Center + BoundsExtent);
+
+    const int32 RegionId = Regions.Add(MoveTemp(Region));
+    const FQuestRegion& AddedRegion = Regions[RegionId];
+    for (int32 CellY = AddedRegion.MinCell.Y; CellY <= AddedRegion.MaxCell.Y; ++CellY)
+    {
+        for (int32 CellX = AddedRegion.MinCell.X; CellX <= AddedRegion.MaxCell.X; ++CellX)
+        {
+            RegionCells.FindOrAdd(FIntPoint(CellX, CellY)).Add(RegionId);
+        }
+    }
+    return RegionId;
+}
+
+void UQuestRegionSubsystem::SamplePlayers()
+{
+    PCQS_SCOPE_CYCLE_COUNTER(STAT_PCQS_RegionSampling);
+
+    ++SampleCount;
+    const bool bIsServer = GetWorld()->GetNetMode() != NM_Client;
+    for (FConstPlayerControllerIterator Iterator = GetWorld()->GetPlayerControllerIterator(); Iterator; ++Iterator)
+    {
+        APlayerController* PlayerController = Iterator->Get();
+        if (PlayerController && (bIsServer || PlayerController->IsLocalController()))
+        {
+            if (APawn* Pawn = PlayerController->GetPawn())
+            {
+                SamplePawn(Pawn);
+            }
+        }
+    }
+
+    // Forget pawns that were not sampled, they were destroyed or lost their controller
+    for (TMap<TObjectKey<APawn>, FPlayerRegionState>::TIterator Iterator = PlayerStates.CreateIterator(); Iterator; ++Iterator)
+    {
+        if (Iterator->Value.LastSample != SampleCount)
+        {
+            Iterator.RemoveCurrent();
+        }
+    }
+}
+
+void UQuestRegionSubsystem::SamplePawn(APawn* Pawn)
+{
+    FPlayerRegionState& PlayerState = PlayerStates.FindOrAdd(Pawn);
+    PlayerState.LastSample = SampleCount;
+    if (!PlayerState.QuestComponent.IsValid())
+    {
+        PlayerState.QuestComponent = UQuestComponent::GetQuestComponent(Pawn);
+        if (!PlayerState.QuestComponent.IsValid())
+        {
+            return;
+        }
+    }
+    UQuestComponent* QuestComponent = PlayerState.QuestComponent.Get();
+
+    const FVector PawnLocation = Pawn->GetActorLocation();
+    const float ExitMargin = CVarRegionExitMargin.GetValueOnGameThread();
+
+    // Events are fired after the tests, quest logic reacting to them may register or unregister regions
+    TArray<FGameplayTag, TInlineAllocator<4>> LeftPlaces;
+    TArray<FGameplayTag, TInlineAllocator<4>> ArrivedPlaces;
+
+    for (int32 InsideIndex = PlayerState.InsideRegions.Num() - 1; InsideIndex >= 0; --InsideIndex)
+    {
+        const FQuestRegion& Region = Regions[PlayerState.InsideRegions[InsideIndex]];
+        if (!Region.IsInside(PawnLocation, ExitMargin))
+        {
+            PlayerState.InsideRegions.RemoveAtSwap(InsideIndex, 1, false);
+            LeftPlaces.Add(Region.Location);
+        }
+    }
+
+    if (const TArray<int32>* CellRegions = RegionCells.Find(GetCell(PawnLocation)))
+    {
+        INC_DWORD_STAT_BY(STAT_PCQS_RegionTests, CellRegions->Num());
+        for (const int32 RegionId : *CellRegions)
+        {
+            const FQuestRegion& Region = Regions[RegionId];
+            if (!PlayerState.InsideRegions.Contains(RegionId) && Region.IsInside(PawnLocation, 0.f))
+            {
+                PlayerState.InsideRegions.Add(RegionId);
+                ArrivedPlaces.Add(Region.Location);
+            }
+        }
+    }
+
+    for (const FGameplayTag& PlaceLeft : LeftPlaces)
+    {
+        QuestComponent->OnLeftPlace(PlaceLeft);
+    }
+    for (const FGameplayTag& ArrivedPlace : ArrivedPlaces)
+    {
+        QuestComponent->OnArrivedToPlace(ArrivedPlace);
+    }
+}
+
+FIntPoint UQuestRegionSubsystem::GetCell(const FVector& Location) const
+{
+    return FIntPoint(FMath::FloorToInt(Location.X / RegionCellSize), FMath::FloorToInt(Location.Y / RegionCellSize));
+}
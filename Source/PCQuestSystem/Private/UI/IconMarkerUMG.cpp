@@ -6,29 +6,71 @@
 #include "Components/Image.h"
 #include "Components/TextBlock.h"
 #include <PCQSBlueprintFunctionLibrary.h>
+#include "PCQuestSystemStats.h"
+
+DECLARE_CYCLE_STAT(TEXT("Marker Update"), STAT_PCQS_MarkerUpdate, STATGROUP_PCQuestSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Marker Ticks"), STAT_PCQS_MarkerTicks, STATGROUP_PCQuestSystem);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Marker Updates"), STAT_PCQS_MarkerUpdates, STATGROUP_PCQuestSystem);
 
 
 void UIconMarkerUMG::GetIconLocationRotationAndDistance(FVector2D& OutScreenPosition, float& OutRotationAngleDegrees, float& DistanceToActor, bool& bIsOnScreen)
 {
+    if (bHasLayout)
+    {
+        OutScreenPosition = LayoutInfo.ScreenPosition;
+        OutRotationAngleDegrees = LayoutInfo.RotationAngleDegrees;
+        DistanceToActor = LayoutInfo.DistanceToActor;
+        bIsOnScreen = LayoutInfo.bIsOnScreen;
+        return;
+    }
     UPCQSBlueprintFunctionLibrary::GetActorInformationToPlayerController(UGameplayStatics::GetPlayerController(this, 0), MarkerOwner, true, MarkerOffset, OutScreenPosition, OutRotationAngleDegrees, DistanceToActor, bIsOnScreen, PercentageEdge);
 }
 
 void UIconMarkerUMG::UpdateIcon()
 {
+    PCQS_SCOPE_CYCLE_COUNTER(STAT_PCQS_MarkerUpdate);
+    INC_DWORD_STAT(STAT_PCQS_MarkerUpdates);
+
     FVector2D WidgetPosition;
     float WidgetRotationAngle;
     bool bIsOnScreen;
     float distanceToActor;
 
     GetIconLocationRotationAndDistance(WidgetPosition, WidgetRotationAngle, distanceToActor, bIsOnScreen);
-    SetPositionInViewport(WidgetPosition);
-    MarkerDirection->SetRenderTransformAngle(WidgetRotationAngle);
+
+    if (!WidgetPosition.Equals(LastWidgetPosition, 0.5f))
+    {
+        SetPositionInViewport(WidgetPosition);
+        LastWidgetPosition = WidgetPosition;
+    }
+
+    if (!FMath::IsNearlyEqual(WidgetRotationAngle, LastRotationAngle, 0.1f))
+    {
+        MarkerDirection->SetRenderTransformAngle(WidgetRotationAngle);
+        LastRotationAngle = WidgetRotationAngle;
+    }
+
     float metersDistance = distanceToActor * 0.01f;
-    DistanceText->SetText(FText::AsNumber((int)(metersDistance)));
-    MarkerDirection->SetVisibility(bIsOnScreen ? ESlateVisibility::Collapsed : ESlateVisibility::Visible);
-    DistanceText->SetVisibility(bIsOnScreen && distanceToActor > 5 ? ESlateVisibility::Visible : ESlateVisibility::Collapsed);
+    if ((int32)metersDistance != LastMetersDistance)
+    {
+        LastMetersDistance = (int32)metersDistance;
+        DistanceText->SetText(FText::AsNumber(LastMetersDistance));
+    }
+
+    const ESlateVisibility DirectionVisibility = bIsOnScreen ? ESlateVisibility::Collapsed : ESlateVisibility::Visible;
+    if (DirectionVisibility != LastDirectionVisibility)
+    {
+        MarkerDirection->SetVisibility(DirectionVisibility);
+        LastDirectionVisibility = DirectionVisibility;
+    }
+
+    const ESlateVisibility DistanceVisibility = bIsOnScreen && distanceToActor > 5 ? ESlateVisibility::Visible : ESlateVisibility::Collapsed;
+    if (DistanceVisibility != LastDistanceVisibility)
+    {
+        DistanceText->SetVisibility(DistanceVisibility);
+        LastDistanceVisibility = DistanceVisibility;
+    }
 
-    float CurrentMetersDistance = currentDistanceToActor * 0.01f;
     bool bShouldFadeDistance = metersDistance < DistanceToFade || !bIsOnScreen;
     if (bIsDistanceFaded != bShouldFadeDistance)
     {
@@ -36,7 +78,7 @@ void UIconMarkerUMG::UpdateIcon()
     }
 
     bIsDistanceFaded = bShouldFadeDistance;
-    currentDistanceToActor = distanceToActor;
+    CurrentUpdateInterval = GetUpdateInterval(metersDistance, bIsOnScreen);
 }
 
 void UIconMarkerUMG::SetMarkerOwner(AActor* newMarkerOwner)
@@ -64,8 +106,100 @@ void UIconMarkerUMG::SetMarkerOffset(FVector Offset)
     MarkerOffset = Offset;
 }
 
+void UIconMarkerUMG::ForceUpdate()
+{
+    bForceUpdate = true;
+}
+
+void UIconMarkerUMG::ApplyLayout(const FMarkerScreenInfo& ScreenInfo, int32 NewClusterCount)
+{
+    LayoutInfo = ScreenInfo;
+    bHasLayout = true;
+    SetClusterCount(NewClusterCount);
+}
+
+void UIconMarkerUMG::SetLayoutVisible(bool bVisible)
+{
+    if (bVisible == bLayoutVisible)
+    {
+        return;
+    }
+
+    bLayoutVisible = bVisible;
+    SetVisibility(bVisible ? ESlateVisibility::HitTestInvisible : ESlateVisibility::Collapsed);
+    if (bVisible)
+    {
+        ForceUpdate();
+    }
+}
+
+void UIconMarkerUMG::ClearLayout()
+{
+    bHasLayout = false;
+    SetClusterCount(1);
+    SetLayoutVisible(true);
+}
+
+void UIconMarkerUMG::SetOccluded(bool bOccluded)
+{
+    TargetOpacity = bOccluded ? OccludedOpacity : 1.f;
+}
+
+void UIconMarkerUMG::SetClusterCount(int32 NewClusterCount)
+{
+    if (NewClusterCount == ClusterCount)
+    {
+        return;
+    }
+
+    ClusterCount = NewClusterCount;
+    if (ClusterCountText)
+    {
+        ClusterCountText->SetText(FText::AsNumber(ClusterCount));
+        ClusterCountText->SetVisibility(ClusterCount > 1 ? ESlateVisibility::HitTestInvisible : ESlateVisibility::Collapsed);
+    }
+}
+
+float UIconMarkerUMG::GetUpdateInterval(float MetersDistance, bool bIsOnScreen) const
+{
+    float Interval = FarUpdateInterval;
+    for (const FIconMarkerUpdateTier& Tier : UpdateTiers)
+    {
+        if (MetersDistance <= Tier.MaxDistance)
+        {
+            Interval = Tier.UpdateInterval;
+            break;
+        }
+    }
+    return bIsOnScreen ? Interval : FMath::Max(Interval, EdgeClampedUpdateInterval);
+}
+
+void UIconMarkerUMG::NativeConstruct()
+{
+    Super::NativeConstruct();
+    if (ClusterCountText)
+    {
+        ClusterCountText->SetVisibility(ClusterCount > 1 ? ESlateVisibility::HitTestInvisible : ESlateVisibility::Collapsed);
+    }
+    ForceUpdate();
+}
+
 void UIconMarkerUMG::NativeTick(const FGeometry& MyGeometry, float InDeltaTime)
 {
     Super::NativeTick(MyGeometry, InDeltaTime);
-    UpdateIcon();
+    INC_DWORD_STAT(STAT_PCQS_MarkerTicks);
+
+    const float CurrentOpacity = GetRenderOpacity();
+    if (CurrentOpacity != TargetOpacity)
+    {
+        SetRenderOpacity(OcclusionFadeSpeed > 0.f ? FMath::FInterpConstantTo(CurrentOpacity, TargetOpacity, InDeltaTime, OcclusionFadeSpeed) : TargetOpacity);
+    }
+
+    TimeSinceUpdate += InDeltaTime;
+    if (bForceUpdate || TimeSinceUpdate >= CurrentUpdateInterval)
+    {
+        bForceUpdate = false;
+        TimeSinceUpdate = 0.f;
+        UpdateIcon();
+    }
 }
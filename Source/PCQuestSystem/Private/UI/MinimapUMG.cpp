@@ -0,0 +1,110 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#include "UI/MinimapUMG.h"
+#include "Blueprint/WidgetTree.h"
+#include "Components/CanvasPanel.h"
+#include "Components/CanvasPanelSlot.h"
+#include "Components/Image.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "Markers/MarkerSubsystem.h"
+#include "PCQuestSystemStats.h"
+
+void UMinimapUMG::SetMapRadius(float NewMapRadius)
+{
+    MapRadius = FMath::Max(NewMapRadius, 1.f);
+    TimeSinceUpdate = UpdateInterval;
+}
+
+void UMinimapUMG::NativeTick(const FGeometry& MyGeometry, float InDeltaTime)
+{
+    Super::NativeTick(MyGeometry, InDeltaTime);
+
+    TimeSinceUpdate += InDeltaTime;
+    if (TimeSinceUpdate >= UpdateInterval)
+    {
+        TimeSinceUpdate = 0.f;
+        UpdateMarkers();
+    }
+}
+
+void UMinimapUMG::UpdateMarkers()
+{
+    const APlayerController* PlayerController = GetOwningPlayer();
+    const APawn* Pawn = PlayerController ? PlayerController->GetPawn() : nullptr;
+    const UMarkerSubsystem* MarkerSubsystem = UMarkerSubsystem::Get(this);
+    if (!Pawn || !MarkerSubsystem || !MarkerCanvas)
+    {
+        return;
+    }
+
+    const FVector Center = Pawn->GetActorLocation();
+    const float WorldRadius = MapRadius * 100.f;
+    QueryResults.Reset();
+    MarkerSubsystem->QueryMarkersInRadius(Center, WorldRadius, QueryResults);
+
+    const FVector2D HalfCanvasSize = MarkerCanvas->GetCachedGeometry().GetLocalSize() * 0.5f;
+    const FVector2D WorldToMap = HalfCanvasSize / WorldRadius;
+    const float Yaw = bRotateWithPlayer ? FMath::DegreesToRadians(PlayerController->GetControlRotation().Yaw) : 0.f;
+    float SinYaw, CosYaw;
+    FMath::SinCos(&SinYaw, &CosYaw, Yaw);
+
+    int32 PoolIndex = 0;
+    for (const int32 MarkerIndex : QueryResults)
+    {
+        const FMarkerRecord& Marker = MarkerSubsystem->GetMarkerAt(MarkerIndex);
+        const AActor* MarkerOwner = Marker.Owner.Get();
+        if (!MarkerOwner)
+        {
+            continue;
+        }
+
+        // World X is up on the map and world Y is right, rotated so the pawn faces up when rotating with the player
+        const FVector Delta = MarkerOwner->GetActorLocation() - Center;
+        const double Forward = Delta.X * CosYaw + Delta.Y * SinYaw;
+        const double Right = Delta.Y * CosYaw - Delta.X * SinYaw;
+        const FVector2D MapPosition = HalfCanvasSize + FVector2D(Right, -Forward) * WorldToMap;
+
+        UImage* Image = GetPooledImage(PoolIndex);
+        if (MarkerImageIcons[PoolIndex] != Marker.Icon)
+        {
+            Image->SetBrushFromTexture(Marker.Icon);
+            MarkerImageIcons[PoolIndex] = Marker.Icon;
+        }
+        if (UCanvasPanelSlot* CanvasSlot = Cast<UCanvasPanelSlot>(Image->Slot))
+        {
+            CanvasSlot->SetPosition(MapPosition);
+        }
+        if (PoolIndex >= NumUsedImages)
+        {
+            Image->SetVisibility(ESlateVisibility::HitTestInvisible);
+        }
+        ++PoolIndex;
+    }
+
+    for (int32 UnusedIndex = PoolIndex; UnusedIndex < NumUsedImages; ++UnusedIndex)
+    {
+        MarkerImages[UnusedIndex]->SetVisibility(ESlateVisibility::Collapsed);
+    }
+    NumUsedImages = PoolIndex;
+}
+
+UImage* UMinimapUMG::GetPooledImage(int32 PoolIndex)
+{
+    if (MarkerImages.IsValidIndex(PoolIndex))
+    {
+        return MarkerImages[PoolIndex];
+    }
+
+    LLM_SCOPE_BYTAG(PCQuestSystem_Markers);
+    UImage* Image = WidgetTree->ConstructWidget<UImage>(UImage::StaticClass());
+    if (UCanvasPanelSlot* CanvasSlot = MarkerCanvas->AddChildToCanvas(Image))
+    {
+        CanvasSlot->SetSize(MarkerSize);
+        CanvasSlot->SetAlignment(FVector2D(0.5f, 0.5f));
+    }
+    Image->SetVisibility(ESlateVisibility::Collapsed);
+    MarkerImages.Add(Image);
+    MarkerImageIcons.Add(nullptr);
+    return Image;
+}
@@ -3,6 +3,7 @@
 #include <UI/QuestEventsUserWidget.h>
 #include "Components/TextBlock.h"
 #include "Kismet/KismetSystemLibrary.h"
+#include "PCQuestSystem.h"
 
 void UQuestEventsUserWidget::SetQuestComponent(UQuestComponent* OwnerQuestComponent)
 {
@@ -19,5 +20,5 @@ void UQuestEventsUserWidget::SetQuestComponent(UQuestComponent* OwnerQuestCompon
 
 void UQuestEventsUserWidget::OnQuestActivated_Implementation(FQuest ActivatedQuest)
 {
-    UKismetSystemLibrary::PrintString(this, FString::Printf(TEXT("OnQuestActivated")));
+    PCQS_LOG(Verbose, TEXT("OnQuestActivated %d"), ActivatedQuest.QuestID);
 }
@@ -23,10 +23,17 @@ class PCQUESTSYSTEM_API ALocationTrigger : public ATriggerBox
     UPROPERTY(EditAnywhere, Category = "Location Trigger")
     UIconMarkerComponent* IconMarkerComponent;
 public:
+    void BeginPlay() override;
+    void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
     void NotifyActorBeginOverlap(AActor* OtherActor) override;
     void NotifyActorEndOverlap(AActor* OtherActor) override;
     FGameplayTag GetLocation();
 private:
     UPROPERTY(EditAnywhere)
     FGameplayTag Location;
+    /* Detect players with the quest region grid instead of physics overlaps. Better for worlds with many locations, but only player pawns arrive */
+    UPROPERTY(EditAnywhere, Category = "Location Trigger")
+    bool bUseGridDetection = false;
+
+    int32 RegionId = INDEX_NONE;
 };
@@ -3,18 +3,28 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include <atomic>
 #include <UI/IconMarkerUMG.h>
 #include <Components/IconMarkerComponent.h>
 
+#include "Containers/Queue.h"
 #include "GameplayTagContainer.h"
 #include "Engine/DataTable.h"
 #include "GameFramework/Actor.h"
 #include "GameFramework/GameStateBase.h"
 #include "Interface/QuestObject.h"
 #include "Kismet/KismetSystemLibrary.h"
+#include "Actors/QuestPrerequisiteGraph.h"
+#include "Actors/QuestTagFilterTable.h"
 #include "QuestManager.generated.h"
 
+class AController;
+class AGameModeBase;
+class APlayerState;
+class FQuestEventCaptureWriter;
+struct FQuestCaptureSnapshot;
 class IQuestObject;
+class UMarkerSubsystem;
 
 UENUM(BlueprintType)
 enum class EQuestType : uint8
@@ -55,12 +65,16 @@ struct FQuestStateInfo
     int CurrentStepQuestObjectID = -1;
     UPROPERTY()
     bool CurrentActive = false;
+    /* Steps completed so far, so quests that are not linear can be resumed */
+    UPROPERTY()
+    TArray<int> CompletedSteps;
 
     void Reset()
     {
         QuestID = -1;
         CurrentStepQuestObjectID = -1;
         CurrentActive = false;
+        CompletedSteps.Reset();
     }
     
     bool IsValid() const
@@ -72,6 +86,7 @@ struct FQuestStateInfo
     {
         QuestID = QuestInfo.QuestID;
         CurrentStepQuestObjectID = QuestInfo.CurrentStepQuestObjectID;
+        CompletedSteps = QuestInfo.CompletedSteps;
     }
 
     bool operator==(const FQuestStateInfo& QuestInfo) const
@@ -97,6 +112,9 @@ struct PCQUESTSYSTEM_API FIconMarkerInformation
     bool bShowOnScreen;
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = QuestStepObjective, meta = (EditCondition = "bCreateMarker == true"))
     FVector MarkerToActorOffset;
+    /* Higher priority markers stay visible when there are more markers than the screen allows */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = QuestStepObjective, meta = (EditCondition = "bCreateMarker == true"))
+    int32 MarkerPriority = 0;
 };
 
 USTRUCT(BlueprintType)
@@ -175,6 +193,22 @@ struct PCQUESTSYSTEM_API FQuestStepObjective
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = QuestStepObjective)
     FText Description;
 
+    /* Steps (by their key in the objective maps) that have to be completed before this one is active. Empty means the previous step, so linear quests need no setup */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = QuestStepObjective, meta = (EditCondition = "bActiveOnQuestStart == false"))
+    TArray<int> RequiredSteps;
+    /* Active once any of RequiredSteps is completed. The required steps left behind are dropped, which is how branches are built */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = QuestStepObjective, meta = (EditCondition = "bActiveOnQuestStart == false"))
+    bool bRequireAnyStep = false;
+    /* Active as soon as the quest is, in parallel with the other steps that start with it */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = QuestStepObjective)
+    bool bActiveOnQuestStart = false;
+    /* The quest can complete without this step */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = QuestStepObjective)
+    bool bOptional = false;
+    /* Events with a child of the step tags count too, Enemy.Wolf takes Enemy.Wolf.Alpha */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = QuestStepObjective)
+    bool bMatchChildTags = false;
+
     UPROPERTY(BlueprintReadWrite, Category = QuestStepObjective)
     TArray<AActor*> SpawnedActors;
 
@@ -182,6 +216,35 @@ struct PCQUESTSYSTEM_API FQuestStepObjective
 
     FString SplitEnumString(FString EnumString);
     FText GetStepDescription() { return Description; };
+
+    /* Tags of the events that progress this step, used to index the active steps */
+    virtual void GetEventTags(TArray<FGameplayTag>& OutTags) const {}
+    bool MatchesEventTag(const FGameplayTag& Tag) const;
+
+    /* Progress still needed, read off the game thread by AQuestManager::ApplyEvents so it has to stay plain data */
+    virtual float GetRemainingProgress() const { return bIsCompleted ? 0.f : 1.f; }
+    /* Kills, items or catches that complete a counted step */
+    virtual float GetCounterTarget() const { return 0.f; }
+    /* Total of the step counters when it became active, its progress is how far they moved since. Server only */
+    float CounterBaseline = 0.f;
+
+    void CopyStepSettings(const FQuestStepObjective& Other)
+    {
+        RequiredSteps = Other.RequiredSteps;
+        bRequireAnyStep = Other.bRequireAnyStep;
+        bActiveOnQuestStart = Other.bActiveOnQuestStart;
+        bOptional = Other.bOptional;
+        bMatchChildTags = Other.bMatchChildTags;
+    }
+
+    /* Memory accounting for pcqs.MemReport. Definition is the step data, runtime the arrays that fill up while it is active */
+    virtual SIZE_T GetStructSize() const { return sizeof(FQuestStepObjective); }
+    virtual SIZE_T GetDefinitionAllocatedSize() const { return QuestStepRewards.GetAllocatedSize(); }
+    SIZE_T GetRuntimeAllocatedSize() const
+    {
+        return SpawnedActors.GetAllocatedSize() + ActorsAssociated.GetAllocatedSize() + MarkerHandles.GetAllocatedSize() + CompletedPlayerSlots.GetAllocatedSize();
+    }
+
     /* Spawn/collect necessary actors */
 
     virtual void Activate(UWorld* WorldContext, AQuestManager* QuestManager)
@@ -189,55 +252,28 @@ struct PCQUESTSYSTEM_API FQuestStepObjective
         ActivateActorMarker();
     };
     
-    virtual void Deactivate(bool bReset)
-    {
-        for (AActor* AssociatedActor : ActorsAssociated)
-        {
-            if (UIconMarkerComponent* ActorMarkerComponent = AssociatedActor->FindComponentByClass<UIconMarkerComponent>())
-            {
-                ActorMarkerComponent->DeactivateMarker();
-            }
-            
-            if (IQuestObject* ActorAsQuestObject = Cast<IQuestObject>(AssociatedActor))
-            {
-                ActorAsQuestObject->DeactivateObject(bReset);
-                ActorAsQuestObject->Execute_BP_DeactivateObject(AssociatedActor, bReset);
-            }
-        }
-    };
+    virtual void Deactivate(bool bReset);
     
-    virtual void OnCompleted(APlayerController* CompletedBy)
-    {
-        if (CompletedBy == nullptr)
-        {
-            return;
-        }
-        
-        if (!bRequiresAllPlayers)
-        {
-            bIsCompleted = true;
-            return;
-        }
-        CompletedControllers.AddUnique(CompletedBy);
-        bIsCompleted = CompletedControllers.Num() == CompletedBy->GetWorld()->GetGameState()->PlayerArray.Num();
-    }
+    virtual void OnCompleted(APlayerController* CompletedBy);
+    /* Kill, gather and catch steps reaching their target. The count finishes a step any player can do even when no player is given */
+    void OnCountReached(APlayerController* CompletedBy);
+
+    /* Slots (AQuestManager::GetPlayerSlot) of the players that got here, for steps every player has to do. Server only */
+    TBitArray<> CompletedPlayerSlots;
+    /* Completes the step once every connected slot is in CompletedPlayerSlots, one word operation per 32 players */
+    bool UpdatePlayerCompletion(const TBitArray<>& ConnectedPlayerSlots);
+    /* Manager that loaded the step */
+    TWeakObjectPtr<AQuestManager> OwningQuestManager;
 
     void ResetStepQuest()
     {
         Deactivate(true);
         bIsCompleted = false;
+        CompletedPlayerSlots.Empty();
     }
 
-    virtual void ActivateActorMarker()
-    {
-        for (AActor* AssociatedActor : ActorsAssociated)
-        {
-            if (UIconMarkerComponent* ActorMarkerComponent = AssociatedActor->FindComponentByClass<UIconMarkerComponent>())
-            {
-                ActorMarkerComponent->ActivateMarker();
-            }
-        }
-    };
+    virtual void ActivateActorMarker();
+    void DeactivateActorMarker();
     bool IsCompleted() { return bIsCompleted; };
     // This is so we can tell to the clients that this is done
     // instead of having them control when should a step be completed which is server's job
@@ -255,8 +291,14 @@ struct PCQUESTSYSTEM_API FQuestStepObjective
         ActorsAssociated.Add(ActorToAdd);
     }
 
+    bool HasAssociatedActor(AActor* Actor) const
+    {
+        return ActorsAssociated.Contains(Actor);
+    }
+
     void RemoveAllAssociatedActor()
     {
+        RemoveIconMarkers();
         ActorsAssociated.Empty();
         for (const auto SpawnedActor : SpawnedActors)
         {
@@ -270,11 +312,14 @@ struct PCQUESTSYSTEM_API FQuestStepObjective
         return StepObjectiveInsideQuestOrder > 0 && QuestStepType != EQuestStepType::None;
     }
 protected:
+    void RemoveIconMarkers();
+
     bool bIsCompleted;
     UPROPERTY()
     TArray<AActor*> ActorsAssociated;
-    UPROPERTY()
-    TArray<APlayerController*> CompletedControllers;
+    /* Marker records added for associated actors that have no UIconMarkerComponent of their own */
+    TArray<FMarkerHandle> MarkerHandles;
+    TWeakObjectPtr<UMarkerSubsystem> MarkerSubsystem;
 };
 
 USTRUCT(BlueprintType)
@@ -299,9 +344,11 @@ struct PCQUESTSYSTEM_API FQuestStepGoToObjective : public FQuestStepObjective
         FGameplayTag PlaceToGo;
 
     void OnArrivedToPlace(APlayerController* ArrivedBy) { OnCompleted(ArrivedBy); };
+    void GetEventTags(TArray<FGameplayTag>& OutTags) const override { OutTags.Add(PlaceToGo); }
 
     void Activate(UWorld* WorldContext, AQuestManager* QuestManager) override;
 
+    SIZE_T GetStructSize() const override { return sizeof(FQuestStepGoToObjective); }
 };
 
 USTRUCT(BlueprintType)
@@ -338,9 +385,11 @@ struct PCQUESTSYSTEM_API FQuestStepTalkWithObjective : public FQuestStepObjectiv
         FGameplayTag EntityToTalkWith;
 
     void OnTalkedWithEntity(APlayerController* TalkedBy) { OnCompleted(TalkedBy); }
+    void GetEventTags(TArray<FGameplayTag>& OutTags) const override { OutTags.Add(EntityToTalkWith); }
 
     void Activate(UWorld* WorldContext, AQuestManager* QuestManager) override;
 
+    SIZE_T GetStructSize() const override { return sizeof(FQuestStepTalkWithObjective); }
 };
 
 USTRUCT(BlueprintType)
@@ -374,19 +423,13 @@ struct PCQUESTSYSTEM_API FQuestStepKillObjective : public FQuestStepObjective
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = QuestStepObjective)
         int AmountToKill;
 
-    void OnEntityKilled(APlayerController* KilledBy)
-    {
-        bIsCompleted = ++CurrentlyKilled >= AmountToKill;
-        if (bIsCompleted)
-        {
-            OnCompleted(KilledBy);
-        }
-    }
-private:
-    int CurrentlyKilled = 0;
-public:
+    void GetEventTags(TArray<FGameplayTag>& OutTags) const override { OutTags.Add(EntityToKill); }
+    float GetCounterTarget() const override { return AmountToKill; }
+
     void Activate(UWorld* WorldContext, AQuestManager* QuestManager) override;
 
+    SIZE_T GetStructSize() const override { return sizeof(FQuestStepKillObjective); }
+    SIZE_T GetDefinitionAllocatedSize() const override { return Super::GetDefinitionAllocatedSize() + SpawnInformation.PawnsToSpawnWhenActive.GetAllocatedSize(); }
 };
 
 USTRUCT(BlueprintType)
@@ -415,18 +458,10 @@ struct PCQUESTSYSTEM_API FQuestStepGatherObjective : public FQuestStepObjective
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = QuestStepObjective)
         float AmountToGather;
 
-    void OnItemGathered(APlayerController* GatheredBy, float amountGathered)
-    {
-        CurrentlyGathered += amountGathered;
-        bIsCompleted = CurrentlyGathered >= AmountToGather;
-        if (bIsCompleted)
-        {
-            OnCompleted(GatheredBy);
-        }
-    }
-private:
-    float CurrentlyGathered = 0;
+    void GetEventTags(TArray<FGameplayTag>& OutTags) const override { OutTags.Add(ItemToGather); }
+    float GetCounterTarget() const override { return AmountToGather; }
 
+    SIZE_T GetStructSize() const override { return sizeof(FQuestStepGatherObjective); }
 };
 
 USTRUCT(BlueprintType)
@@ -453,17 +488,11 @@ struct PCQUESTSYSTEM_API FQuestStepCatchObjective : public FQuestStepObjective
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = QuestStepObjective)
     int AmountNeeded = 1;
 
-    void OnCatched(APlayerController* CatchedBy)
-    {
-        bIsCompleted = ++CurrentlyCatched >= AmountNeeded;
-        if (bIsCompleted)
-        {
-            OnCompleted(CatchedBy);
-        }
-    }
-private:
-    int CurrentlyCatched = 0;
+    void GetEventTags(TArray<FGameplayTag>& OutTags) const override { OutTags.Append(AllowedTagToCatch); }
+    float GetCounterTarget() const override { return AmountNeeded; }
 
+    SIZE_T GetStructSize() const override { return sizeof(FQuestStepCatchObjective); }
+    SIZE_T GetDefinitionAllocatedSize() const override { return Super::GetDefinitionAllocatedSize() + AllowedTagToCatch.GetAllocatedSize(); }
 };
 
 USTRUCT(BlueprintType)
@@ -520,38 +549,15 @@ struct PCQUESTSYSTEM_API FQuest : public FTableRowBase
     UPROPERTY(NotReplicated, EditAnywhere, BlueprintReadWrite, Category = Quest)
         TMap<int, FQuestStepCatchObjective> CatchObjectives;
 
+    /** Quests that have to be completed before this one is available, by ID (the row position, starting at 1) */
+    UPROPERTY(NotReplicated, EditAnywhere, BlueprintReadWrite, Category = Quest)
+        TArray<int> PrerequisiteQuests;
+
     /* This is so we can use pointers and cast to our specific data type */
     TArray<TSharedPtr<FQuestStepObjective>> ObjectivesArray;
 
-    void Init()
-    {
-        TArray<FQuestStepObjective> Objectives;
-        for (auto& Elem : GoToObjectives)
-        {
-            ObjectivesArray.Emplace(MakeShareable(new FQuestStepGoToObjective(QuestID, Elem.Key, Elem.Value.Description, Elem.Value.ActorReference, Elem.Value.bRequiresAllPlayers, Elem.Value.QuestStepRewards, Elem.Value.ObjectiveMarkerUMGInformation, Elem.Value.PlaceToGo)));
-        }
-
-        for (auto& Elem : TalkWithObjectives)
-        {
-            ObjectivesArray.Emplace(MakeShareable(new FQuestStepTalkWithObjective(QuestID, Elem.Key, Elem.Value.Description, Elem.Value.ActorReference, Elem.Value.bRequiresAllPlayers, Elem.Value.QuestStepRewards, Elem.Value.ObjectiveMarkerUMGInformation, Elem.Value.PawnToSpawnWhenActive, Elem.Value.WorldPositionToSpawn, Elem.Value.WorldRotationToSpawn, Elem.Value.EntityToTalkWith)));
-        }
-
-        for (auto& Elem : KillObjectives)
-        {
-            ObjectivesArray.Emplace(MakeShareable(new FQuestStepKillObjective(QuestID, Elem.Key, Elem.Value.Description, Elem.Value.ActorReference, Elem.Value.bRequiresAllPlayers, Elem.Value.QuestStepRewards, Elem.Value.ObjectiveMarkerUMGInformation, Elem.Value.SpawnInformation, Elem.Value.EntityToKill, Elem.Value.AmountToKill)));
-        }
-
-        for (auto& Elem : GatherObjectives)
-        {
-            ObjectivesArray.Emplace(MakeShareable(new FQuestStepGatherObjective(QuestID, Elem.Key, Elem.Value.Description, Elem.Value.ActorReference, Elem.Value.bRequiresAllPlayers, Elem.Value.QuestStepRewards, Elem.Value.ObjectiveMarkerUMGInformation, Elem.Value.ItemToGather, Elem.Value.AmountToGather)));
-        }
-
-        for (auto& Elem : CatchObjectives)
-        {
-            ObjectivesArray.Emplace(MakeShareable(new FQuestStepCatchObjective(QuestID, Elem.Key, Elem.Value.Description, Elem.Value.ActorReference, Elem.Value.bRequiresAllPlayers, Elem.Value.QuestStepRewards, Elem.Value.ObjectiveMarkerUMGInformation, Elem.Value.AllowedTagToCatch)));
-        }
-        ObjectivesArray.Sort([](TSharedPtr<FQuestStepObjective> StepObjective1, TSharedPtr<FQuestStepObjective> StepObjective2) { return StepObjective1->StepObjectiveInsideQuestOrder < StepObjective2->StepObjectiveInsideQuestOrder; });
-    }
+    /* Builds ObjectivesArray from the objective maps */
+    void Init();
 
     void ResetQuest()
     {
@@ -559,6 +565,7 @@ struct PCQUESTSYSTEM_API FQuest : public FTableRowBase
         {
             Objective->ResetStepQuest();
         }
+        ResetStepGraph();
     }
 
     void ClearQuest()
@@ -572,9 +579,9 @@ struct PCQUESTSYSTEM_API FQuest : public FTableRowBase
 
     bool IsQuestCompleted() const
     {
-        for (TSharedPtr<FQuestStepObjective> Objective : ObjectivesArray)
+        for (int32 StepIndex = 0; StepIndex < ObjectivesArray.Num(); ++StepIndex)
         {
-            if (!Objective->IsCompleted())
+            if (!ObjectivesArray[StepIndex]->IsCompleted() && !ObjectivesArray[StepIndex]->bOptional && !IsStepSkipped(StepIndex))
             {
                 return false;
             }
@@ -596,6 +603,10 @@ struct PCQUESTSYSTEM_API FQuest : public FTableRowBase
 
     FQuestStepObjective GetCurrentObjective() const
     {
+        if (const TSharedPtr<FQuestStepObjective> FirstActiveStep = GetFirstActiveStep())
+        {
+            return *FirstActiveStep.Get();
+        }
         if (!IsQuestCompleted())
         {
             TSharedPtr<FQuestStepObjective> CurrentObjective = *ObjectivesArray.FindByPredicate([](const TSharedPtr<FQuestStepObjective> objective)
@@ -609,6 +620,10 @@ struct PCQUESTSYSTEM_API FQuest : public FTableRowBase
 
     TSharedPtr<FQuestStepObjective> GetCurrentObjectiveSharedPtr() const
     {
+        if (const TSharedPtr<FQuestStepObjective> FirstActiveStep = GetFirstActiveStep())
+        {
+            return FirstActiveStep;
+        }
         if (!IsQuestCompleted())
         {
             TSharedPtr<FQuestStepObjective> CurrentObjective = *ObjectivesArray.FindByPredicate([](const TSharedPtr<FQuestStepObjective> objective)
@@ -632,10 +647,58 @@ struct PCQUESTSYSTEM_API FQuest : public FTableRowBase
     void ActivateCurrentObjective(UWorld* WordContext, AQuestManager* QuestManager);
     void DeactivateObjective(TSharedPtr<FQuestStepObjective> ObjectiveToDeactivate);
 
+    /* Step graph. Steps become active once their RequiredSteps are completed, the active ones form the frontier. Indices are into ObjectivesArray */
+    void BuildStepGraph();
+    void ResetStepGraph();
+    /* Rebuilds the frontier from the steps already completed. Used when the quest is activated or resumed */
+    void StartSteps();
+    /* Moves the frontier past a completed step, only touching the steps that require it. Appends the steps that became active and the ones a branch left behind */
+    void CompleteStep(int32 StepIndex, TArray<int32>& OutActivatedSteps, TArray<int32>& OutSkippedSteps);
+    const TArray<int32>& GetActiveSteps() const { return ActiveSteps; }
+    bool IsStepActive(int32 StepIndex) const { return StepNodes.IsValidIndex(StepIndex) && StepNodes[StepIndex].ActiveIndex != INDEX_NONE; }
+    bool IsStepSkipped(int32 StepIndex) const { return StepNodes.IsValidIndex(StepIndex) && StepNodes[StepIndex].bSkipped; }
+    /* Constant time completion check for the event handlers, IsQuestCompleted checks every step */
+    bool AreRequiredStepsCompleted() const { return NumRequiredStepsLeft == 0; }
+    int32 GetStepIndex(int StepID) const
+    {
+        return ObjectivesArray.IndexOfByPredicate([StepID](const TSharedPtr<FQuestStepObjective>& Objective) { return Objective->StepObjectiveInsideQuestOrder == StepID; });
+    }
+
+    /* Memory accounting for pcqs.MemReport. Definition covers the objective maps the quest was loaded from and the objectives built from them */
+    SIZE_T GetDefinitionAllocatedSize() const;
+    SIZE_T GetRuntimeAllocatedSize() const;
+
     bool IsValid() const
     {
         return QuestID > -1;
     }
+    /* False when the steps require each other in a cycle. The quest could never complete, so it is never available or activated */
+    bool HasValidStepGraph() const { return bStepGraphValid; }
+
+private:
+    struct FStepNode
+    {
+        TArray<int32> Required;
+        TArray<int32> Dependents;
+        int32 NumPendingRequirements = 0;
+        /* Position in ActiveSteps, so it can be removed without a search */
+        int32 ActiveIndex = INDEX_NONE;
+        bool bCompleted = false;
+        bool bSkipped = false;
+    };
+
+    TSharedPtr<FQuestStepObjective> GetFirstActiveStep() const;
+    int32 GetNumPendingRequirements(int32 StepIndex) const;
+    void AddActiveStep(int32 StepIndex);
+    void RemoveActiveStep(int32 StepIndex);
+    /* Drops an unfinished step once no step waits on it any more, then tries the steps it requires, so a branch that was not taken is dropped whole.
+     * Appends the dropped steps that were active */
+    bool TrySkipStep(int32 StepIndex, TArray<int32>& OutSkippedSteps);
+
+    TArray<FStepNode> StepNodes;
+    TArray<int32> ActiveSteps;
+    int32 NumRequiredStepsLeft = 0;
+    bool bStepGraphValid = true;
 };
 
 USTRUCT(BlueprintType)
@@ -650,6 +713,20 @@ struct PCQUESTSYSTEM_API FQuestActorReference
     AActor* ReferenceActor;
 };
 
+/* Actors the server spawned for a step. Replicated so clients can derive the step markers on their own */
+USTRUCT()
+struct PCQUESTSYSTEM_API FQuestStepSpawnedActors
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+    int QuestID = -1;
+    UPROPERTY()
+    int StepID = -1;
+    UPROPERTY()
+    TArray<AActor*> Actors;
+};
+
 USTRUCT(BlueprintType)
 struct PCQUESTSYSTEM_API FQuestActorReferences
 {
@@ -659,8 +736,139 @@ struct PCQUESTSYSTEM_API FQuestActorReferences
     TArray<FQuestActorReference> QuestActors;
 };
 
+/* Event that progresses a step, the key of the active step index. Steps with bMatchChildTags are keyed apart, an event reaches them through FQuestTagFilterTable */
+struct FQuestStepEventKey
+{
+    EQuestStepType StepType = EQuestStepType::None;
+    FGameplayTag Tag;
+    bool bMatchChildTags = false;
+
+    bool operator==(const FQuestStepEventKey& Other) const
+    {
+        return StepType == Other.StepType && Tag == Other.Tag && bMatchChildTags == Other.bMatchChildTags;
+    }
+
+    friend uint32 GetTypeHash(const FQuestStepEventKey& Key)
+    {
+        return HashCombine(HashCombine(::GetTypeHash((uint8)Key.StepType), GetTypeHash(Key.Tag)), ::GetTypeHash(Key.bMatchChildTags));
+    }
+};
+
+/* Event for AQuestManager::ApplyEvents. Amount is how many were killed, gathered or caught */
+struct FQuestProgressEvent
+{
+    EQuestStepType StepType = EQuestStepType::None;
+    FGameplayTag Tag;
+    float Amount = 1.f;
+    APlayerController* Player = nullptr;
+};
+
+/* FQuestProgressEvent as queued from other threads, the player is only resolved on the game thread */
+struct FQueuedQuestEvent
+{
+    EQuestStepType StepType = EQuestStepType::None;
+    FGameplayTag Tag;
+    float Amount = 1.f;
+    TWeakObjectPtr<APlayerController> Player;
+};
+
+struct FQuestStepRef
+{
+    TSharedPtr<FQuest> Quest;
+    int32 StepIndex = INDEX_NONE;
+
+    bool operator==(const FQuestStepRef& Other) const
+    {
+        return Quest == Other.Quest && StepIndex == Other.StepIndex;
+    }
+};
+
+/**
+ * Running totals of the kill, gather and catch events per tag, shared by every active step that counts them.
+ * Steps keep the total they started from and their target. The ones on a single tag wait in a list sorted by the total that completes them,
+ * so an event is one increment plus the steps it finishes, however many quests count the same tag.
+ */
+struct PCQUESTSYSTEM_API FQuestCounterTable
+{
+    /* Starts counting the step from the current totals of its tags */
+    void AddStep(const FQuestStepRef& Step);
+    void RemoveStep(const FQuestStepRef& Step);
+    /* Moves the step baseline back by Amount, appending it if that already reaches the target */
+    void RebaseStep(const FQuestStepRef& Step, float Amount, TArray<FQuestStepRef>& OutReached);
+    /* For a step at its target that did not complete, it is appended again on every increment */
+    void WatchStep(const FQuestStepRef& Step);
+    void Empty();
+
+    /* Adds to the total of the key and appends the steps at their target */
+    void Add(const FQuestStepEventKey& Key, float Amount, TArray<FQuestStepRef>& OutReached);
+    /* True when adding Amount to the key would reach a step, or when the key has steps checked on every increment */
+    bool WouldReach(const FQuestStepEventKey& Key, float Amount) const;
+    float GetValue(const FQuestStepEventKey& Key) const;
+    float GetProgress(const FQuestStepObjective& Objective) const;
+    SIZE_T GetAllocatedSize() const;
+
+private:
+    struct FThreshold
+    {
+        float Target;
+        FQuestStepRef Step;
+    };
+
+    struct FCounter
+    {
+        float Value = 0.f;
+        /* Highest target first, the next step to complete is popped from the back */
+        TArray<FThreshold> Thresholds;
+        /* Steps on several tags, or at their target without being completed, checked on every increment */
+        TArray<FQuestStepRef> Watchers;
+    };
+
+    /* Tags already under one of the step's parent filters are left out, so an event never counts twice for a step */
+    static void GetStepKeys(const FQuestStepObjective& Objective, TArray<FQuestStepEventKey, TInlineAllocator<4>>& OutKeys);
+    void InsertStep(const FQuestStepRef& Step, TArray<FQuestStepRef>* OutReached);
+
+    /* Only the tags some active step counts have an entry */
+    TMap<FQuestStepEventKey, FCounter> Counters;
+};
+
+/* Players that completed a step every player has to do, as bits over the AQuestManager player slots */
+USTRUCT()
+struct PCQUESTSYSTEM_API FQuestStepPlayerMask
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+    int QuestID = -1;
+    UPROPERTY()
+    int StepID = -1;
+    UPROPERTY()
+    TArray<uint32> SlotWords;
+};
+
+/* Memory owned by a quest manager, filled by AQuestManager::GetMemoryUsage for pcqs.MemReport */
+struct FQuestMemoryUsage
+{
+    struct FQuestEntry
+    {
+        int32 QuestID = 0;
+        FString Name;
+        int32 NumSteps = 0;
+        bool bActive = false;
+        SIZE_T DefinitionBytes = 0;
+        SIZE_T RuntimeBytes = 0;
+        int32 NumSpawnedActors = 0;
+    };
+
+    TArray<FQuestEntry> Quests;
+    /* Totals, including the manager containers on top of the quests */
+    SIZE_T DefinitionBytes = 0;
+    SIZE_T RuntimeBytes = 0;
+    TSet<const AActor*> SpawnedActors;
+};
+
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnQuestActivated, FQuest, ActivatedQuest, bool, bNewQuest);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnQuestCompleted, FQuest, CompletedQuest);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnQuestAvailable, FQuest, AvailableQuest);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnQuestStepCompleted, FQuestStepObjective, CompletedStepQuest, FQuest, QuestWhereStepBelongs);
 
 /**
@@ -681,6 +889,9 @@ public:
         FOnQuestCompleted OnQuestCompletedDelegate;
     UPROPERTY(BlueprintAssignable, Category = "QuestManager")
         FOnQuestStepCompleted OnQuestStepCompletedDelegate;
+    /* Broadcast when a completion leaves a quest with all its prerequisites completed */
+    UPROPERTY(BlueprintAssignable, Category = "QuestManager")
+        FOnQuestAvailable OnQuestAvailable;
 
     UFUNCTION(Server, Reliable, BlueprintCallable, Category = "QuestManager")
         void ActivateQuest(int QuestIDToActivate, int StepIDToActivate = 0);
@@ -708,30 +919,52 @@ public:
         const TArray<FQuest> GetAllQuests();
     UFUNCTION(BlueprintPure, Category = "QuestManager")
         TArray<FQuest> GetAllCompletedQuests();
+    UFUNCTION(BlueprintPure, Category = "QuestManager")
+        const TArray<FQuest> GetAvailableQuests();
+    UFUNCTION(BlueprintPure, Category = "QuestManager")
+        TArray<int> GetAvailableQuestIDs() const;
+    UFUNCTION(BlueprintPure, Category = "QuestManager")
+        bool IsQuestAvailable(int QuestID) const;
 
     UFUNCTION(Server, Reliable, Category = "QuestManager")
         void OnArrivedToPlace(FGameplayTag ArrivedPlace, APlayerController* ArrivedBy);
-    UFUNCTION(NetMulticast, Reliable, Category = "QuestManager")
-        void OnQuestStepArrivedToPlace(int StepID, int QuestID, FGameplayTag ArrivedPlace, APlayerController* ArrivedBy);
     UFUNCTION(Server, Reliable, Category = "QuestManager")
         void OnEntityTalkedTo(FGameplayTag TalkedEntity, APlayerController* TalkedBy);
-    UFUNCTION(NetMulticast, Reliable, Category = "QuestManager")
-        void OnQuestStepEntityTalkedTo(int StepID, int QuestID, FGameplayTag TalkedEntity, APlayerController* TalkedBy);
     UFUNCTION(Server, Reliable, Category = "QuestManager")
         void OnEntityKilled(FGameplayTag EntityKilled, APlayerController* KilledBy);
-    UFUNCTION(NetMulticast, Reliable, Category = "QuestManager")
-        void OnQuestStepEntityKilled(int StepID, int QuestID, FGameplayTag EntityKilled, APlayerController* KilledBy);
     UFUNCTION(Server, Reliable, Category = "QuestManager")
         void OnItemGathered(FGameplayTag ItemGathered, float amountGathered, APlayerController* GatheredBy);
-    UFUNCTION(NetMulticast, Reliable, Category = "QuestManager")
-        void OnQuestStepItemGathered(int StepID, int QuestID, FGameplayTag ItemGathered, float amountGathered, APlayerController* GatheredBy);
     UFUNCTION(Server, Reliable, Category = "QuestManager")
         void OnCatch(FGameplayTag CatchTag, APlayerController* CatchedBy);
     UFUNCTION(NetMulticast, Reliable, Category = "QuestManager")
-        void OnQuestStepCatch(int StepID, int QuestID, FGameplayTag CatchTag, APlayerController* CatchedBy);
+        void OnQuestStepProgressed(int StepID, int QuestID, float Amount, APlayerController* ProgressedBy);
+
+    /* Server only. Applies a batch of events in order. Counted events cost one counter increment however many quests count their tag,
+     * the others only reach the steps waiting for them */
+    void ApplyEvents(TArrayView<const FQuestProgressEvent> Events);
+
+    /* Thread safe. Queues an event from any thread, the server drains the queue into ApplyEvents when the manager ticks at the start of the frame.
+     * Returns false if the queue is full (pcqs.EventQueue.Capacity) and the event was dropped, or on clients, which never drain it */
+    bool EnqueueEvent(const FQueuedQuestEvent& Event);
+    int32 GetQueuedEventCount() const { return NumQueuedEvents.load(std::memory_order_relaxed); }
+    int64 GetDroppedEventCount() const { return NumDroppedEvents.load(std::memory_order_relaxed); }
 
     UFUNCTION()
     void OnRep_OnActiveQuests();
+    UFUNCTION()
+    void OnRep_SpawnedStepActors();
+    UFUNCTION()
+    void OnRep_CompletedQuests();
+    UFUNCTION()
+    void OnRep_PlayerSlots();
+
+    /* Slot the player keeps for as long as it is connected, slots of players that left are reused. INDEX_NONE if it has none */
+    int32 GetPlayerSlot(const AController* Player) const;
+    /* Players that already completed a step every player has to do, from the replicated slot mask */
+    UFUNCTION(BlueprintPure, Category = "QuestManager")
+        TArray<APlayerState*> GetStepCompletedPlayers(int QuestID, int StepID) const;
+    /* Server only. Marks the player on a step every player has to do and completes it once all connected players are marked */
+    void MarkPlayerCompleted(FQuestStepObjective& Objective, const AController* Player);
     
     UFUNCTION(Server, Reliable)
         void SpawnActor(TSubclassOf<AActor> ActorToSpawn, FVector WorldPositionToSpawn, FRotator WorldRotationToSpawn);
@@ -752,7 +985,29 @@ public:
         FText GetStepObjectiveDescription(FQuestStepObjective QuestStep);
 
     void AddAssociatedActorToQuestStep(int StepQuestID, int QuestIDToGet, AActor* ActorToAdd);
+    /* Server only. Associates an actor spawned for a step and replicates it so clients can add its marker */
+    void AddSpawnedActorToQuestStep(int StepQuestID, int QuestIDToGet, AActor* SpawnedActor);
     AActor* GetLastSpawnedActor();
+
+    /* Replaces all quests with copies of the given rows, with IDs given in order starting at 1. BeginPlay calls it with the DataTable rows */
+    void LoadQuests(const TArray<FQuest*>& QuestRows);
+    int32 GetNumQuests() const { return AllQuests.Num(); }
+    void GetMemoryUsage(FQuestMemoryUsage& OutUsage) const;
+
+    /* Sent by the network soak after its events, clients measure how long it took to arrive */
+    UFUNCTION(NetMulticast, Reliable)
+    void SoakLatencyProbe(double SentTime);
+
+    /* Server only. Streams every inbound event to a capture file that PCQSReplay can play back. Also started with -PCQSCapture=<File> */
+    bool StartEventCapture(const FString& Path);
+    void StopEventCapture();
+    bool IsCapturingEvents() const { return EventCapture.IsValid(); }
+    /* Server only. Active quests, their completed steps and counter progress, written at the start of a capture */
+    void GetCaptureSnapshot(FQuestCaptureSnapshot& OutSnapshot) const;
+    /* Server only. Puts a manager that just loaded its quests in the state of a snapshot, PCQSReplay does it before the first event */
+    void RestoreCaptureSnapshot(const FQuestCaptureSnapshot& Snapshot);
+    /* Server only. Players get a slot when they log in, worlds without a game mode add them here */
+    void AddPlayerSlot(APlayerState* PlayerState);
 private:
     TSharedPtr<FQuest> GetQuestByID(int IDToGet);
     TSharedPtr<FQuest> GetQuestByID(int IDToGet) const;
@@ -761,29 +1016,104 @@ private:
     void ActivateQuestObjectives(int QuestID, int StepIDToActivate = 0);
     void ActivateQuestReferences(int QuestID);
     void DeactivateQuestReferences(int QuestID);
+    void RemoveSpawnedStepActors(int QuestID);
+    /* Queues the quest for the end of the frame, a quest completed more than once in a frame is only processed once */
     void OnQuestCompleted(TSharedPtr<FQuest> CompletedQuest);
+    void OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+    /* Processes every quest completed this frame with a single notification */
+    void FlushCompletedQuests();
     UFUNCTION(NetMulticast, reliable)
-    void OnQuestCompletedNextTick(int CompletedQuestID);
+    void OnQuestsCompleted(const TArray<int>& CompletedQuestIDs);
     UFUNCTION(NetMulticast, reliable)
     void OnStepQuestCompleted(int CompletedStepQuestID, int QuestIDWhereStepBelongs);
     FQuestStepObjective GetCurrentQuestCurrentObjective() const;
+    /* Rebuilds the prerequisite graph from the loaded quests and replays CompletedQuests on it */
+    void RebuildQuestAvailability();
+
+    void AddStepToEventIndex(const TSharedPtr<FQuest>& Quest, int32 StepIndex);
+    void RemoveStepFromEventIndex(const TSharedPtr<FQuest>& Quest, int32 StepIndex);
+    void RemoveQuestFromEventIndex(const TSharedPtr<FQuest>& Quest);
+    /* The exact key of the event and the keys of the filters its tag falls under */
+    void GetEventKeys(EQuestStepType StepType, const FGameplayTag& Tag, TArray<FQuestStepEventKey, TInlineAllocator<4>>& OutKeys);
+    /* Copy of the active steps waiting for the event, completing a step changes the index */
+    TArray<FQuestStepRef> GetStepsForEvent(EQuestStepType StepType, FGameplayTag Tag);
+    /* Completes the step and the quest if the event finished them */
+    void OnStepProgressed(const FQuestStepRef& Step);
+    /* One go to or talk with event against the steps on the frontier waiting for it */
+    void ApplyFrontierEvent(const FQuestProgressEvent& Event);
+    /* One increment of the shared counter, then the steps it finished */
+    void ApplyCounterEvent(const FQuestProgressEvent& Event);
+    /* Merges kill, gather and catch events with the same type, tag and player until the next flush.
+     * Returns false when coalescing is off or the event would complete a step, which is then applied right away */
+    bool CoalesceEvent(const FQuestProgressEvent& Event);
+    void FlushCoalescedEvents();
+    void DrainEventQueue();
+    /* Shared body of the event handlers, specialized through TQuestObjectiveTraits (Actors/QuestObjectiveTraits.h) */
+    template <EQuestStepType StepType>
+    void DispatchStepEvent(const FGameplayTag& Tag, float Amount, APlayerController* Player);
+    void OnPlayerPostLogin(AGameModeBase* GameMode, APlayerController* NewPlayer);
+    void OnPlayerLogout(AGameModeBase* GameMode, AController* Exiting);
+    void UpdateStepPlayerMask(const FQuestStepObjective& Objective);
 private:
     UPROPERTY(ReplicatedUsing = OnRep_OnActiveQuests)
     TArray<FQuestStateInfo> ActiveQuests = {};
-    UPROPERTY(Replicated)
+    UPROPERTY(ReplicatedUsing = OnRep_CompletedQuests)
     TArray<int> CompletedQuests = {};
+    UPROPERTY(ReplicatedUsing = OnRep_SpawnedStepActors)
+    TArray<FQuestStepSpawnedActors> SpawnedStepActors;
+    /* Player state by slot, null for free slots */
+    UPROPERTY(ReplicatedUsing = OnRep_PlayerSlots)
+    TArray<APlayerState*> PlayerSlots;
+    /* Only steps with at least one player marked have an entry */
+    UPROPERTY(Replicated)
+    TArray<FQuestStepPlayerMask> StepPlayerMasks;
+    TMap<TObjectKey<APlayerState>, int32> PlayerSlotIndices;
+    TBitArray<> ConnectedPlayerSlots;
+    FDelegateHandle PostLoginHandle;
+    FDelegateHandle LogoutHandle;
+    /* Quests completed this frame, in completion order */
+    TArray<int> PendingCompletedQuests;
+    FDelegateHandle PostActorTickHandle;
     
     TArray<TSharedPtr<FQuest>> AllQuests;
+    FQuestPrerequisiteGraph PrerequisiteGraph;
+    /* Go to and talk with steps on the frontier of the active quests by the event that completes them. Nothing else is ever looked at by the event handlers */
+    TMap<FQuestStepEventKey, TArray<FQuestStepRef>> StepEventIndex;
+    /* Where the active kill, gather and catch steps are counted instead, server only */
+    FQuestCounterTable Counters;
+    FQuestTagFilterTable TagFilters;
     UPROPERTY()
     AActor* LastSpawnedActor;
     /** Pointer to table where the quests come from */
     UPROPERTY(EditAnywhere, Category = DataTableRowHandle)
     const UDataTable* DataTable;
 
+    TUniquePtr<FQuestEventCaptureWriter> EventCapture;
+
+    /* Events queued from any thread. The count bounds the queue since TQueue has no size of its own */
+    TQueue<FQueuedQuestEvent, EQueueMode::Mpsc> EventQueue;
+    std::atomic<int32> NumQueuedEvents { 0 };
+    std::atomic<int64> NumDroppedEvents { 0 };
+
+    /* Events merged by CoalesceEvent in the order they first arrived, applied at the end of the window or before anything that could change their order */
+    TArray<FQuestProgressEvent> CoalescedEvents;
+    /* What the merged events add to each counter, so CoalesceEvent sees when the next event would reach a step */
+    TMap<FQuestStepEventKey, float> CoalescedCounterAmounts;
+    double CoalescingWindowStart = 0.0;
+
     /** Things to activate/deactivate when quest is activated or deactivated*/
     UPROPERTY(EditAnywhere, Category = "Quest")
     TMap<int, FQuestActorReferences> QuestReferences;
 protected:
+    virtual void PostInitializeComponents() override;
     void BeginPlay() override;
+    virtual void Tick(float DeltaSeconds) override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+    virtual void BeginDestroy() override;
     virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+#if !UE_BUILD_SHIPPING
+    /* Traffic accounting for PCQSSoak, only while it records with pcqs.Soak.TrafficAccounting on. Not built into shipping */
+    virtual bool CallRemoteFunction(UFunction* Function, void* Parameters, FOutParmRec* OutParms, FFrame* Stack) override;
+    virtual bool ReplicateSubobjects(UActorChannel* Channel, FOutBunch* Bunch, FReplicationFlags* RepFlags) override;
+#endif
 };
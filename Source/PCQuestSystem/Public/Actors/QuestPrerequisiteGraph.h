@@ -0,0 +1,52 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FQuest;
+
+/**
+ * Quests and the quests they unlock, compiled from FQuest::PrerequisiteQuests when the quests are loaded.
+ * Every quest keeps how many of its prerequisites are not completed yet, so completing a quest only touches the quests that depend on it directly.
+ */
+struct PCQUESTSYSTEM_API FQuestPrerequisiteGraph
+{
+    /* Unknown prerequisites are ignored and quests inside a dependency cycle never become available, both are logged.
+     * Quests rejected for a step cycle (FQuest::HasValidStepGraph) are never available either */
+    void Build(const TArray<TSharedPtr<FQuest>>& Quests);
+    void Empty();
+
+    /* Appends the quests this completion made available. Completing a quest twice does nothing */
+    void CompleteQuest(int QuestID, TArray<int>* OutNewlyAvailable = nullptr);
+
+    /* Quests with every prerequisite completed that are not completed themselves, in no particular order */
+    const TArray<int>& GetAvailableQuests() const { return AvailableQuests; }
+    bool IsAvailable(int QuestID) const;
+    bool IsCompleted(int QuestID) const;
+    int32 GetNumPendingPrerequisites(int QuestID) const;
+    SIZE_T GetAllocatedSize() const;
+
+private:
+    struct FNode
+    {
+        int QuestID = -1;
+        int32 NumPendingPrerequisites = 0;
+        /* Position in AvailableQuests, so it can be removed without a search */
+        int32 AvailableIndex = INDEX_NONE;
+        int32 FirstDependent = 0;
+        int32 NumDependents = 0;
+        bool bCompleted = false;
+        bool bRejected = false;
+    };
+
+    const FNode* FindNode(int QuestID) const;
+    void AddAvailable(FNode& Node);
+    void RemoveAvailable(FNode& Node);
+
+    TArray<FNode> Nodes;
+    /* Node indices of the dependents, each node owns the range FirstDependent, NumDependents */
+    TArray<int32> Dependents;
+    TMap<int, int32> NodeIndices;
+    TArray<int> AvailableQuests;
+};
@@ -0,0 +1,29 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameplayTagContainer.h"
+
+struct FQuest;
+
+/**
+ * Tags that steps with FQuestStepObjective::bMatchChildTags listen to, compiled from the quests when they are loaded.
+ * Every filter tag is a bit. The filters an incoming tag falls under are worked out the first time the tag is seen and kept as bits,
+ * so resolving an event afterwards is one lookup and a walk over the set bits.
+ */
+struct PCQUESTSYSTEM_API FQuestTagFilterTable
+{
+    void Build(const TArray<TSharedPtr<FQuest>>& Quests);
+    void Empty();
+
+    /* Appends the filters that Tag is, or is a child of */
+    void GetMatchingFilters(const FGameplayTag& Tag, TArray<FGameplayTag, TInlineAllocator<4>>& OutFilters);
+    int32 GetNumFilters() const { return Filters.Num(); }
+    SIZE_T GetAllocatedSize() const;
+
+private:
+    TArray<FGameplayTag> Filters;
+    /* Bits of Filters per incoming tag, filled as tags come in */
+    TMap<FGameplayTag, TBitArray<>> TagMatches;
+};
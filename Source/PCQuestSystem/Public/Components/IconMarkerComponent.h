@@ -5,12 +5,16 @@
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
 #include "UObject/WeakObjectPtrTemplates.h"
+#include "Markers/MarkerHandle.h"
 #include "UI/IconMarkerUMG.h"
 #include "IconMarkerComponent.generated.h"
 
 class UIconMarkerUMG;
 
 
+/**
+ * Hand placed marker. Registers a marker record in the world's UMarkerSubsystem, which does the actual work.
+ */
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
 class PCQUESTSYSTEM_API UIconMarkerComponent : public UActorComponent
 {
@@ -23,6 +27,7 @@ public:
 
     // Called when the game starts
     virtual void BeginPlay() override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	UFUNCTION(BlueprintCallable, Category = "IconMarker")
 	void ActivateMarker();
@@ -53,8 +58,11 @@ public:
     bool bShowOnCompass;
     UPROPERTY(EditAnywhere, Category = "IconMarker")
     FVector ActorOffset;
+    /* Higher priority markers stay visible when there are more markers than the screen allows */
+    UPROPERTY(EditAnywhere, Category = "IconMarker")
+    int32 Priority = 0;
 private:
-    TSoftObjectPtr<UIconMarkerUMG> MarkerUMG;
 	bool bActive;
+    FMarkerHandle MarkerHandle;
 	
 };
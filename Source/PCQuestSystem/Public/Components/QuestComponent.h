@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
+#include "HAL/CriticalSection.h"
 #include "Actors/QuestManager.h"
 #include "QuestComponent.generated.h"
 
@@ -44,13 +45,25 @@ public:
         void OnItemGathered(FGameplayTag ItemGathered, float amountGathered);
     UFUNCTION(BlueprintCallable, Category = "QuestManager")
     void OnCatch(FGameplayTag CatchTag);
+    /* Thread safe version of the events above for worker threads. Off the game thread it uses the controller last seen possessing the owner.
+     * Server only like the events above, returns false on clients. Also returns false and logs when the event is dropped */
+    bool EnqueueEvent(EQuestStepType StepType, FGameplayTag Tag, float Amount = 1.f);
 
 	UFUNCTION(Exec, BlueprintCallable)
 		void ActivateQuestDebug(int QuestID);
 private:
     APlayerController* GetController();
+    void SetOwnerPlayerController(APlayerController* PlayerController);
+    /* Keeps OwnerPlayerController current when the owner is possessed after BeginPlay or changes hands */
+    UFUNCTION()
+    void OnOwnerControllerChanged(APawn* Pawn, AController* OldController, AController* NewController);
     UPROPERTY()
     APlayerController* OwnerPlayerController;
+    /* Copy of OwnerPlayerController for EnqueueEvent on worker threads, the game thread writes it under the lock */
+    TWeakObjectPtr<APlayerController> WorkerPlayerController;
+    FRWLock WorkerPlayerControllerLock;
+    /* Events EnqueueEvent dropped, to warn once per burst */
+    std::atomic<int64> NumDroppedEvents { 0 };
     UPROPERTY()
 	AQuestManager* QuestManager;
 };
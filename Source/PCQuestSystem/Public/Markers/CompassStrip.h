@@ -0,0 +1,44 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CompassStrip.generated.h"
+
+class APlayerController;
+class UIconMarkerComponent;
+
+USTRUCT(BlueprintType)
+struct PCQUESTSYSTEM_API FCompassMarker
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadOnly, Category = "Compass")
+    UIconMarkerComponent* MarkerComponent = nullptr;
+    UPROPERTY(BlueprintReadOnly, Category = "Compass")
+    AActor* MarkerOwner = nullptr;
+    UPROPERTY(BlueprintReadOnly, Category = "Compass")
+    UTexture2D* Icon = nullptr;
+    UPROPERTY(BlueprintReadOnly, Category = "Compass")
+    float XPosition = 0.f;
+};
+
+/**
+ * Camera location and pawn basis captured once, so every compass marker of a frame is placed in a single pass.
+ * Gives the same X positions as UPCQSBlueprintFunctionLibrary::GetActorXPositionOnCompass.
+ */
+struct PCQUESTSYSTEM_API FCompassStripView
+{
+    bool Initialize(APlayerController* PlayerController, float FieldOfViewDegrees);
+
+    /* Returns false if the location is outside the compass field of view */
+    bool GetXPosition(const FVector& WorldLocation, float Margin, float& OutXPosition) const;
+
+private:
+    FVector2D CameraLocation2D;
+    FVector2D Right2D;
+    FVector2D Forward2D;
+    /* Cosine of half the field of view, markers with a smaller cosine to the pawn forward are culled */
+    float MinForwardCosine = -1.f;
+    bool bCullByFieldOfView = false;
+};
@@ -0,0 +1,62 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MarkerGrid.generated.h"
+
+class UIconMarkerComponent;
+
+USTRUCT(BlueprintType)
+struct PCQUESTSYSTEM_API FMapMarker
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadOnly, Category = "Map")
+    UIconMarkerComponent* MarkerComponent = nullptr;
+    UPROPERTY(BlueprintReadOnly, Category = "Map")
+    AActor* MarkerOwner = nullptr;
+    UPROPERTY(BlueprintReadOnly, Category = "Map")
+    UTexture2D* Icon = nullptr;
+    UPROPERTY(BlueprintReadOnly, Category = "Map")
+    FVector WorldLocation = FVector::ZeroVector;
+};
+
+/**
+ * Uniform grid over the XY plane. Entries are ids with a cached 2D location, bucketed by cell,
+ * so area queries only look at the cells they overlap and cost grows with the results instead of the total entry count.
+ */
+struct PCQUESTSYSTEM_API FMarkerGrid
+{
+    explicit FMarkerGrid(float InCellSize = 5000.f);
+
+    /* Returns the cell the entry went to, callers keep it to move or remove the entry later */
+    FIntPoint Add(int32 Id, const FVector& Location);
+    void Remove(int32 Id, const FIntPoint& Cell);
+    /* Updates the cached location and changes cell if needed. Returns the new cell */
+    FIntPoint Move(int32 Id, const FIntPoint& Cell, const FVector& NewLocation);
+    void Empty();
+
+    /* Appends the ids inside the box */
+    void QueryBox(const FBox2D& Box, TArray<int32>& OutIds) const;
+    /* Appends the ids inside the circle */
+    void QueryRadius(const FVector2D& Center, float Radius, TArray<int32>& OutIds) const;
+
+    FIntPoint GetCell(const FVector2D& Location) const;
+    float GetCellSize() const { return CellSize; }
+    SIZE_T GetAllocatedSize() const;
+
+private:
+    struct FEntry
+    {
+        int32 Id;
+        FVector2D Location;
+    };
+
+    template <typename PredicateType>
+    void Query(const FBox2D& Box, TArray<int32>& OutIds, PredicateType Predicate) const;
+
+    TMap<FIntPoint, TArray<FEntry>> Cells;
+    float CellSize;
+    float InvCellSize;
+};
@@ -0,0 +1,21 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Reference to a marker record inside a UMarkerSubsystem.
+ * The serial number makes handles to removed records harmless once their slot is reused.
+ */
+struct PCQUESTSYSTEM_API FMarkerHandle
+{
+    int32 Index = INDEX_NONE;
+    uint32 Serial = 0;
+
+    bool IsValid() const { return Index != INDEX_NONE; }
+    void Reset() { Index = INDEX_NONE; Serial = 0; }
+
+    bool operator==(const FMarkerHandle& Other) const { return Index == Other.Index && Serial == Other.Serial; }
+    bool operator!=(const FMarkerHandle& Other) const { return !(*this == Other); }
+};
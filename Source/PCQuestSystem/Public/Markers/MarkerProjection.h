@@ -0,0 +1,57 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MarkerProjection.generated.h"
+
+class APlayerController;
+
+USTRUCT(BlueprintType)
+struct PCQUESTSYSTEM_API FMarkerScreenInfo
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadOnly, Category = "MarkerProjection")
+    FVector2D ScreenPosition = FVector2D::ZeroVector;
+    UPROPERTY(BlueprintReadOnly, Category = "MarkerProjection")
+    float RotationAngleDegrees = 0.f;
+    UPROPERTY(BlueprintReadOnly, Category = "MarkerProjection")
+    float DistanceToActor = 0.f;
+    UPROPERTY(BlueprintReadOnly, Category = "MarkerProjection")
+    bool bIsOnScreen = false;
+};
+
+/**
+ * Player view captured once so any number of markers can be projected against the same view-projection matrix.
+ * Gives the same results as UPCQSBlueprintFunctionLibrary::GetActorInformationToPlayerController, four markers at a time.
+ */
+struct PCQUESTSYSTEM_API FMarkerProjectionView
+{
+    /* Captures viewport, camera and pawn data from the player controller. Returns false if there is nothing to project against. */
+    bool Initialize(APlayerController* PlayerController, bool bUseCameraLocation);
+
+    /* Offsets can be empty (no offset) or have one entry per location. OutInfos must have one entry per location. */
+    void ProjectMarkers(TArrayView<const FVector> WorldLocations, TArrayView<const FVector> Offsets, float PercentageEdge, TArrayView<FMarkerScreenInfo> OutInfos) const;
+    /* Same as above with one edge percentage per marker */
+    void ProjectMarkers(TArrayView<const FVector> WorldLocations, TArrayView<const FVector> Offsets, TArrayView<const float> PercentageEdges, TArrayView<FMarkerScreenInfo> OutInfos) const;
+
+    bool IsValid() const { return bValid; }
+    const FVector2D& GetViewportSize() const { return ViewportSize; }
+    const FVector& GetCameraLocation() const { return CameraLocation; }
+
+private:
+    void ProjectMarkers(TArrayView<const FVector> WorldLocations, TArrayView<const FVector> Offsets, float DefaultPercentageEdge, TArrayView<const float> PercentageEdges, TArrayView<FMarkerScreenInfo> OutInfos) const;
+
+    /* View projection without the view origin translation, so float math keeps its precision far from the world origin */
+    FMatrix44f TranslatedViewProjection;
+    FVector ViewOrigin;
+    FVector CameraLocation;
+    /* Location used to check if a marker is behind the camera. Either the camera or the pawn location */
+    FVector BehindCheckOrigin;
+    FVector PawnLocation;
+    FVector3f CameraForward;
+    FVector2D ViewportSize;
+    FIntRect ViewRect;
+    bool bValid = false;
+};
@@ -0,0 +1,134 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Markers/MarkerGrid.h"
+#include "Markers/MarkerHandle.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "WorldCollision.h"
+#include "MarkerSubsystem.generated.h"
+
+class UIconMarkerComponent;
+class UIconMarkerUMG;
+class UTexture2D;
+
+/**
+ * Plain data for one marker. Quest objectives add these directly for their associated actors,
+ * hand placed UIconMarkerComponents add one for themselves.
+ */
+struct PCQUESTSYSTEM_API FMarkerRecord
+{
+    TWeakObjectPtr<AActor> Owner;
+    TObjectKey<AActor> OwnerKey;
+    FVector Offset = FVector::ZeroVector;
+    TObjectPtr<UTexture2D> Icon = nullptr;
+    TSubclassOf<UIconMarkerUMG> WidgetClass;
+    /* Only created the first time an on screen marker is activated */
+    TObjectPtr<UIconMarkerUMG> Widget = nullptr;
+    /* Set when the record belongs to a UIconMarkerComponent */
+    TWeakObjectPtr<UIconMarkerComponent> Component;
+    uint32 Serial = 0;
+    /* Index inside the active list, INDEX_NONE while inactive */
+    int32 ActiveIndex = INDEX_NONE;
+    /* Higher priority markers win the visible slots and lead the clusters they are in */
+    int32 Priority = 0;
+    /* Pending line of sight trace, if any */
+    FTraceHandle OcclusionTrace;
+    /* World time at which the cached line of sight result gets refreshed */
+    double NextOcclusionCheckTime = 0.0;
+    /* Map grid cell, valid while active */
+    FIntPoint GridCell = FIntPoint::ZeroValue;
+    uint8 bShowOnScreen : 1;
+    uint8 bShowOnCompass : 1;
+    /* Cached result of the last line of sight trace */
+    uint8 bOccluded : 1;
+
+    FMarkerRecord()
+        : bShowOnScreen(false),
+        bShowOnCompass(false),
+        bOccluded(false)
+    {
+    }
+
+    bool IsActive() const { return ActiveIndex != INDEX_NONE; }
+};
+
+/**
+ * Per world registry of markers.
+ * Records live in sparse storage with stable indices, so adding and removing one is O(1),
+ * and the active ones are also kept in a dense list so per frame queries never look at inactive markers.
+ * Markers are purely local: every client derives them from the replicated quest state and dedicated servers have none.
+ * Active markers are also kept in a uniform grid for map queries.
+ * Each frame a layout pass projects the on screen markers together, caps how many are visible and merges nearby ones into clusters.
+ */
+UCLASS()
+class PCQUESTSYSTEM_API UMarkerSubsystem : public UTickableWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    /* Returns null on dedicated servers, so callers skip all marker work there */
+    static UMarkerSubsystem* Get(const UObject* WorldContext);
+
+    virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+    virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+    virtual void Deinitialize() override;
+    static void AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector);
+    virtual void Tick(float DeltaTime) override;
+    virtual TStatId GetStatId() const override;
+
+    FMarkerHandle AddMarker(AActor* Owner, TSubclassOf<UIconMarkerUMG> WidgetClass, UTexture2D* Icon, FVector Offset, bool bShowOnScreen, bool bShowOnCompass, int32 Priority = 0, UIconMarkerComponent* Component = nullptr);
+    void RemoveMarker(FMarkerHandle& Handle);
+    void ActivateMarker(const FMarkerHandle& Handle);
+    void DeactivateMarker(const FMarkerHandle& Handle);
+    bool IsMarkerActive(const FMarkerHandle& Handle) const;
+    const FMarkerRecord* GetMarker(const FMarkerHandle& Handle) const;
+
+    /* Components that registered a record, for Blueprint users of the old component list */
+    TArray<UIconMarkerComponent*> GetAllMarkerComponents() const;
+    /* Sparse indices of the active records, valid until the next add, remove or (de)activation */
+    const TArray<int32>& GetActiveMarkerIndices() const { return ActiveMarkerIndices; }
+    const FMarkerRecord& GetMarkerAt(int32 Index) const { return Markers[Index]; }
+
+    /* Appends the sparse indices of the active markers inside the circle or box, ignoring height */
+    void QueryMarkersInRadius(const FVector& Center, float Radius, TArray<int32>& OutMarkerIndices) const;
+    void QueryMarkersInBox(const FBox2D& Box, TArray<int32>& OutMarkerIndices) const;
+
+    void ShowActiveMarkers() const;
+    void HideActiveMarkers() const;
+
+    /* Heap memory of the records, indices and grid, without the widgets. Used by pcqs.MemReport */
+    SIZE_T GetAllocatedSize() const;
+    int32 GetNumMarkers() const { return Markers.Num(); }
+
+protected:
+    virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+    FMarkerRecord* FindMarker(const FMarkerHandle& Handle);
+    void RemoveMarkerAt(int32 Index);
+    void SetMarkerActive(int32 Index, bool bActive);
+    /* Moves the active markers whose owner can move to their current grid cell */
+    void UpdateMarkerGrid();
+    /* Sorts, caps and clusters the on screen markers and hands the result to their widgets */
+    void UpdateLayout();
+    void ClearLayout();
+    /* Queues async line of sight traces for markers whose cached result is due, within the per frame budget */
+    void RequestOcclusionTraces(const FVector& ViewLocation, TArrayView<const int32> VisibleMarkers, TArrayView<const FVector> MarkerLocations);
+    void OnOcclusionTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum);
+
+    UFUNCTION()
+    void OnMarkerOwnerDestroyed(AActor* DestroyedActor);
+
+    TSparseArray<FMarkerRecord> Markers;
+    TArray<int32> ActiveMarkerIndices;
+    /* Records of each owner, so they can go away together with it */
+    TMultiMap<TObjectKey<AActor>, int32> OwnerMarkers;
+    uint32 NextSerial = 1;
+    FMarkerGrid MarkerGrid;
+    /* True while widgets are driven by the layout pass, so turning it off can hand them back */
+    bool bLayoutApplied = false;
+    FTraceDelegate OcclusionTraceDelegate;
+};
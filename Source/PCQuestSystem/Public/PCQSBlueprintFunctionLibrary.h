@@ -6,6 +6,9 @@
 #include "Kismet/BlueprintFunctionLibrary.h"
 #include <Components/IconMarkerComponent.h>
 #include "Actors/QuestManager.h"
+#include "Markers/CompassStrip.h"
+#include "Markers/MarkerGrid.h"
+#include "Markers/MarkerProjection.h"
 #include "PCQSBlueprintFunctionLibrary.generated.h"
 
 class UIconMarkerComponent;
@@ -21,18 +24,25 @@ class PCQUESTSYSTEM_API UPCQSBlueprintFunctionLibrary : public UBlueprintFunctio
 public:
     UFUNCTION(BlueprintCallable, Category = "PCQS Blueprint Function Library")
     static void GetActorInformationToPlayerController(APlayerController* PlayerController, AActor* ActorToCheck, bool bUseCameraLocation, FVector ActorToCheckOffSet, FVector2D& OutScreenPosition, float& OutRotationAngleDegrees, float& DistanceToActor, bool& bIsOnScreen, float PercentageEdge = 1.0f);
+    /* Same as GetActorInformationToPlayerController for many markers at once. MarkerOffsets can be empty or match MarkerLocations */
     UFUNCTION(BlueprintCallable, Category = "PCQS Blueprint Function Library")
-    static TArray<UIconMarkerComponent*> GetAllIconComponents();
+    static void GetMarkersInformationToPlayerController(APlayerController* PlayerController, const TArray<FVector>& MarkerLocations, const TArray<FVector>& MarkerOffsets, bool bUseCameraLocation, TArray<FMarkerScreenInfo>& OutMarkersInformation, float PercentageEdge = 1.0f);
+    UFUNCTION(BlueprintCallable, Category = "PCQS Blueprint Function Library", meta = (WorldContext = "WorldContextObject"))
+    static TArray<UIconMarkerComponent*> GetAllIconComponents(const UObject* WorldContextObject);
     UFUNCTION(BlueprintCallable, Category = "PCQS Blueprint Function Library")
     static void GetActorXPositionOnCompass(APlayerController* PlayerController, AActor* ActorToCheck, float margin, float& XPosition);
+    /* Places every active compass marker in one pass. Markers outside FieldOfViewDegrees are left out, 360 keeps them all */
+    UFUNCTION(BlueprintCallable, Category = "PCQS Blueprint Function Library")
+    static void GetCompassMarkers(APlayerController* PlayerController, float Margin, TArray<FCompassMarker>& OutCompassMarkers, float FieldOfViewDegrees = 360.f);
+    /* Active markers within Radius of Center on the XY plane, for map views. Cost grows with the results, not the marker count */
+    UFUNCTION(BlueprintCallable, Category = "PCQS Blueprint Function Library", meta = (WorldContext = "WorldContextObject"))
+    static void GetMarkersInRadius(const UObject* WorldContextObject, FVector Center, float Radius, TArray<FMapMarker>& OutMapMarkers);
+    /* Active markers inside the XY box, for map views */
+    UFUNCTION(BlueprintCallable, Category = "PCQS Blueprint Function Library", meta = (WorldContext = "WorldContextObject"))
+    static void GetMarkersInBox(const UObject* WorldContextObject, FVector2D BoxMin, FVector2D BoxMax, TArray<FMapMarker>& OutMapMarkers);
     UFUNCTION(BlueprintCallable, Category = "PCQS Blueprint Function Library")
     static AQuestManager* GetWorldQuestManager(UObject* WorldContext);
 
-    static void AddIconMarkerComponent(UIconMarkerComponent* Component);
-    static void RemoveIconMarkerComponent(UIconMarkerComponent* Component);
-
-    static void ShowHiddenIconMarkerComponents();
-    static void HideIconMarkerComponents();
-private:
-    static TArray<UIconMarkerComponent*> AllMarkerComponents;
+    static void ShowHiddenIconMarkerComponents(const UObject* WorldContextObject);
+    static void HideIconMarkerComponents(const UObject* WorldContextObject);
 };
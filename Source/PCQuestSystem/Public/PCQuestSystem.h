@@ -5,6 +5,15 @@
 #include "CoreMinimal.h"
 #include "Modules/ModuleManager.h"
 
+DECLARE_LOG_CATEGORY_EXTERN(LogPCQuestSystem, Log, All);
+
+/* Debug logging of the quest flow, compiled out of shipping builds */
+#if UE_BUILD_SHIPPING
+#define PCQS_LOG(Verbosity, Format, ...)
+#else
+#define PCQS_LOG(Verbosity, Format, ...) UE_LOG(LogPCQuestSystem, Verbosity, Format, ##__VA_ARGS__)
+#endif
+
 class FPCQuestSystemModule : public IModuleInterface
 {
 public:
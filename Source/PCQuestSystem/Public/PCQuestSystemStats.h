@@ -0,0 +1,26 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Stats/Stats.h"
+#include "Trace/Trace.h"
+
+DECLARE_STATS_GROUP(TEXT("PCQuestSystem"), STATGROUP_PCQuestSystem, STATCAT_Advanced);
+
+/* LLM tags, the others are children of PCQuestSystem (PCQuestSystem/Definitions) through the parent given to LLM_DEFINE_TAG. Shown with -llm and "stat LLMFULL" */
+LLM_DECLARE_TAG_API(PCQuestSystem, PCQUESTSYSTEM_API);
+LLM_DECLARE_TAG_API(PCQuestSystem_Definitions, PCQUESTSYSTEM_API);
+LLM_DECLARE_TAG_API(PCQuestSystem_RuntimeState, PCQUESTSYSTEM_API);
+LLM_DECLARE_TAG_API(PCQuestSystem_Markers, PCQUESTSYSTEM_API);
+LLM_DECLARE_TAG_API(PCQuestSystem_SpawnedActors, PCQUESTSYSTEM_API);
+
+/* Insights channel for the quest system scopes. Enable with -trace=cpu,PCQuestSystem */
+UE_TRACE_CHANNEL_EXTERN(PCQuestSystemChannel, PCQUESTSYSTEM_API);
+
+/* Cycle counter for "stat PCQuestSystem" that also shows up as a scope on the PCQuestSystem trace channel */
+#define PCQS_SCOPE_CYCLE_COUNTER(Stat) \
+    SCOPE_CYCLE_COUNTER(Stat); \
+    TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Stat, PCQuestSystemChannel)
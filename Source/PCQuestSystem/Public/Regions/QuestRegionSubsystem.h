@@ -0,0 +1,83 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameplayTagContainer.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "QuestRegionSubsystem.generated.h"
+
+class APawn;
+class UQuestComponent;
+
+enum class EQuestRegionShape : uint8
+{
+    Box,
+    Sphere
+};
+
+/* Location region registered in the grid. Boxes are oriented, spheres use Extent.X as radius */
+struct PCQUESTSYSTEM_API FQuestRegion
+{
+    FGameplayTag Location;
+    FVector Center = FVector::ZeroVector;
+    FQuat InverseRotation = FQuat::Identity;
+    FVector Extent = FVector::ZeroVector;
+    EQuestRegionShape Shape = EQuestRegionShape::Box;
+    /* Cells covered by the region bounds */
+    FIntPoint MinCell = FIntPoint::ZeroValue;
+    FIntPoint MaxCell = FIntPoint::ZeroValue;
+
+    /* Margin grows the shape, used so leaving needs a bit more distance than entering */
+    bool IsInside(const FVector& Point, float Margin) const;
+};
+
+/**
+ * Location detection without physics overlaps.
+ * Regions are registered in a uniform grid and the player pawns are sampled at a fixed rate,
+ * each sample only testing the regions of the cell the pawn is in.
+ * The server samples every player, clients only their local pawns so the location delegates still fire for them.
+ */
+UCLASS()
+class PCQUESTSYSTEM_API UQuestRegionSubsystem : public UTickableWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    static UQuestRegionSubsystem* Get(const UObject* WorldContext);
+
+    virtual void Deinitialize() override;
+    virtual void Tick(float DeltaTime) override;
+    virtual TStatId GetStatId() const override;
+
+    /* Returns the region id, used to unregister it */
+    int32 RegisterBoxRegion(FGameplayTag Location, const FTransform& Transform, const FVector& Extent);
+    int32 RegisterSphereRegion(FGameplayTag Location, const FVector& Center, float Radius);
+    void UnregisterRegion(int32 RegionId);
+
+    int32 GetNumRegions() const { return Regions.Num(); }
+
+protected:
+    virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+    struct FPlayerRegionState
+    {
+        TWeakObjectPtr<UQuestComponent> QuestComponent;
+        /* Regions the pawn is inside of */
+        TArray<int32, TInlineAllocator<4>> InsideRegions;
+        uint32 LastSample = 0;
+    };
+
+    int32 AddRegion(FQuestRegion&& Region, const FVector& BoundsExtent);
+    void SamplePlayers();
+    void SamplePawn(APawn* Pawn);
+    FIntPoint GetCell(const FVector& Location) const;
+
+    TSparseArray<FQuestRegion> Regions;
+    TMap<FIntPoint, TArray<int32>> RegionCells;
+    TMap<TObjectKey<APawn>, FPlayerRegionState> PlayerStates;
+    float TimeSinceSample = 0.f;
+    uint32 SampleCount = 0;
+};
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "Blueprint/UserWidget.h"
+#include "Markers/MarkerProjection.h"
 #include "IconMarkerUMG.generated.h"
 
 class UImage;
@@ -11,6 +12,27 @@ class USizeBox;
 class UGridPanel;
 class UTextBlock;
 
+USTRUCT(BlueprintType)
+struct PCQUESTSYSTEM_API FIconMarkerUpdateTier
+{
+    GENERATED_BODY()
+
+    FIconMarkerUpdateTier() = default;
+    FIconMarkerUpdateTier(float InMaxDistance, float InUpdateInterval)
+        : MaxDistance(InMaxDistance),
+        UpdateInterval(InUpdateInterval)
+    {
+    }
+
+    /* Markers up to this distance (in meters) use this tier */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "IconMarkerUMG")
+    float MaxDistance = 0.f;
+
+    /* Seconds between updates, 0 updates every frame */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "IconMarkerUMG")
+    float UpdateInterval = 0.f;
+};
+
 /**
  * 
  */
@@ -23,16 +45,33 @@ public:
     void UpdateIcon();
     void SetMarkerOwner(AActor* newMarkerOwner);
     void SetEdgePercentage(float newPercentage);
+    float GetEdgePercentage() const { return PercentageEdge; }
     void PlayWidgetFadeAnimation();
     void SetMarkerIconImage(UTexture2D* IconToUse);
     void SetMarkerOffset(FVector Offset);
+    /* Makes the next tick update the marker no matter which update tier it is in */
+    void ForceUpdate();
+    /* Screen info and cluster size from the marker layout pass, used instead of projecting the owner again */
+    void ApplyLayout(const FMarkerScreenInfo& ScreenInfo, int32 NewClusterCount);
+    /* Collapses the marker while the layout pass culls it or merges it into another cluster */
+    void SetLayoutVisible(bool bVisible);
+    /* Goes back to projecting the owner every update */
+    void ClearLayout();
+    /* Fades the marker towards OccludedOpacity while its owner is out of line of sight */
+    void SetOccluded(bool bOccluded);
 private:
+    float GetUpdateInterval(float MetersDistance, bool bIsOnScreen) const;
+    void SetClusterCount(int32 NewClusterCount);
+
     UPROPERTY(meta = (BindWidget))
     UImage* IconMarker;
     UPROPERTY(meta = (BindWidget))
     UImage* MarkerDirection;
     UPROPERTY(meta = (BindWidget))
     UTextBlock* DistanceText;
+    /* Shows how many markers this one stands for when nearby markers are merged */
+    UPROPERTY(meta = (BindWidgetOptional))
+    UTextBlock* ClusterCountText;
 
     UPROPERTY(meta = (BindWidgetAnim), Transient)
     UWidgetAnimation* WidgetFadeAnimation;
@@ -47,11 +86,47 @@ private:
     UPROPERTY(EditAnywhere, Category = "IconMarkerUMG")
     float DistanceToFade = 5.f;
 
+    /* Update rate by distance, sorted from nearest to farthest. Markers past the last tier use FarUpdateInterval */
+    UPROPERTY(EditAnywhere, Category = "IconMarkerUMG|Update LOD")
+    TArray<FIconMarkerUpdateTier> UpdateTiers = { FIconMarkerUpdateTier(50.f, 0.f), FIconMarkerUpdateTier(200.f, 0.1f), FIconMarkerUpdateTier(1000.f, 0.25f) };
+
+    UPROPERTY(EditAnywhere, Category = "IconMarkerUMG|Update LOD")
+    float FarUpdateInterval = 0.5f;
+
+    /* Minimum seconds between updates while the marker is clamped to the screen edge */
+    UPROPERTY(EditAnywhere, Category = "IconMarkerUMG|Update LOD")
+    float EdgeClampedUpdateInterval = 0.1f;
+
+    /* Opacity of the marker while its owner is occluded */
+    UPROPERTY(EditAnywhere, Category = "IconMarkerUMG|Occlusion", meta = (ClampMin = "0", ClampMax = "1"))
+    float OccludedOpacity = 0.35f;
+
+    /* Opacity change per second when the marker gets occluded or visible again */
+    UPROPERTY(EditAnywhere, Category = "IconMarkerUMG|Occlusion", meta = (ClampMin = "0"))
+    float OcclusionFadeSpeed = 4.f;
+
     bool bIsDistanceFaded = false;
-    float currentDistanceToActor = 0;
+
+    /* Last values pushed to the widgets, so they are only touched when something changes */
+    FVector2D LastWidgetPosition = FVector2D(-1.f, -1.f);
+    float LastRotationAngle = -1.f;
+    int32 LastMetersDistance = -1;
+    ESlateVisibility LastDirectionVisibility = ESlateVisibility::Hidden;
+    ESlateVisibility LastDistanceVisibility = ESlateVisibility::Hidden;
+
+    float TimeSinceUpdate = 0.f;
+    float CurrentUpdateInterval = 0.f;
+    bool bForceUpdate = true;
+
+    FMarkerScreenInfo LayoutInfo;
+    int32 ClusterCount = 1;
+    bool bHasLayout = false;
+    bool bLayoutVisible = true;
+    float TargetOpacity = 1.f;
 
     FVector MarkerOffset;
 protected:
+    void NativeConstruct() override;
     void NativeTick(const FGeometry& MyGeometry, float InDeltaTime) override;
 
 };
@@ -0,0 +1,60 @@
+// Copyright � Pedro Costa, 2021. All rights reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Blueprint/UserWidget.h"
+#include "MinimapUMG.generated.h"
+
+class UCanvasPanel;
+class UImage;
+class UTexture2D;
+
+/**
+ * Base minimap. Every update it asks the marker grid for the markers around the local pawn
+ * and places one pooled image per result inside MarkerCanvas, centered on the pawn.
+ */
+UCLASS()
+class PCQUESTSYSTEM_API UMinimapUMG : public UUserWidget
+{
+	GENERATED_BODY()
+
+public:
+    UFUNCTION(BlueprintCallable, Category = "MinimapUMG")
+    void SetMapRadius(float NewMapRadius);
+
+protected:
+    void NativeTick(const FGeometry& MyGeometry, float InDeltaTime) override;
+
+    UPROPERTY(meta = (BindWidget))
+    UCanvasPanel* MarkerCanvas;
+
+    /* World distance (in meters) from the center to the edge of the minimap */
+    UPROPERTY(EditAnywhere, Category = "MinimapUMG", meta = (ClampMin = "1"))
+    float MapRadius = 50.f;
+
+    /* Keeps the pawn facing up, otherwise north (world X) is up */
+    UPROPERTY(EditAnywhere, Category = "MinimapUMG")
+    bool bRotateWithPlayer = true;
+
+    UPROPERTY(EditAnywhere, Category = "MinimapUMG")
+    FVector2D MarkerSize = FVector2D(24.f, 24.f);
+
+    /* Seconds between updates, 0 updates every frame */
+    UPROPERTY(EditAnywhere, Category = "MinimapUMG")
+    float UpdateInterval = 0.f;
+
+private:
+    void UpdateMarkers();
+    UImage* GetPooledImage(int32 PoolIndex);
+
+    UPROPERTY(Transient)
+    TArray<UImage*> MarkerImages;
+    /* Texture currently set on each pooled image, so brushes are only rebuilt when the icon changes */
+    UPROPERTY(Transient)
+    TArray<UTexture2D*> MarkerImageIcons;
+
+    TArray<int32> QueryResults;
+    int32 NumUsedImages = 0;
+    float TimeSinceUpdate = 0.f;
+};